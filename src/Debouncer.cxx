@@ -0,0 +1,49 @@
+#include "Debouncer.hxx"
+#include <algorithm>
+
+namespace PowerFeed
+{
+	Debouncer::Debouncer(uint32_t aMask, uint32_t aSamples, uint32_t aLevels)
+	{
+		Add(aMask, aSamples, aLevels);
+	}
+
+	void Debouncer::Add(uint32_t aMask, uint32_t aSamples, uint32_t aLevels)
+	{
+		const uint8_t samples = static_cast<uint8_t>(std::clamp<uint32_t>(aSamples, 1, MAX_SAMPLES));
+		for (uint32_t pending = aMask; pending != 0; pending &= pending - 1)
+		{
+			const uint32_t bit = static_cast<uint32_t>(__builtin_ctz(pending));
+			mySamples[bit] = samples;
+			myCounts[bit] = (aLevels & (1u << bit)) != 0 ? samples : 0;
+		}
+		myLevels = (myLevels & ~aMask) | (aLevels & aMask);
+		myMask |= aMask;
+	}
+
+	uint32_t Debouncer::Sample(uint32_t aLevels)
+	{
+		uint32_t changed = 0;
+		for (uint32_t pending = myMask; pending != 0; pending &= pending - 1)
+		{
+			const uint32_t bit = static_cast<uint32_t>(__builtin_ctz(pending));
+			const uint32_t flag = 1u << bit;
+			uint8_t &count = myCounts[bit];
+			if ((aLevels & flag) != 0)
+			{
+				if (count < mySamples[bit] && ++count == mySamples[bit] && (myLevels & flag) == 0)
+				{
+					myLevels |= flag;
+					changed |= flag;
+				}
+			}
+			else if (count > 0 && --count == 0 && (myLevels & flag) != 0)
+			{
+				myLevels &= ~flag;
+				changed |= flag;
+			}
+		}
+		return changed;
+	}
+
+} // namespace PowerFeed
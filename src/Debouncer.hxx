@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+
+namespace PowerFeed
+{
+	/**
+	@brief Integrating debounce of up to 32 inputs, sampled together at a fixed rate. Each input has a counter that
+	counts up on every sample it reads high and down on every sample it reads low, and the debounced level only
+	changes once the counter gets to the end it is heading for, aSamples or 0. A contact that settles gets through
+	within aSamples, a glitch shorter than that never does, and bouncing for less than that around a change lets
+	it through once.
+	The work per sample does not depend on the input, so neither does the load of whatever samples it. */
+	class Debouncer
+	{
+	public:
+		static constexpr uint32_t MAX_SAMPLES = 255;
+
+		/**
+		@param aMask inputs to debounce, as bits of the levels
+		@param aSamples samples a change has to hold for, 1 to MAX_SAMPLES
+		@param aLevels the levels to start from, no change is reported for them */
+		Debouncer(uint32_t aMask, uint32_t aSamples, uint32_t aLevels);
+
+		/**
+		@brief No inputs until some are added */
+		Debouncer() = default;
+
+		/**
+		@brief Debounce more inputs, each input keeps the number of samples it was added with
+		@param aMask inputs to add, as bits of the levels
+		@param aSamples samples a change of these has to hold for, 1 to MAX_SAMPLES
+		@param aLevels the levels to start these from */
+		void Add(uint32_t aMask, uint32_t aSamples, uint32_t aLevels);
+
+		/**
+		@brief Take one sample of every input
+		@return the inputs whose debounced level changed at this sample */
+		uint32_t Sample(uint32_t aLevels);
+
+		/**
+		@brief Debounced levels, only the bits of the mask */
+		uint32_t GetLevels() const { return myLevels; }
+
+		uint32_t GetMask() const { return myMask; }
+
+	private:
+		uint32_t myMask = 0;
+		uint32_t myLevels = 0;
+		uint8_t mySamples[32] = {};
+		uint8_t myCounts[32] = {};
+	};
+
+} // namespace PowerFeed
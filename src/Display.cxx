@@ -9,6 +9,8 @@ namespace PowerFeed
 
 	const char *IPM = "ipm";
 	const char *MMPM = "mm ";
+	const char *IPR = "in/r";
+	const char *MMPR = "mm/r";
 
 	Display::Display(SettingsManager *settings, const unsigned char *font) : mySettings(settings), myFont(font)
 	{
@@ -62,23 +64,59 @@ namespace PowerFeed
 		DrawImage(rapidright32, rightX, 32, rapidright32WidthPixels, rapidright32HeightPixels);
 	}
 
-	void Display::DrawSpeed(uint32_t aSpeed)
+	void Display::DrawStalled()
+	{
+		DrawCenteredText("STALL", myFont, 32);
+	}
+
+	void Display::DrawEStopped()
 	{
-		float speedPerMin = (static_cast<float>(aSpeed) / mySettings->Get()->mechanical.stepsPerMm) * 60.0;
-		char speed[14];
+		DrawCenteredText("E-STOP", myFont, 32);
+	}
 
-		if (myUnits == Units::Millimeter)
+	void Display::DrawSpeed(uint32_t aSpeed)
+	{
+		const bool inch = myUnits == Units::Inch;
+		std::shared_ptr<Settings> settings = mySettings->Get();
+		const Settings::Axis &axis = settings->axes[myAxis];
+		const uint32_t tenths = axis.mechanical.StepsToTenths(aSpeed, inch);
+		char speed[20];
+
+		// integer formatting, %f would pull in soft float printf on every redraw
+		if (settings->axes.size() > 1)
 		{
-			snprintf(speed, sizeof(speed), "%.1f %s", speedPerMin, MMPM);
+			snprintf(speed, sizeof(speed), "%s %u.%u %s", axis.name.c_str(), static_cast<unsigned>(tenths / 10), static_cast<unsigned>(tenths % 10), inch ? IPM : MMPM);
 		}
 		else
 		{
-			speedPerMin = speedPerMin * inchPerMm;
-			snprintf(speed, sizeof(speed), "%.1f %s", speedPerMin, IPM);
+			snprintf(speed, sizeof(speed), "%u.%u %s", static_cast<unsigned>(tenths / 10), static_cast<unsigned>(tenths % 10), inch ? IPM : MMPM);
 		}
 		DrawCenteredText(speed, myFont, 0);
 	}
 
+	void Display::DrawFeedPerRev(uint32_t aStepsPerRev)
+	{
+		const bool inch = myUnits == Units::Inch;
+		std::shared_ptr<Settings> settings = mySettings->Get();
+		const Settings::Axis &axis = settings->axes[myAxis];
+		const uint32_t feed = axis.mechanical.StepsToFeedPerRev(aStepsPerRev, inch);
+		// 0.050 mm/r or 0.0020 in/r
+		const unsigned scale = inch ? 10000 : 1000;
+		char text[20];
+		char fraction[8];
+		snprintf(fraction, sizeof(fraction), inch ? "%04u" : "%03u", static_cast<unsigned>(feed % scale));
+
+		if (settings->axes.size() > 1)
+		{
+			snprintf(text, sizeof(text), "%s %u.%s %s", axis.name.c_str(), static_cast<unsigned>(feed / scale), fraction, inch ? IPR : MMPR);
+		}
+		else
+		{
+			snprintf(text, sizeof(text), "%u.%s %s", static_cast<unsigned>(feed / scale), fraction, inch ? IPR : MMPR);
+		}
+		DrawCenteredText(text, myFont, 0);
+	}
+
 	void Display::DrawCenteredText(const char *text, const unsigned char *font, uint16_t y)
 	{
 		uint16_t textWidth = GetTextWidth(text, font);
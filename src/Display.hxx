@@ -24,12 +24,21 @@ namespace PowerFeed
 		virtual void DrawStopped();
 		virtual void DrawRapidLeft();
 		virtual void DrawRapidRight();
+		virtual void DrawStalled();
+		virtual void DrawEStopped();
 		virtual void DrawSpeed(uint32_t aSpeed);
+		/**
+		@brief Feed per spindle revolution in place of the speed, while the axis follows the spindle */
+		virtual void DrawFeedPerRev(uint32_t aStepsPerRev);
 		virtual void ClearBuffer() = 0;
 		virtual void ToggleUnits();
 		virtual void WriteBuffer() = 0;
 		virtual void Refresh() = 0;
 
+		/**
+		@brief Axis whose units DrawSpeed converts to, its name is shown with the speed when there is more than one */
+		void SelectAxis(uint8_t anAxis) { myAxis = anAxis; }
+
 	protected:
 		virtual void DrawCenteredText(const char *text, const unsigned char *font, uint16_t y);
 		virtual void DrawText(const char *text, const unsigned char *font, uint16_t x, uint16_t y) = 0;
@@ -42,9 +51,7 @@ namespace PowerFeed
 		const uint16_t myHeight = 32;
 		Units myUnits = Units::Millimeter;
 		uint32_t mySpeed = 0;
-
-		const float mmPerInch = 25.4;
-		const float inchPerMm = 1.0 / mmPerInch;
+		uint8_t myAxis = 0;
 
 		const uint8_t height = 32;
 		const uint8_t width = 32;
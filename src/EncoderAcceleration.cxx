@@ -0,0 +1,52 @@
+#include "EncoderAcceleration.hxx"
+
+namespace PowerFeed
+{
+	EncoderAcceleration::EncoderAcceleration(const EncoderAccelerationCurve &aCurve) : myCurve(aCurve)
+	{
+	}
+
+	int32_t EncoderAcceleration::Apply(int32_t aDelta, uint32_t aNowUs)
+	{
+		// wraps like the microsecond timer does
+		const uint32_t elapsed = aNowUs - myLastUs;
+		const bool turningOn = myLastDelta != 0 && elapsed < PAUSE_US && (aDelta < 0) == (myLastDelta < 0);
+		myLastUs = aNowUs;
+		myLastDelta = aDelta;
+
+		myCountsPerSecond = 0;
+		if (turningOn && elapsed > 0)
+		{
+			const uint64_t magnitude = static_cast<uint64_t>(aDelta < 0 ? -static_cast<int64_t>(aDelta) : aDelta);
+			myCountsPerSecond = static_cast<uint32_t>((magnitude * 1000000) / elapsed);
+		}
+		return aDelta * static_cast<int32_t>(MultiplierAt(myCountsPerSecond));
+	}
+
+	uint32_t EncoderAcceleration::MultiplierAt(uint32_t aCountsPerSecond) const
+	{
+		if (myCurve.empty())
+		{
+			return 1;
+		}
+		if (aCountsPerSecond <= myCurve.front().countsPerSecond)
+		{
+			return myCurve.front().multiplier;
+		}
+		for (size_t i = 1; i < myCurve.size(); i++)
+		{
+			if (aCountsPerSecond <= myCurve[i].countsPerSecond)
+			{
+				const EncoderAccelerationPoint &low = myCurve[i - 1];
+				const EncoderAccelerationPoint &high = myCurve[i];
+				const int64_t span = high.countsPerSecond - low.countsPerSecond;
+				const int64_t rise = static_cast<int64_t>(high.multiplier) - low.multiplier;
+				// rounded to the nearest whole multiplier
+				const int64_t offset = (rise * (aCountsPerSecond - low.countsPerSecond) * 2 + (rise < 0 ? -span : span)) / (2 * span);
+				return static_cast<uint32_t>(low.multiplier + offset);
+			}
+		}
+		return myCurve.back().multiplier;
+	}
+
+} // namespace PowerFeed
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace PowerFeed
+{
+	/**
+	@brief A point of the knob's acceleration curve, the counts of a turn at this speed count this many times */
+	struct EncoderAccelerationPoint
+	{
+		uint32_t countsPerSecond;
+		uint32_t multiplier;
+	};
+
+	// sorted by speed, interpolated linearly between the points and held flat beyond the first and last
+	using EncoderAccelerationCurve = std::vector<EncoderAccelerationPoint>;
+
+	/**
+	@brief Scales the knob's counts by how fast it turns, so a slow turn changes the speed one count at a time and a
+	flick crosses the whole range. The speed is the counts over the time since the counts before them were read, so
+	it does not depend on how often the encoder is read. The first counts after a pause, and the first after the
+	knob turns back, are taken as slow. */
+	class EncoderAcceleration
+	{
+	public:
+		/**
+		@param aCurve empty for none, every count then counts once */
+		explicit EncoderAcceleration(const EncoderAccelerationCurve &aCurve);
+
+		/**
+		@brief Scale the counts read at aNowUs
+		@return aDelta times the multiplier at the speed the knob turns at */
+		int32_t Apply(int32_t aDelta, uint32_t aNowUs);
+
+		/**
+		@brief Speed of the knob at the last Apply */
+		uint32_t GetCountsPerSecond() const { return myCountsPerSecond; }
+
+		/**
+		@brief Multiplier of the curve at aCountsPerSecond */
+		uint32_t MultiplierAt(uint32_t aCountsPerSecond) const;
+
+	private:
+		// counts further apart than this are a new turn, not one continuing
+		static constexpr uint32_t PAUSE_US = 200000;
+
+		EncoderAccelerationCurve myCurve;
+		uint32_t myLastUs = 0;
+		int32_t myLastDelta = 0;
+		uint32_t myCountsPerSecond = 0;
+	};
+
+} // namespace PowerFeed
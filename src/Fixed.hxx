@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+
+namespace PowerFeed
+{
+	/**
+	@brief Signed Q16.16 fixed point number for feed rate and unit math, the M0+ has no FPU.
+	Every operation saturates at the ends of the range instead of wrapping and rounds to the nearest step. */
+	class Fixed
+	{
+	public:
+		static constexpr uint8_t FRACTION_BITS = 16;
+		static constexpr int32_t ONE = 1 << FRACTION_BITS;
+
+		constexpr Fixed() = default;
+
+		static constexpr Fixed FromRaw(int32_t aRaw) { return Fixed(aRaw); }
+		static constexpr Fixed FromInt(int32_t aValue) { return Fixed(Saturate(static_cast<int64_t>(aValue) * ONE)); }
+
+		/**
+		@brief aNumerator / aDenominator, for exact constants like 25.4 = 127 / 5 */
+		static constexpr Fixed FromRatio(int32_t aNumerator, int32_t aDenominator)
+		{
+			return Fixed(Divide(static_cast<int64_t>(aNumerator) * ONE, aDenominator));
+		}
+
+		/**
+		@brief Only for values read from the settings, not for anything that runs per step or per redraw */
+		static Fixed FromDouble(double aValue)
+		{
+			double scaled = aValue * ONE + (aValue < 0 ? -0.5 : 0.5);
+			if (scaled >= static_cast<double>(MAX))
+			{
+				return Fixed(MAX);
+			}
+			if (scaled <= static_cast<double>(MIN))
+			{
+				return Fixed(MIN);
+			}
+			return Fixed(static_cast<int32_t>(scaled));
+		}
+
+		constexpr int32_t Raw() const { return myRaw; }
+		constexpr int32_t ToInt() const { return static_cast<int32_t>((static_cast<int64_t>(myRaw) + ONE / 2) >> FRACTION_BITS); }
+		double ToDouble() const { return static_cast<double>(myRaw) / ONE; }
+
+		/**
+		@brief aValue * this rounded to an integer. The product is kept in 64 bits so a small factor applied to a
+		large count, steps per second to feed rate for example, does not lose the fraction or overflow. */
+		constexpr int32_t Scale(int32_t aValue) const
+		{
+			return Saturate((static_cast<int64_t>(aValue) * myRaw + ONE / 2) >> FRACTION_BITS);
+		}
+
+		constexpr Fixed operator+(Fixed anOther) const { return Fixed(Saturate(static_cast<int64_t>(myRaw) + anOther.myRaw)); }
+		constexpr Fixed operator-(Fixed anOther) const { return Fixed(Saturate(static_cast<int64_t>(myRaw) - anOther.myRaw)); }
+		constexpr Fixed operator*(Fixed anOther) const
+		{
+			return Fixed(Saturate((static_cast<int64_t>(myRaw) * anOther.myRaw + ONE / 2) >> FRACTION_BITS));
+		}
+		constexpr Fixed operator/(Fixed anOther) const { return Fixed(Divide(static_cast<int64_t>(myRaw) * ONE, anOther.myRaw)); }
+
+		constexpr bool operator==(Fixed anOther) const { return myRaw == anOther.myRaw; }
+		constexpr bool operator!=(Fixed anOther) const { return myRaw != anOther.myRaw; }
+		constexpr bool operator<(Fixed anOther) const { return myRaw < anOther.myRaw; }
+		constexpr bool operator>(Fixed anOther) const { return myRaw > anOther.myRaw; }
+
+	private:
+		static constexpr int32_t MAX = std::numeric_limits<int32_t>::max();
+		static constexpr int32_t MIN = std::numeric_limits<int32_t>::min();
+
+		constexpr explicit Fixed(int32_t aRaw) : myRaw(aRaw) {}
+
+		static constexpr int32_t Saturate(int64_t aValue)
+		{
+			return aValue > MAX ? MAX : (aValue < MIN ? MIN : static_cast<int32_t>(aValue));
+		}
+
+		// rounded to nearest, dividing by zero saturates towards the sign of the numerator
+		static constexpr int32_t Divide(int64_t aNumerator, int64_t aDenominator)
+		{
+			if (aDenominator == 0)
+			{
+				return aNumerator < 0 ? MIN : MAX;
+			}
+			if (aDenominator < 0)
+			{
+				aNumerator = -aNumerator;
+				aDenominator = -aDenominator;
+			}
+			int64_t half = aDenominator / 2;
+			return Saturate((aNumerator + (aNumerator < 0 ? -half : half)) / aDenominator);
+		}
+
+		int32_t myRaw = 0;
+	};
+
+} // namespace PowerFeed
@@ -0,0 +1,38 @@
+#include "FollowingError.hxx"
+
+namespace PowerFeed
+{
+	FollowingError::FollowingError(Fixed aStepsPerEncoderRev, uint32_t anEncoderCountsPerRev, uint32_t aLimit)
+		: myStepsPerRevRaw(aStepsPerEncoderRev.Raw()),
+		  myCountsPerRevRaw(static_cast<int64_t>(anEncoderCountsPerRev > 0 ? anEncoderCountsPerRev : 1) << Fixed::FRACTION_BITS),
+		  myLimit(aLimit)
+	{
+	}
+
+	void FollowingError::Reset(int32_t aSteps, int32_t aCounts)
+	{
+		myBaseSteps = aSteps;
+		myBaseCounts = aCounts;
+		myError = 0;
+	}
+
+	bool FollowingError::Update(int32_t aSteps, int32_t aCounts)
+	{
+		// differences of the raw counters so a wrap in either one cancels out
+		const int32_t steps = static_cast<int32_t>(static_cast<uint32_t>(aSteps) - static_cast<uint32_t>(myBaseSteps));
+		const int32_t counts = static_cast<int32_t>(static_cast<uint32_t>(aCounts) - static_cast<uint32_t>(myBaseCounts));
+
+		int64_t product = static_cast<int64_t>(counts) * myStepsPerRevRaw;
+		int64_t half = myCountsPerRevRaw / 2;
+		const int64_t expected = (product + (product < 0 ? -half : half)) / myCountsPerRevRaw;
+
+		myError = static_cast<int32_t>(steps - expected);
+		const uint32_t magnitude = static_cast<uint32_t>(myError < 0 ? -static_cast<int64_t>(myError) : myError);
+		if (magnitude > myMaxError)
+		{
+			myMaxError = magnitude;
+		}
+		return magnitude > myLimit;
+	}
+
+} // namespace PowerFeed
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Fixed.hxx"
+#include <cstdint>
+
+namespace PowerFeed
+{
+	/**
+	@brief Compares the steps sent to the driver with the position an encoder on the motor or the leadscrew reports,
+	to catch lost steps. Counts are taken relative to the last Reset(), so both counters may wrap.
+	The expected steps are worked out from the whole encoder count since the Reset() rather than accumulated, so a
+	ratio that is not a whole number of steps per count does not drift over a long move. */
+	class FollowingError
+	{
+	public:
+		FollowingError(Fixed aStepsPerEncoderRev, uint32_t anEncoderCountsPerRev, uint32_t aLimit);
+
+		/**
+		@brief Start comparing from the current step and encoder counts, call while the motor is at rest */
+		void Reset(int32_t aSteps, int32_t aCounts);
+
+		/**
+		@return true if the steps sent and the encoder disagree by more than the limit */
+		bool Update(int32_t aSteps, int32_t aCounts);
+
+		/**
+		@brief Steps sent that the encoder has not seen, negative if the motor is ahead */
+		int32_t GetError() const { return myError; }
+		uint32_t GetMaxError() const { return myMaxError; }
+
+	private:
+		const int64_t myStepsPerRevRaw;
+		const int64_t myCountsPerRevRaw;
+		const uint32_t myLimit;
+		int32_t myBaseSteps = 0;
+		int32_t myBaseCounts = 0;
+		int32_t myError = 0;
+		uint32_t myMaxError = 0;
+	};
+
+} // namespace PowerFeed
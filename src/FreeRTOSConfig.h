@@ -95,6 +95,8 @@
 #define configTIMER_TASK_PRIORITY (configMAX_PRIORITIES - 1)
 #define configTIMER_QUEUE_LENGTH 10
 #define configTIMER_TASK_STACK_DEPTH 1024
+/* The timer task runs at the highest priority, keep it off the stepper core (DRIVER_CORE) */
+#define configTIMER_SERVICE_TASK_CORE_AFFINITY (1 << 0)
 
 /* Interrupt nesting behaviour configuration. */
 /*
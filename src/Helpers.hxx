@@ -6,6 +6,8 @@
 #include <FreeRTOS.h>
 #endif
 
+#include <cstdint>
+
 inline double ScaleValue(double value, double minOld, double maxOld, double minNew, double maxNew)
 {
 	return (value - minOld) / (maxOld - minOld) * (maxNew - minNew) + minNew;
@@ -23,6 +25,31 @@ T min(T a, T2 b)
 	return static_cast<T>(a < b ? a : b);
 }
 
+// integer square root, rounded down
+inline uint64_t ISqrt(uint64_t aValue)
+{
+	uint64_t result = 0;
+	uint64_t bit = 1ull << 62;
+	while (bit > aValue)
+	{
+		bit >>= 2;
+	}
+	while (bit != 0)
+	{
+		if (aValue >= result + bit)
+		{
+			aValue -= result + bit;
+			result = (result >> 1) + bit;
+		}
+		else
+		{
+			result >>= 1;
+		}
+		bit >>= 2;
+	}
+	return result;
+}
+
 #define MS_TO_TICKS(ms) (ms * configTICK_RATE_HZ / 1000)
 
 #define MS_TO_US(ms) (ms * 1000)
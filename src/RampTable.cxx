@@ -0,0 +1,219 @@
+#include "RampTable.hxx"
+#include <algorithm>
+#include <cmath>
+
+namespace PowerFeed
+{
+	namespace
+	{
+		// slices the curve is integrated over, the table interpolates between far fewer points than this
+		constexpr uint32_t CURVE_SLICES = 2048;
+	}
+
+	RampTable::RampTable(uint32_t aTickHz, uint32_t aStartSpeed, uint32_t aMaxSpeed, uint32_t aRate, uint16_t aSegments, const AccelerationCurve &aCurve)
+	{
+		const double startSpeed = aStartSpeed > 0 ? aStartSpeed : 1;
+		const double maxSpeed = aMaxSpeed > startSpeed ? aMaxSpeed : startSpeed + 1;
+		const double rate = aRate > 0 ? aRate : 1;
+		const uint16_t segments = aSegments > 0 ? aSegments : 1;
+
+		// position p = n + 1/2 of every speed on the ramp, p(v) = integral of v / a(v) from 0, v^2 / 2a for a flat a
+		std::vector<double> curveSpeeds;
+		std::vector<double> curvePositions;
+		if (!aCurve.empty())
+		{
+			curveSpeeds.reserve(CURVE_SLICES + 1);
+			curvePositions.reserve(CURVE_SLICES + 1);
+			curveSpeeds.push_back(0);
+			curvePositions.push_back(0);
+			const double slice = maxSpeed / CURVE_SLICES;
+			for (uint32_t i = 1; i <= CURVE_SLICES; i++)
+			{
+				const double low = slice * (i - 1);
+				const double high = slice * i;
+				const double area = slice * (low / AccelerationAt(aCurve, low) + high / AccelerationAt(aCurve, high)) / 2;
+				curveSpeeds.push_back(high);
+				curvePositions.push_back(curvePositions.back() + area);
+			}
+		}
+
+		auto positionOf = [&](double aSpeed)
+		{
+			if (curveSpeeds.empty())
+			{
+				return (aSpeed * aSpeed) / (2.0 * rate);
+			}
+			size_t i = std::upper_bound(curveSpeeds.begin(), curveSpeeds.end(), aSpeed) - curveSpeeds.begin();
+			i = std::clamp<size_t>(i, 1, curveSpeeds.size() - 1);
+			const double fraction = (aSpeed - curveSpeeds[i - 1]) / (curveSpeeds[i] - curveSpeeds[i - 1]);
+			return curvePositions[i - 1] + fraction * (curvePositions[i] - curvePositions[i - 1]);
+		};
+
+		const double firstSquare = startSpeed * startSpeed;
+		auto speedOf = [&](double aPosition)
+		{
+			if (curveSpeeds.empty())
+			{
+				return std::sqrt(std::max(2.0 * rate * aPosition, firstSquare));
+			}
+			size_t i = std::upper_bound(curvePositions.begin(), curvePositions.end(), aPosition) - curvePositions.begin();
+			i = std::clamp<size_t>(i, 1, curvePositions.size() - 1);
+			// v^2 is close to linear in p over a slice, closer than v is
+			const double fraction = (aPosition - curvePositions[i - 1]) / (curvePositions[i] - curvePositions[i - 1]);
+			const double low = curveSpeeds[i - 1] * curveSpeeds[i - 1];
+			const double high = curveSpeeds[i] * curveSpeeds[i];
+			return std::sqrt(std::max(low + fraction * (high - low), firstSquare));
+		};
+
+		const double first = std::round(positionOf(startSpeed)) + 0.5;
+		const double last = std::round(positionOf(maxSpeed)) + 0.5;
+		const double ratio = std::pow(last / first, 1.0 / segments);
+
+		// segments shorter than a step collapse, so the start of the ramp ends up with an exact period per step
+		mySegments.reserve(segments + 1);
+		double position = first;
+		for (uint16_t i = 0; i <= segments; i++)
+		{
+			uint32_t index = static_cast<uint32_t>(std::llround((i == segments ? last : position) - 0.5));
+			if (mySegments.empty() || index > mySegments.back().index)
+			{
+				// recompute the speed from the rounded index so every boundary is exact.
+				// Step n takes the time from n to n + 1, so its speed is taken halfway between them
+				double speed = speedOf(index + 0.5);
+				mySegments.push_back({static_cast<int64_t>(std::ldexp(aTickHz / speed, FRACTION_BITS)), 0, index});
+			}
+			position *= ratio;
+		}
+
+		for (size_t i = 0; i + 1 < mySegments.size(); i++)
+		{
+			int64_t rise = mySegments[i + 1].period - mySegments[i].period;
+			mySegments[i].slope = rise / static_cast<int64_t>(mySegments[i + 1].index - mySegments[i].index);
+		}
+
+		Seek(GetFirstIndex());
+	}
+
+	double RampTable::AccelerationAt(const AccelerationCurve &aCurve, double aSpeed)
+	{
+		if (aSpeed <= aCurve.front().speed)
+		{
+			return std::max<double>(aCurve.front().acceleration, 1);
+		}
+		for (size_t i = 1; i < aCurve.size(); i++)
+		{
+			if (aSpeed <= aCurve[i].speed)
+			{
+				const AccelerationPoint &low = aCurve[i - 1];
+				const AccelerationPoint &high = aCurve[i];
+				const double fraction = (aSpeed - low.speed) / static_cast<double>(high.speed - low.speed);
+				return std::max(low.acceleration + fraction * (static_cast<double>(high.acceleration) - low.acceleration), 1.0);
+			}
+		}
+		return std::max<double>(aCurve.back().acceleration, 1);
+	}
+
+	void RampTable::Seek(uint32_t aIndex)
+	{
+		if (aIndex < GetFirstIndex())
+		{
+			aIndex = GetFirstIndex();
+		}
+
+		size_t low = 0;
+		size_t high = mySegments.size() - 1;
+		while (low < high)
+		{
+			size_t middle = (low + high + 1) / 2;
+			if (mySegments[middle].index <= aIndex)
+			{
+				low = middle;
+			}
+			else
+			{
+				high = middle - 1;
+			}
+		}
+
+		mySegment = low;
+		myIndex = aIndex;
+		myPeriod = PeriodAt(mySegment, myIndex);
+	}
+
+	void RampTable::SeekPeriod(uint32_t aPeriod)
+	{
+		const int64_t period = static_cast<int64_t>(aPeriod) << FRACTION_BITS;
+
+		// periods fall as the index rises
+		size_t low = 0;
+		size_t high = mySegments.size() - 1;
+		while (low < high)
+		{
+			size_t middle = (low + high + 1) / 2;
+			if (mySegments[middle].period >= period)
+			{
+				low = middle;
+			}
+			else
+			{
+				high = middle - 1;
+			}
+		}
+
+		const Segment &segment = mySegments[low];
+		uint32_t offset = 0;
+		if (segment.slope < 0 && period < segment.period)
+		{
+			offset = static_cast<uint32_t>((segment.period - period) / -segment.slope);
+			if (low + 1 < mySegments.size())
+			{
+				offset = std::min(offset, mySegments[low + 1].index - segment.index - 1);
+			}
+		}
+
+		mySegment = low;
+		myIndex = segment.index + offset;
+		myPeriod = PeriodAt(mySegment, myIndex);
+	}
+
+	void RampTable::StepUp()
+	{
+		myIndex++;
+		if (mySegment + 1 < mySegments.size() && myIndex >= mySegments[mySegment + 1].index)
+		{
+			mySegment++;
+			myPeriod = mySegments[mySegment].period;
+		}
+		else
+		{
+			myPeriod += mySegments[mySegment].slope;
+		}
+	}
+
+	void RampTable::StepDown()
+	{
+		if (myIndex <= GetFirstIndex())
+		{
+			return;
+		}
+
+		if (myIndex == mySegments[mySegment].index)
+		{
+			mySegment--;
+			myIndex--;
+			myPeriod = PeriodAt(mySegment, myIndex);
+		}
+		else
+		{
+			myIndex--;
+			myPeriod -= mySegments[mySegment].slope;
+		}
+	}
+
+	int64_t RampTable::PeriodAt(size_t aSegment, uint32_t aIndex) const
+	{
+		const Segment &segment = mySegments[aSegment];
+		return segment.period + segment.slope * static_cast<int64_t>(aIndex - segment.index);
+	}
+
+} // namespace PowerFeed
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace PowerFeed
+{
+	/**
+	@brief A point of the motor's torque curve, as the acceleration it can manage at a speed in steps per second */
+	struct AccelerationPoint
+	{
+		uint32_t speed;
+		uint32_t acceleration;
+	};
+
+	// sorted by speed, interpolated linearly between the points and held flat beyond the first and last
+	using AccelerationCurve = std::vector<AccelerationPoint>;
+
+	/**
+	@brief Precomputed step periods of a constant rate ramp, p(n) = f / sqrt(2 * rate * (n + 1/2)), for the
+	ramp index n (steps it takes to reach that speed from standstill).
+	Built once with floating point, then walked one step at a time with a fixed point add per step.
+	Segments are spaced geometrically in n + 1/2 between the start speed and the max speed,
+	which keeps the relative error of the linear interpolation roughly constant over the whole ramp.
+	With an acceleration curve the rate follows the speed instead, the index of a speed is then the integral of
+	v / a(v) from standstill, worked out numerically when the table is built. Walking the table costs the same. */
+	class RampTable
+	{
+	public:
+		/**
+		@param aRate acceleration of the ramp, unless aCurve has points */
+		RampTable(uint32_t aTickHz, uint32_t aStartSpeed, uint32_t aMaxSpeed, uint32_t aRate, uint16_t aSegments, const AccelerationCurve &aCurve = {});
+
+		/**
+		@brief Acceleration of aCurve at aSpeed */
+		static double AccelerationAt(const AccelerationCurve &aCurve, double aSpeed);
+
+		/**
+		@brief Move the cursor to ramp index aIndex. Costs a binary search and a multiply, use on replanning only */
+		void Seek(uint32_t aIndex);
+		/**
+		@brief Move the cursor to the highest index whose period is still at or above aPeriod, so a ramp that takes
+		over from another one carries on from the period it is at instead of from a recalculated index */
+		void SeekPeriod(uint32_t aPeriod);
+		void StepUp();
+		void StepDown();
+
+		uint32_t GetIndex() const { return myIndex; }
+		uint32_t GetPeriod() const { return static_cast<uint32_t>((myPeriod + HALF) >> FRACTION_BITS); }
+		uint32_t GetFirstIndex() const { return mySegments.front().index; }
+		size_t GetFootprint() const { return mySegments.size() * sizeof(Segment); }
+
+	private:
+		static constexpr uint8_t FRACTION_BITS = 32;
+		static constexpr int64_t HALF = 1ll << (FRACTION_BITS - 1);
+
+		// periods carry FRACTION_BITS of fraction so truncation does not bias the ramp on short periods
+		struct Segment
+		{
+			int64_t period;
+			// period change per step
+			int64_t slope;
+			uint32_t index;
+		};
+
+		int64_t PeriodAt(size_t aSegment, uint32_t aIndex) const;
+
+		std::vector<Segment> mySegments;
+		size_t mySegment = 0;
+		uint32_t myIndex = 0;
+		int64_t myPeriod = 0;
+	};
+
+} // namespace PowerFeed
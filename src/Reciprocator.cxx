@@ -0,0 +1,90 @@
+#include "Reciprocator.hxx"
+
+namespace PowerFeed
+{
+	Reciprocator::Reciprocator(uint32_t aDwellUs, uint32_t aPulseUs)
+		: myDwellUs(aDwellUs), myPulseUs(aPulseUs)
+	{
+	}
+
+	void Reciprocator::Start(int32_t aFrom, int32_t aTo, uint64_t aNowUs)
+	{
+		myTarget = aTo;
+		myOtherEnd = aFrom;
+		myPhase = Phase::MOVING;
+		myPulseEndUs = 0;
+		myStrokes = 0;
+		myStartedUs = aNowUs;
+		myStrokeStartedUs = aNowUs;
+		myLastArrivalUs = aNowUs;
+		myLastStrokeUs = 0;
+	}
+
+	void Reciprocator::Stop()
+	{
+		myPhase = Phase::IDLE;
+		myPulseEndUs = 0;
+	}
+
+	bool Reciprocator::Update(uint64_t aNowUs, bool anAtRest, int32_t aPosition)
+	{
+		if (myPhase == Phase::MOVING)
+		{
+			if (!anAtRest)
+			{
+				return false;
+			}
+			if (aPosition != myTarget)
+			{
+				// stopped short, by a soft limit, a stall or the emergency stop, it is not safe to carry on
+				Stop();
+				return false;
+			}
+
+			myStrokes++;
+			myLastStrokeUs = static_cast<uint32_t>(aNowUs - myStrokeStartedUs);
+			myLastArrivalUs = aNowUs;
+			myPulseEndUs = aNowUs + myPulseUs;
+			myDwellEndUs = aNowUs + myDwellUs;
+			myPhase = Phase::DWELLING;
+		}
+
+		if (myPhase != Phase::DWELLING || aNowUs < myDwellEndUs)
+		{
+			return false;
+		}
+
+		const int32_t next = myOtherEnd;
+		myOtherEnd = myTarget;
+		myTarget = next;
+		myStrokeStartedUs = aNowUs;
+		myPhase = Phase::MOVING;
+		return true;
+	}
+
+	uint64_t Reciprocator::GetWakeAtUs(uint64_t aNowUs) const
+	{
+		uint64_t wake = 0;
+		if (myPhase == Phase::DWELLING)
+		{
+			wake = myDwellEndUs;
+		}
+		if (myPulseEndUs > aNowUs && (wake == 0 || myPulseEndUs < wake))
+		{
+			wake = myPulseEndUs;
+		}
+		return wake;
+	}
+
+	uint32_t Reciprocator::GetStrokesPerMinuteTenths() const
+	{
+		const uint64_t elapsed = myLastArrivalUs - myStartedUs;
+		if (myStrokes == 0 || elapsed == 0)
+		{
+			return 0;
+		}
+		// 600000000 tenths of a stroke a minute for a stroke every microsecond
+		return static_cast<uint32_t>((static_cast<uint64_t>(myStrokes) * 600000000ull) / elapsed);
+	}
+
+} // namespace PowerFeed
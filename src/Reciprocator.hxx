@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+
+namespace PowerFeed
+{
+	/**
+	@brief Shuttles an axis between two positions, for surface grinding and long facing passes. It only plans, the
+	stepper task tells it whether the axis is at rest and where it is, and moves the axis where it is told to.
+	Every reversal waits out the dwell and raises the cross feed output for the pulse time from the moment the
+	axis arrives. The ends are whole step positions that every stroke moves to, not distances, so the reversal
+	points cannot drift however many strokes it runs. */
+	class Reciprocator
+	{
+	public:
+		enum class Phase : uint8_t
+		{
+			IDLE,
+			MOVING,
+			DWELLING
+		};
+
+		Reciprocator(uint32_t aDwellUs, uint32_t aPulseUs);
+
+		/**
+		@brief Move to aTo, then back to aFrom and so on until stopped */
+		void Start(int32_t aFrom, int32_t aTo, uint64_t aNowUs);
+		void Stop();
+
+		/**
+		@brief Carry the shuttle on, call whenever the stepper task runs while active
+		@param anAtRest the axis has stopped and its last step is out
+		@return true if a move to GetTarget() is to be started now */
+		bool Update(uint64_t aNowUs, bool anAtRest, int32_t aPosition);
+
+		bool IsActive() const { return myPhase != Phase::IDLE; }
+		Phase GetPhase() const { return myPhase; }
+		int32_t GetTarget() const { return myTarget; }
+		bool IsCrossFeedOn(uint64_t aNowUs) const { return aNowUs < myPulseEndUs; }
+
+		/**
+		@return when the next Update is due to end a dwell or a pulse, 0 if nothing is timed */
+		uint64_t GetWakeAtUs(uint64_t aNowUs) const;
+
+		// strokes from end to end since the Start
+		uint32_t GetStrokes() const { return myStrokes; }
+		uint32_t GetLastStrokeUs() const { return myLastStrokeUs; }
+		/**
+		@brief Strokes a minute in tenths, from the Start to the last arrival, dwells included */
+		uint32_t GetStrokesPerMinuteTenths() const;
+
+	private:
+		const uint32_t myDwellUs;
+		const uint32_t myPulseUs;
+
+		Phase myPhase = Phase::IDLE;
+		int32_t myTarget = 0;
+		int32_t myOtherEnd = 0;
+		uint64_t myDwellEndUs = 0;
+		uint64_t myPulseEndUs = 0;
+
+		uint32_t myStrokes = 0;
+		uint64_t myStartedUs = 0;
+		uint64_t myStrokeStartedUs = 0;
+		uint64_t myLastArrivalUs = 0;
+		uint32_t myLastStrokeUs = 0;
+	};
+
+} // namespace PowerFeed
@@ -0,0 +1,170 @@
+#include "SCurve.hxx"
+#include "Helpers.hxx"
+#include <algorithm>
+
+namespace PowerFeed
+{
+	SCurve::SCurve(uint32_t aTickHz, uint32_t aAcceleration, uint32_t aDeceleration, uint32_t aJerk)
+		: myTickHz(aTickHz),
+		  myAccelerationLimit(static_cast<int64_t>(aAcceleration > 0 ? aAcceleration : 1) << FRACTION_BITS),
+		  myDecelerationLimit(static_cast<int64_t>(aDeceleration > 0 ? aDeceleration : 1) << FRACTION_BITS),
+		  myJerk(aJerk > 0 ? aJerk : 1),
+		  mySliceTicks(static_cast<uint32_t>((static_cast<uint64_t>(aTickHz) * SLICE_US) / US_PER_SECOND))
+	{
+	}
+
+	void SCurve::Reset(uint32_t aSpeed)
+	{
+		mySpeed = static_cast<int64_t>(aSpeed > 0 ? aSpeed : 1) << FRACTION_BITS;
+		myAcceleration = 0;
+		myPeriod = 0;
+		myElapsed = 0;
+	}
+
+	void SCurve::SetTarget(uint32_t aSpeed)
+	{
+		myTarget = static_cast<int64_t>(aSpeed > 0 ? aSpeed : 1) << FRACTION_BITS;
+		myPeriod = 0;
+	}
+
+	bool SCurve::IsSettled() const
+	{
+		return mySpeed == myTarget && myAcceleration == 0;
+	}
+
+	uint32_t SCurve::Step()
+	{
+		if (IsSettled() || mySpeed >= STEP_PER_SLICE_SPEED)
+		{
+			if (myPeriod == 0)
+			{
+				myPeriod = PeriodForSpeed();
+			}
+
+			uint32_t period = myPeriod;
+			if (!IsSettled())
+			{
+				myElapsed += period;
+				if (myElapsed >= mySliceTicks)
+				{
+					Integrate(static_cast<uint32_t>((static_cast<uint64_t>(myElapsed) * US_PER_SECOND) / myTickHz));
+					myElapsed = 0;
+					myPeriod = PeriodForSpeed();
+				}
+			}
+			return period;
+		}
+
+		// slower than a step per slice, follow the profile through the step until it has covered one step
+		int64_t remaining = ONE;
+		uint32_t micros = 0;
+		while (micros < MAX_STEP_US)
+		{
+			int64_t distance = mySpeed * SLICE_US / US_PER_SECOND;
+			if (distance >= remaining)
+			{
+				int64_t last = (remaining * US_PER_SECOND + mySpeed - 1) / mySpeed;
+				IntegrateSlice(last);
+				micros += static_cast<uint32_t>(last);
+				break;
+			}
+
+			IntegrateSlice(SLICE_US);
+			micros += SLICE_US;
+			remaining -= distance;
+		}
+
+		myPeriod = 0;
+		myElapsed = 0;
+		return static_cast<uint32_t>((static_cast<uint64_t>(micros) * myTickHz) / US_PER_SECOND);
+	}
+
+	void SCurve::Integrate(uint32_t aMicros)
+	{
+		while (aMicros > 0)
+		{
+			uint32_t slice = aMicros < SLICE_US ? aMicros : SLICE_US;
+			IntegrateSlice(slice);
+			aMicros -= slice;
+		}
+	}
+
+	void SCurve::IntegrateSlice(int64_t aMicros)
+	{
+		if (IsSettled())
+		{
+			return;
+		}
+
+		// work along the direction towards the target so speeding up and slowing down share the same logic
+		const int64_t direction = myTarget >= mySpeed ? 1 : -1;
+		const int64_t remaining = (myTarget - mySpeed) * direction;
+		const int64_t limit = direction > 0 ? myAccelerationLimit : myDecelerationLimit;
+		const int64_t jerkStep = (myJerk * aMicros * ONE) / US_PER_SECOND;
+		const int64_t acceleration = myAcceleration * direction;
+
+		int64_t next;
+		if (acceleration < 0)
+		{
+			// still accelerating away from a target that has moved behind us, turn around at the jerk limit
+			next = acceleration + jerkStep;
+		}
+		else
+		{
+			// speed that is still gained while the acceleration ramps down to zero, a^2 / 2j, plus two slices of
+			// margin since a step can carry the profile past a slice boundary
+			const int64_t whole = acceleration >> FRACTION_BITS;
+			const int64_t braking = ((whole * whole) << FRACTION_BITS) / (2 * myJerk) + acceleration * (2 * SLICE_US) / US_PER_SECOND;
+			if (remaining <= ONE && acceleration <= jerkStep)
+			{
+				// within a step per second and nearly done ramping down
+				mySpeed = myTarget;
+				myAcceleration = 0;
+				return;
+			}
+			if (remaining <= braking)
+			{
+				// follow a = sqrt(2j * dv), taken at the end of the slice, down so the acceleration runs out right at
+				// the target, holding it until the ideal curve comes down to meet it
+				const int64_t after = std::max<int64_t>(remaining - acceleration * aMicros / US_PER_SECOND, 0);
+				const int64_t ideal = static_cast<int64_t>(ISqrt(static_cast<uint64_t>(2 * myJerk * after)) << (FRACTION_BITS / 2));
+				next = std::clamp(ideal, acceleration - jerkStep, acceleration);
+			}
+			else
+			{
+				next = acceleration + jerkStep;
+			}
+			if (next < 0)
+			{
+				next = 0;
+			}
+		}
+		if (next > limit)
+		{
+			next = limit;
+		}
+
+		mySpeed += ((acceleration + next) / 2) * aMicros / US_PER_SECOND * direction;
+		myAcceleration = next * direction;
+
+		if ((myTarget - mySpeed) * direction <= 0 && next <= jerkStep)
+		{
+			// arrived with the acceleration all but run out
+			mySpeed = myTarget;
+			myAcceleration = 0;
+		}
+		// a target that moved closer than the acceleration can run out in is overshot, the next slice turns
+		// around at the jerk limit rather than cutting the acceleration off
+		if (mySpeed < ONE)
+		{
+			mySpeed = ONE;
+		}
+	}
+
+	uint32_t SCurve::PeriodForSpeed() const
+	{
+		uint64_t period = (static_cast<uint64_t>(myTickHz) << FRACTION_BITS) / static_cast<uint64_t>(mySpeed);
+		return period > 0 ? static_cast<uint32_t>(period) : 1;
+	}
+
+} // namespace PowerFeed
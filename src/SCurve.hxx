@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+
+namespace PowerFeed
+{
+	/**
+	@brief Jerk limited velocity profile. Acceleration ramps up at the jerk limit, holds at the acceleration (or
+	deceleration) limit, and ramps back down so that it reaches zero just as the speed reaches the target.
+	A new target can be set at any time, the profile carries on from its current speed and acceleration.
+	All state is fixed point with 16 fractional bits, the profile is integrated in slices of at most SLICE_US. */
+	class SCurve
+	{
+	public:
+		static constexpr uint32_t SLICE_US = 500;
+
+		SCurve(uint32_t aTickHz, uint32_t aAcceleration, uint32_t aDeceleration, uint32_t aJerk);
+
+		/**
+		@brief Jump to aSpeed with no acceleration */
+		void Reset(uint32_t aSpeed);
+		void SetTarget(uint32_t aSpeed);
+
+		/**
+		@brief Advance the profile over the next step
+		@return ticks that step takes */
+		uint32_t Step();
+
+		bool IsSettled() const;
+		uint32_t GetSpeed() const { return static_cast<uint32_t>(mySpeed >> FRACTION_BITS); }
+		uint32_t GetTarget() const { return static_cast<uint32_t>(myTarget >> FRACTION_BITS); }
+		// steps per second squared, negative while slowing down
+		int32_t GetAcceleration() const { return static_cast<int32_t>(myAcceleration / ONE); }
+
+	private:
+		static constexpr uint8_t FRACTION_BITS = 16;
+		static constexpr int64_t ONE = 1ll << FRACTION_BITS;
+		static constexpr int64_t US_PER_SECOND = 1000000;
+		// a step per slice, at or above it the profile is only integrated once a slice worth of steps has gone by
+		static constexpr int64_t STEP_PER_SLICE_SPEED = ONE * US_PER_SECOND / SLICE_US;
+		static_assert(US_PER_SECOND % SLICE_US == 0, "a step per slice has to be a whole speed");
+		// a step never takes longer than this, it keeps a stalled profile from looping forever
+		static constexpr uint32_t MAX_STEP_US = 1000000;
+
+		void Integrate(uint32_t aMicros);
+		void IntegrateSlice(int64_t aMicros);
+		uint32_t PeriodForSpeed() const;
+
+		const uint32_t myTickHz;
+		const int64_t myAccelerationLimit;
+		const int64_t myDecelerationLimit;
+		const int64_t myJerk;
+		const uint32_t mySliceTicks;
+
+		int64_t mySpeed = ONE;
+		int64_t myAcceleration = 0;
+		int64_t myTarget = ONE;
+
+		// several steps fit in a slice at speed, they share the period until a slice worth of them has gone by
+		uint32_t myPeriod = 0;
+		uint32_t myElapsed = 0;
+	};
+
+} // namespace PowerFeed
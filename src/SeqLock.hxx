@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace PowerFeed
+{
+	/**
+	@brief Single writer, many reader snapshot of a small trivially copyable value.
+	The writer never waits. Readers retry until they copy the value without a write overlapping them,
+	so a reader on either core always sees a consistent snapshot. Writes must be serialized by the caller. */
+	template <typename T>
+	class SeqLock
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "SeqLock values are copied with memcpy");
+
+	public:
+		void Write(const T &aValue)
+		{
+			// odd while the write is in progress
+			const uint32_t sequence = mySequence.load(std::memory_order_relaxed);
+			mySequence.store(sequence + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			std::memcpy(&myValue, &aValue, sizeof(T));
+			std::atomic_thread_fence(std::memory_order_release);
+			mySequence.store(sequence + 2, std::memory_order_relaxed);
+		}
+
+		T Read() const
+		{
+			T value;
+			uint32_t before;
+			uint32_t after;
+			do
+			{
+				before = mySequence.load(std::memory_order_acquire);
+				std::memcpy(&value, &myValue, sizeof(T));
+				std::atomic_thread_fence(std::memory_order_acquire);
+				after = mySequence.load(std::memory_order_relaxed);
+			} while ((before & 1) != 0 || before != after);
+			return value;
+		}
+
+	private:
+		std::atomic<uint32_t> mySequence = 0;
+		T myValue = {};
+	};
+
+} // namespace PowerFeed
@@ -13,7 +13,12 @@ namespace PowerFeed
 			{"DRIVER_EN_PIN", driverEnPin},
 			{"DRIVER_STEP_PIN", driverStepPin},
 			{"DRIVER_ENABLE_VALUE", driverEnableValue},
-			{"DRIVER_DISABLE_TIMEOUT", driverDisableTimeout}};
+			{"DRIVER_DISABLE_TIMEOUT", driverDisableTimeout},
+			{"DRIVER_USE_DMA", driverUseDma},
+			{"DRIVER_STEP_PULSE_NS", driverStepPulseNs},
+			{"DRIVER_CORE", driverCore},
+			{"DRIVER_PIO", driverPio},
+			{"DRIVER_START_GROUP", driverStartGroup}};
 	}
 
 	Settings::Driver Settings::Driver::from_json(const nlohmann::json &j)
@@ -26,6 +31,12 @@ namespace PowerFeed
 		s.driverEnableValue = j["DRIVER_ENABLE_VALUE"].get<bool>();
 		s.driverDisableValue = !s.driverEnableValue;
 		s.driverDisableTimeout = j["DRIVER_DISABLE_TIMEOUT"].get<uint16_t>();
+		// the keys added since the first release are optional, at the defaults in config.md, so older configs still load
+		s.driverUseDma = j.value<bool>("DRIVER_USE_DMA", true);
+		s.driverStepPulseNs = j.value<uint32_t>("DRIVER_STEP_PULSE_NS", 500);
+		s.driverCore = j.value<uint8_t>("DRIVER_CORE", 1);
+		s.driverPio = j.value<uint8_t>("DRIVER_PIO", 0);
+		s.driverStartGroup = j.value<uint8_t>("DRIVER_START_GROUP", 0);
 		return s;
 	}
 
@@ -54,6 +65,12 @@ namespace PowerFeed
 
 	nlohmann::json Settings::Controls::to_json() const
 	{
+		nlohmann::json curve = nlohmann::json::array();
+		for (const EncoderAccelerationPoint &point : encoderAcceleration)
+		{
+			curve.push_back({{"COUNTS_PER_SECOND", point.countsPerSecond}, {"MULTIPLIER", point.multiplier}});
+		}
+
 		return {
 			{"LEFTPIN", leftPin},
 			{"RIGHTPIN", rightPin},
@@ -64,7 +81,9 @@ namespace PowerFeed
 			{"UNITS_SWITCH_DELAY_MS", unitsSwitchDelayMs},
 			{"DEBOUNCE_DELAY_US", debounceDelayUs},
 			{"ENCODER_COUNTS_TO_STEPS_PER_SECOND", encoderCountsToStepsPerSecond},
-			{"ENCODER_INVERT", encoderInvert}};
+			{"ENCODER_INVERT", encoderInvert},
+			{"ENCODER_INTERVAL_MS", encoderIntervalMs},
+			{"ENCODER_ACCELERATION", curve}};
 	}
 
 	Settings::Controls Settings::Controls::from_json(const nlohmann::json &j)
@@ -80,21 +99,49 @@ namespace PowerFeed
 		s.debounceDelayUs = j["DEBOUNCE_DELAY_US"].get<uint32_t>();
 		s.encoderCountsToStepsPerSecond = j["ENCODER_COUNTS_TO_STEPS_PER_SECOND"].get<uint16_t>();
 		s.encoderInvert = j["ENCODER_INVERT"].get<bool>();
+		// optional, configs from before it existed polled the encoder much slower than this
+		s.encoderIntervalMs = j.value<uint32_t>("ENCODER_INTERVAL_MS", 5);
+		if (!j.contains("ENCODER_ACCELERATION"))
+		{
+			// the default curve for configs from before it existed, an empty one turns it off
+			s.encoderAcceleration = {{100, 1}, {300, 10}, {600, 40}};
+		}
+		else
+		{
+			for (const nlohmann::json &point : j["ENCODER_ACCELERATION"])
+			{
+				EncoderAccelerationPoint p = {point["COUNTS_PER_SECOND"].get<uint32_t>(), point["MULTIPLIER"].get<uint32_t>()};
+				if (p.multiplier == 0 || (!s.encoderAcceleration.empty() && p.countsPerSecond <= s.encoderAcceleration.back().countsPerSecond))
+				{
+					throw std::runtime_error("ENCODER_ACCELERATION must be in rising COUNTS_PER_SECOND with a MULTIPLIER of at least 1");
+				}
+				s.encoderAcceleration.push_back(p);
+			}
+		}
 		return s;
 	}
 
 	nlohmann::json Settings::Mechanical::to_json() const
 	{
+		nlohmann::json curve = nlohmann::json::array();
+		for (const AccelerationPoint &point : accelerationCurve)
+		{
+			curve.push_back({{"STEPS_PER_SECOND", point.speed}, {"ACCELERATION", point.acceleration}});
+		}
+
 		return {
 			{"MAX_LEADSCREW_RPM", maxLeadscrewRpm},
 			{"MAX_DRIVER_STEPS_PER_SECOND", maxDriverStepsPerSecond},
 			{"STEPS_PER_MOTOR_REV", stepsPerMotorRev},
-			{"MOTOR_TO_LEADSCREW_REDUCTION", motorToLeadscrewReduction},
+			{"MOTOR_TO_LEADSCREW_REDUCTION", motorToLeadscrewReduction.ToDouble()},
 			{"ACCELERATION", acceleration},
 			{"DECELERATION", deceleration},
 			{"ACCELERATION_JERK", accelerationJerk},
+			{"RAMP_TABLE_SEGMENTS", rampTableSegments},
+			{"JERK", jerk},
+			{"ACCELERATION_CURVE", curve},
 			{"MOVE_LEFT_DIRECTION", moveLeftDirection},
-			{"MM_PER_LEADSCREW_REV", mmPerLeadscrewRev}};
+			{"MM_PER_LEADSCREW_REV", mmPerLeadscrewRev.ToDouble()}};
 	}
 
 	Settings::Mechanical Settings::Mechanical::from_json(const nlohmann::json &j)
@@ -103,12 +150,28 @@ namespace PowerFeed
 		s.maxLeadscrewRpm = j["MAX_LEADSCREW_RPM"].get<uint32_t>();
 		s.maxDriverStepsPerSecond = j["MAX_DRIVER_STEPS_PER_SECOND"].get<uint32_t>();
 		s.stepsPerMotorRev = j["STEPS_PER_MOTOR_REV"].get<uint32_t>();
-		s.motorToLeadscrewReduction = j["MOTOR_TO_LEADSCREW_REDUCTION"].get<double>();
+		s.motorToLeadscrewReduction = Fixed::FromDouble(j["MOTOR_TO_LEADSCREW_REDUCTION"].get<double>());
 		s.acceleration = j["ACCELERATION"].get<uint32_t>();
 		s.deceleration = j["DECELERATION"].get<uint32_t>();
 		s.accelerationJerk = j["ACCELERATION_JERK"].get<uint8_t>();
+		// optional like the driver keys added with them, tables of the default size and a trapezoid
+		s.rampTableSegments = j.value<uint16_t>("RAMP_TABLE_SEGMENTS", 128);
+		s.jerk = j.value<uint32_t>("JERK", 0);
+		// optional, configs from before it existed do not have it
+		if (j.contains("ACCELERATION_CURVE"))
+		{
+			for (const nlohmann::json &point : j["ACCELERATION_CURVE"])
+			{
+				AccelerationPoint p = {point["STEPS_PER_SECOND"].get<uint32_t>(), point["ACCELERATION"].get<uint32_t>()};
+				if (p.acceleration == 0 || (!s.accelerationCurve.empty() && p.speed <= s.accelerationCurve.back().speed))
+				{
+					throw std::runtime_error("ACCELERATION_CURVE must be in rising STEPS_PER_SECOND with an ACCELERATION above 0");
+				}
+				s.accelerationCurve.push_back(p);
+			}
+		}
 		s.moveLeftDirection = j["MOVE_LEFT_DIRECTION"].get<bool>();
-		s.mmPerLeadscrewRev = j["MM_PER_LEADSCREW_REV"].get<double>();
+		s.mmPerLeadscrewRev = Fixed::FromDouble(j["MM_PER_LEADSCREW_REV"].get<double>());
 
 		s.moveRightDirection = !s.moveLeftDirection;
 		s.maxStepsPerSecond = s.maxLeadscrewRpm * s.stepsPerMotorRev / 60;
@@ -116,7 +179,141 @@ namespace PowerFeed
 		{
 			s.maxStepsPerSecond = s.maxDriverStepsPerSecond;
 		}
-		s.stepsPerMm = (s.stepsPerMotorRev * 4.055555556) / s.mmPerLeadscrewRev;
+		s.stepsPerLeadscrewRev = Fixed::FromInt(s.stepsPerMotorRev) * s.motorToLeadscrewReduction;
+		s.stepsPerMm = s.stepsPerLeadscrewRev / s.mmPerLeadscrewRev;
+
+		// 600 tenths per minute for every unit per second
+		const Fixed tenthsPerMinute = Fixed::FromInt(600);
+		const Fixed mmPerInch = Fixed::FromRatio(127, 5);
+		s.tenthMmPerMinutePerStep = tenthsPerMinute / s.stepsPerMm;
+		s.tenthInchPerMinutePerStep = s.tenthMmPerMinutePerStep / mmPerInch;
+		s.stepsPerTenthMmPerMinute = s.stepsPerMm / tenthsPerMinute;
+		s.stepsPerTenthInchPerMinute = s.stepsPerTenthMmPerMinute * mmPerInch;
+		s.micronPerStep = Fixed::FromInt(1000) / s.stepsPerMm;
+		s.tenThousandthInchPerStep = s.micronPerStep / Fixed::FromRatio(127, 50);
+		return s;
+	}
+
+	uint32_t Settings::Mechanical::StepsToTenths(uint32_t aStepsPerSecond, bool anInch) const
+	{
+		return (anInch ? tenthInchPerMinutePerStep : tenthMmPerMinutePerStep).Scale(aStepsPerSecond);
+	}
+
+	uint32_t Settings::Mechanical::TenthsToSteps(uint32_t aTenths, bool anInch) const
+	{
+		return (anInch ? stepsPerTenthInchPerMinute : stepsPerTenthMmPerMinute).Scale(aTenths);
+	}
+
+	uint32_t Settings::Mechanical::StepsToFeedPerRev(uint32_t aStepsPerRev, bool anInch) const
+	{
+		return (anInch ? tenThousandthInchPerStep : micronPerStep).Scale(aStepsPerRev);
+	}
+
+	nlohmann::json Settings::Feedback::to_json() const
+	{
+		return {
+			{"ENABLED", enabled},
+			{"ENCODER_A_PIN", encoderAPin},
+			{"ENCODER_COUNTS_PER_REV", encoderCountsPerRev},
+			{"ON_LEADSCREW", onLeadscrew},
+			{"INVERT", invert},
+			{"FOLLOWING_ERROR_STEPS", followingErrorSteps}};
+	}
+
+	Settings::Feedback Settings::Feedback::from_json(const nlohmann::json &j, const Mechanical &aMechanical)
+	{
+		Feedback s;
+		s.enabled = j["ENABLED"].get<bool>();
+		s.encoderAPin = j["ENCODER_A_PIN"].get<uint16_t>();
+		s.encoderCountsPerRev = j["ENCODER_COUNTS_PER_REV"].get<uint32_t>();
+		s.onLeadscrew = j["ON_LEADSCREW"].get<bool>();
+		s.invert = j["INVERT"].get<bool>();
+		s.followingErrorSteps = j["FOLLOWING_ERROR_STEPS"].get<uint32_t>();
+
+		s.stepsPerEncoderRev = s.onLeadscrew ? aMechanical.stepsPerLeadscrewRev : Fixed::FromInt(aMechanical.stepsPerMotorRev);
+		return s;
+	}
+
+	nlohmann::json Settings::Limits::to_json() const
+	{
+		return {
+			{"ENABLED", enabled},
+			{"LEFT_MM", leftMm.ToDouble()},
+			{"RIGHT_MM", rightMm.ToDouble()}};
+	}
+
+	Settings::Limits Settings::Limits::from_json(const nlohmann::json &j, const Mechanical &aMechanical)
+	{
+		Limits s;
+		s.enabled = j["ENABLED"].get<bool>();
+		const double left = j["LEFT_MM"].get<double>();
+		const double right = j["RIGHT_MM"].get<double>();
+		if (left < 0 || right < 0)
+		{
+			throw std::runtime_error("LIMITS LEFT_MM and RIGHT_MM are distances from the power up position and cannot be negative");
+		}
+		s.leftMm = Fixed::FromDouble(left);
+		s.rightMm = Fixed::FromDouble(right);
+
+		s.leftSteps = static_cast<uint32_t>(left * aMechanical.stepsPerMm.ToDouble());
+		s.rightSteps = static_cast<uint32_t>(right * aMechanical.stepsPerMm.ToDouble());
+		return s;
+	}
+
+	nlohmann::json Settings::Reciprocate::to_json() const
+	{
+		return {
+			{"DWELL_MS", dwellMs},
+			{"CROSS_FEED_ENABLED", crossFeedEnabled},
+			{"CROSS_FEED_PIN", crossFeedPin},
+			{"CROSS_FEED_PULSE_MS", crossFeedPulseMs}};
+	}
+
+	Settings::Reciprocate Settings::Reciprocate::from_json(const nlohmann::json &j)
+	{
+		Reciprocate s;
+		s.dwellMs = j["DWELL_MS"].get<uint32_t>();
+		s.crossFeedEnabled = j["CROSS_FEED_ENABLED"].get<bool>();
+		s.crossFeedPin = j["CROSS_FEED_PIN"].get<uint16_t>();
+		s.crossFeedPulseMs = j["CROSS_FEED_PULSE_MS"].get<uint32_t>();
+		return s;
+	}
+
+	nlohmann::json Settings::Spindle::to_json() const
+	{
+		return {
+			{"ENABLED", enabled},
+			{"ENCODER_A_PIN", encoderAPin},
+			{"ENCODER_COUNTS_PER_REV", encoderCountsPerRev},
+			{"INVERT", invert},
+			{"AXIS", axis}};
+	}
+
+	Settings::Spindle Settings::Spindle::from_json(const nlohmann::json &j)
+	{
+		Spindle s;
+		s.enabled = j["ENABLED"].get<bool>();
+		s.encoderAPin = j["ENCODER_A_PIN"].get<uint16_t>();
+		s.encoderCountsPerRev = j["ENCODER_COUNTS_PER_REV"].get<uint32_t>();
+		s.invert = j["INVERT"].get<bool>();
+		s.axis = j["AXIS"].get<uint8_t>();
+		return s;
+	}
+
+	nlohmann::json Settings::EStop::to_json() const
+	{
+		return {
+			{"ENABLED", enabled},
+			{"PIN", pin},
+			{"ACTIVE_HIGH", activeHigh}};
+	}
+
+	Settings::EStop Settings::EStop::from_json(const nlohmann::json &j)
+	{
+		EStop s;
+		s.enabled = j["ENABLED"].get<bool>();
+		s.pin = j["PIN"].get<uint16_t>();
+		s.activeHigh = j["ACTIVE_HIGH"].get<bool>();
 		return s;
 	}
 
@@ -137,23 +334,141 @@ namespace PowerFeed
 		return s;
 	}
 
-	nlohmann::json Settings::to_json() const
+	nlohmann::json Settings::Axis::to_json() const
 	{
 		return {
+			{"NAME", name},
 			{"DRIVER", driver.to_json()},
-			{"DISPLAY", display.to_json()},
 			{"CONTROLS", controls.to_json()},
 			{"MECHANICAL", mechanical.to_json()},
+			{"FEEDBACK", feedback.to_json()},
+			{"LIMITS", limits.to_json()},
+			{"RECIPROCATE", reciprocate.to_json()}};
+	}
+
+	Settings::Axis Settings::Axis::from_json(const nlohmann::json &j)
+	{
+		Axis s;
+		s.name = j["NAME"].get<std::string>();
+		s.driver = Driver::from_json(j["DRIVER"]);
+		s.controls = Controls::from_json(j["CONTROLS"]);
+		s.mechanical = Mechanical::from_json(j["MECHANICAL"]);
+		// optional, configs from before it existed have no feedback encoder
+		s.feedback = {false, 0, 0, false, false, 0, Fixed::FromInt(0)};
+		if (j.contains("FEEDBACK"))
+		{
+			s.feedback = Feedback::from_json(j["FEEDBACK"], s.mechanical);
+		}
+		// optional, configs from before it existed have no soft limits
+		s.limits = {false, Fixed::FromInt(0), Fixed::FromInt(0), 0, 0};
+		if (j.contains("LIMITS"))
+		{
+			s.limits = Limits::from_json(j["LIMITS"], s.mechanical);
+		}
+		// optional too, no dwell and no cross feed output
+		s.reciprocate = {0, false, 0, 0};
+		if (j.contains("RECIPROCATE"))
+		{
+			s.reciprocate = Reciprocate::from_json(j["RECIPROCATE"]);
+		}
+		return s;
+	}
+
+	nlohmann::json Settings::to_json() const
+	{
+		nlohmann::json axesJson = nlohmann::json::array();
+		for (const Axis &axis : axes)
+		{
+			axesJson.push_back(axis.to_json());
+		}
+
+		return {
+			{"AXES", axesJson},
+			{"SPINDLE", spindle.to_json()},
+			{"ESTOP", eStop.to_json()},
+			{"DISPLAY", display.to_json()},
 			{"SAVED_SETTINGS", savedSettings.to_json()}};
 	}
 
 	Settings Settings::from_json(const nlohmann::json &j)
 	{
 		Settings s;
-		s.driver = Driver::from_json(j["DRIVER"]);
+		for (const nlohmann::json &axis : j["AXES"])
+		{
+			s.axes.push_back(Axis::from_json(axis));
+		}
+		if (s.axes.empty() || s.axes.size() > MAX_AXES)
+		{
+			throw std::runtime_error("AXES must have between 1 and " + std::to_string(MAX_AXES) + " entries");
+		}
+		for (size_t axis = 0; axis < s.axes.size(); axis++)
+		{
+			for (size_t other = 0; other < axis; other++)
+			{
+				const Driver &a = s.axes[axis].driver;
+				const Driver &b = s.axes[other].driver;
+				if (a.driverStartGroup != 0 && a.driverStartGroup == b.driverStartGroup && a.driverPio != b.driverPio)
+				{
+					// pio_enable_sm_mask_in_sync starts the state machines of one block
+					throw std::runtime_error("Axes with the same DRIVER_START_GROUP must have the same DRIVER_PIO");
+				}
+			}
+		}
+		// optional too, no spindle encoder and no feed per revolution
+		s.spindle = {false, 0, 0, false, 0};
+		if (j.contains("SPINDLE"))
+		{
+			s.spindle = Spindle::from_json(j["SPINDLE"]);
+		}
+		if (s.spindle.enabled && s.spindle.axis >= s.axes.size())
+		{
+			throw std::runtime_error("SPINDLE AXIS must be one of the AXES");
+		}
+		// optional, configs from before it existed have no emergency stop
+		s.eStop = {false, 0, true};
+		if (j.contains("ESTOP"))
+		{
+			s.eStop = EStop::from_json(j["ESTOP"]);
+		}
+		// every state machine is claimed at boot with pio_claim_unused_sm(..., true), which panics when none is left
+		uint8_t stateMachines[PIOS] = {};
+		for (const Axis &axis : s.axes)
+		{
+			if (axis.driver.driverPio >= PIOS)
+			{
+				throw std::runtime_error("DRIVER_PIO must be 0 or 1");
+			}
+			if (axis.driver.driverPio == ENCODER_PIO)
+			{
+				// the knob encoders are always there, and their program must load at the offset the step programs would take
+				throw std::runtime_error("DRIVER_PIO " + std::to_string(ENCODER_PIO) + " is taken by the quadrature encoders, use 0");
+			}
+			// step generator and step counter
+			stateMachines[axis.driver.driverPio] += 2;
+			// knob encoder
+			stateMachines[ENCODER_PIO]++;
+			if (axis.feedback.enabled)
+			{
+				stateMachines[ENCODER_PIO]++;
+			}
+		}
+		if (s.spindle.enabled)
+		{
+			stateMachines[ENCODER_PIO]++;
+		}
+#ifdef STEP_TIMING_DIAGNOSTICS
+		stateMachines[s.axes[0].driver.driverPio]++;
+#endif
+		for (uint8_t pio = 0; pio < PIOS; pio++)
+		{
+			if (stateMachines[pio] > PIO_STATE_MACHINES)
+			{
+				throw std::runtime_error("PIO " + std::to_string(pio) + " needs " + std::to_string(stateMachines[pio]) + " state machines and has " +
+										 std::to_string(PIO_STATE_MACHINES) + ", each axis takes 2 on its DRIVER_PIO and each encoder 1 on PIO " +
+										 std::to_string(ENCODER_PIO));
+			}
+		}
 		s.display = Display::from_json(j["DISPLAY"]);
-		s.controls = Controls::from_json(j["CONTROLS"]);
-		s.mechanical = Mechanical::from_json(j["MECHANICAL"]);
 		s.savedSettings = SavedSettings::from_json(j["SAVED_SETTINGS"]);
 		return s;
 	}
@@ -1,8 +1,13 @@
 #pragma once
 
+#include "EncoderAcceleration.hxx"
+#include "Fixed.hxx"
+#include "RampTable.hxx"
 #include <cstdint>
 #include <memory>
 #include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
 
 namespace PowerFeed
 {
@@ -17,6 +22,13 @@ namespace PowerFeed
 			bool driverEnableValue;
 			bool driverDisableValue;
 			uint16_t driverDisableTimeout;
+			bool driverUseDma;
+			uint32_t driverStepPulseNs;
+			uint8_t driverCore;
+			// PIO block the step generator and step counter run on, only 0 while the encoders hold 1
+			uint8_t driverPio;
+			// axes with the same group above 0 start and stop together, in the same PIO cycle
+			uint8_t driverStartGroup;
 
 			nlohmann::json to_json() const;
 			static Driver from_json(const nlohmann::json &j);
@@ -47,6 +59,10 @@ namespace PowerFeed
 			uint32_t debounceDelayUs;
 			uint16_t encoderCountsToStepsPerSecond;
 			bool encoderInvert;
+			// the shortest time between two encoder changes sent to the UI, the counts in between go out together
+			uint32_t encoderIntervalMs;
+			// multiplier of the counts by how fast the knob turns
+			EncoderAccelerationCurve encoderAcceleration;
 
 			nlohmann::json to_json() const;
 			static Controls from_json(const nlohmann::json &j);
@@ -57,23 +73,118 @@ namespace PowerFeed
 			uint32_t maxLeadscrewRpm;
 			uint32_t maxDriverStepsPerSecond;
 			uint32_t stepsPerMotorRev;
-			double stepsPerLeadscrewRev;
 			uint32_t acceleration;
 			uint32_t deceleration;
 			uint8_t accelerationJerk;
-			float motorToLeadscrewReduction;
+			uint16_t rampTableSegments;
+			uint32_t jerk;
+			// optional torque curve, replaces acceleration with one that follows the speed when it has points
+			AccelerationCurve accelerationCurve;
+			Fixed motorToLeadscrewReduction;
 			bool moveLeftDirection;
 
 			// calculated after parse
 			bool moveRightDirection;
 			int32_t maxStepsPerSecond;
-			float mmPerLeadscrewRev;
-			float stepsPerMm;
+			Fixed mmPerLeadscrewRev;
+			Fixed stepsPerLeadscrewRev;
+			Fixed stepsPerMm;
+			// precomputed reciprocals, feed rates are shown and entered in tenths of a unit per minute
+			Fixed tenthMmPerMinutePerStep;
+			Fixed tenthInchPerMinutePerStep;
+			Fixed stepsPerTenthMmPerMinute;
+			Fixed stepsPerTenthInchPerMinute;
+			// feeds per revolution are shown in thousandths of a mm or ten thousandths of an inch
+			Fixed micronPerStep;
+			Fixed tenThousandthInchPerStep;
+
+			/**
+			@brief steps per second to tenths of a mm (or inch) per minute, rounded */
+			uint32_t StepsToTenths(uint32_t aStepsPerSecond, bool anInch) const;
+			/**
+			@brief tenths of a mm (or inch) per minute to steps per second, rounded */
+			uint32_t TenthsToSteps(uint32_t aTenths, bool anInch) const;
+			/**
+			@brief steps per spindle revolution to thousandths of a mm (or ten thousandths of an inch) per revolution */
+			uint32_t StepsToFeedPerRev(uint32_t aStepsPerRev, bool anInch) const;
 
 			nlohmann::json to_json() const;
 			static Mechanical from_json(const nlohmann::json &j);
 		};
 
+		/**
+		@brief Encoder on the motor or the leadscrew that the sent steps are checked against */
+		struct Feedback
+		{
+			bool enabled;
+			uint16_t encoderAPin;
+			uint32_t encoderCountsPerRev;
+			bool onLeadscrew;
+			bool invert;
+			uint32_t followingErrorSteps;
+
+			// calculated after parse, from the mechanical settings of the axis
+			Fixed stepsPerEncoderRev;
+
+			nlohmann::json to_json() const;
+			static Feedback from_json(const nlohmann::json &j, const Mechanical &aMechanical);
+		};
+
+		/**
+		@brief Soft limits of an axis, in mm to the left and right of the position it is at when powered up */
+		struct Limits
+		{
+			bool enabled;
+			Fixed leftMm;
+			Fixed rightMm;
+
+			// calculated after parse, from the mechanical settings of the axis
+			uint32_t leftSteps;
+			uint32_t rightSteps;
+
+			nlohmann::json to_json() const;
+			static Limits from_json(const nlohmann::json &j, const Mechanical &aMechanical);
+		};
+
+		/**
+		@brief Reciprocating between the two stored positions of an axis, with a dwell and a cross feed pulse at each end */
+		struct Reciprocate
+		{
+			uint32_t dwellMs;
+			bool crossFeedEnabled;
+			uint16_t crossFeedPin;
+			uint32_t crossFeedPulseMs;
+
+			nlohmann::json to_json() const;
+			static Reciprocate from_json(const nlohmann::json &j);
+		};
+
+		/**
+		@brief Encoder on the spindle that one axis can follow at a feed per revolution */
+		struct Spindle
+		{
+			bool enabled;
+			uint16_t encoderAPin;
+			uint32_t encoderCountsPerRev;
+			bool invert;
+			uint8_t axis;
+
+			nlohmann::json to_json() const;
+			static Spindle from_json(const nlohmann::json &j);
+		};
+
+		/**
+		@brief Emergency stop input shared by every axis, it halts the step generators from its interrupt */
+		struct EStop
+		{
+			bool enabled;
+			uint16_t pin;
+			bool activeHigh;
+
+			nlohmann::json to_json() const;
+			static EStop from_json(const nlohmann::json &j);
+		};
+
 		struct SavedSettings
 		{
 			uint32_t normalSpeed;
@@ -84,10 +195,34 @@ namespace PowerFeed
 			static SavedSettings from_json(const nlohmann::json &j);
 		};
 
-		Driver driver;
+		/**
+		@brief One feed axis with its own driver, levers and encoder */
+		struct Axis
+		{
+			std::string name;
+			Driver driver;
+			Controls controls;
+			Mechanical mechanical;
+			Feedback feedback;
+			Limits limits;
+			Reciprocate reciprocate;
+
+			nlohmann::json to_json() const;
+			static Axis from_json(const nlohmann::json &j);
+		};
+
+		// X, Y and Z
+		static constexpr size_t MAX_AXES = 3;
+		// every quadrature encoder runs here, its program is placed at offset 0
+		static constexpr uint8_t ENCODER_PIO = 1;
+		// PIO blocks on the RP2040 and the state machines in each
+		static constexpr uint8_t PIOS = 2;
+		static constexpr uint8_t PIO_STATE_MACHINES = 4;
+
+		std::vector<Axis> axes;
+		Spindle spindle;
+		EStop eStop;
 		Display display;
-		Controls controls;
-		Mechanical mechanical;
 		SavedSettings savedSettings;
 
 		nlohmann::json to_json() const;
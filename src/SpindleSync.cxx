@@ -0,0 +1,78 @@
+#include "SpindleSync.hxx"
+
+namespace PowerFeed
+{
+	SpindleSync::SpindleSync(uint32_t aCountsPerRev, uint32_t anUpdateHz, uint32_t aMaxSpeed)
+		: myCountsPerRevRaw(static_cast<int64_t>(aCountsPerRev > 0 ? aCountsPerRev : 1) << Fixed::FRACTION_BITS),
+		  myUpdateHz(static_cast<int32_t>(anUpdateHz)),
+		  myMaxSpeed(static_cast<int32_t>(aMaxSpeed))
+	{
+	}
+
+	void SpindleSync::SetRatio(Fixed aStepsPerRev)
+	{
+		myRatioRaw = aStepsPerRev.Raw();
+	}
+
+	void SpindleSync::Reset(int32_t aCounts, int32_t aSteps)
+	{
+		myLastCounts = aCounts;
+		myBaseSteps = aSteps;
+		myRemainder = 0;
+		myTarget = 0;
+		myTargets.fill(0);
+		myTargetIndex = 0;
+		myError = 0;
+		myMaxError = 0;
+	}
+
+	int32_t SpindleSync::Update(int32_t aCounts, int32_t aSteps)
+	{
+		// differences of the raw counters so a wrap in either one cancels out
+		const int32_t counts = static_cast<int32_t>(static_cast<uint32_t>(aCounts) - static_cast<uint32_t>(myLastCounts));
+		const int32_t steps = static_cast<int32_t>(static_cast<uint32_t>(aSteps) - static_cast<uint32_t>(myBaseSteps));
+		myLastCounts = aCounts;
+
+		// the DDA, floor division so the remainder stays positive whichever way the spindle turns
+		const int64_t owed = myRemainder + static_cast<int64_t>(counts) * myRatioRaw;
+		int64_t whole = owed / myCountsPerRevRaw;
+		myRemainder = owed - whole * myCountsPerRevRaw;
+		if (myRemainder < 0)
+		{
+			myRemainder += myCountsPerRevRaw;
+			whole--;
+		}
+		myTarget += static_cast<int32_t>(whole);
+
+		// the oldest target in the window is overwritten by the newest
+		const int32_t moved = myTarget - myTargets[myTargetIndex];
+		myTargets[myTargetIndex] = myTarget;
+		myTargetIndex = (myTargetIndex + 1) % RATE_WINDOW;
+
+		myError = myTarget - steps;
+		const uint32_t magnitude = static_cast<uint32_t>(myError < 0 ? -static_cast<int64_t>(myError) : myError);
+		if (magnitude > myMaxError)
+		{
+			myMaxError = magnitude;
+		}
+
+		if (moved == 0 && magnitude <= 1)
+		{
+			// the spindle is standing still, an encoder edge jittering on a step boundary must not rock the axis
+			return 0;
+		}
+
+		int64_t rate = static_cast<int64_t>(moved) * myUpdateHz / RATE_WINDOW;
+		rate += static_cast<int64_t>(myError) * myUpdateHz / GAIN_DIVISOR;
+		if (rate > myMaxSpeed)
+		{
+			return myMaxSpeed;
+		}
+		if (rate < -myMaxSpeed)
+		{
+			return -myMaxSpeed;
+		}
+		return static_cast<int32_t>(rate);
+	}
+
+} // namespace PowerFeed
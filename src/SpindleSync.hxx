@@ -0,0 +1,63 @@
+#pragma once
+
+#include "Fixed.hxx"
+#include <array>
+#include <cstdint>
+
+namespace PowerFeed
+{
+	/**
+	@brief Electronic leadscrew, locks the step position of an axis to a spindle encoder at a feed per revolution.
+	A DDA turns every spindle count into a target step position. The ratio is Q16.16 steps per spindle revolution
+	and the remainder of each division is carried to the next update, so a feed that is not a whole number of steps
+	per count does not drift however long the cut.
+	Each update returns the step rate to run at: the spindle rate seen over the last few updates scaled by the
+	ratio, plus a correction proportional to how far the axis is behind the target. Steps lost to the acceleration
+	limit or a late update are made up, not left behind as a phase offset. With the spindle at rest the axis holds
+	within a step of the target instead of hunting for it. Counters may wrap. */
+	class SpindleSync
+	{
+	public:
+		// updates the spindle rate is measured over, a spindle count is too coarse to measure it from one update
+		static constexpr uint8_t RATE_WINDOW = 8;
+		// a position error is closed at this fraction of the update rate per step of error
+		static constexpr uint32_t GAIN_DIVISOR = 16;
+
+		SpindleSync(uint32_t aCountsPerRev, uint32_t anUpdateHz, uint32_t aMaxSpeed);
+
+		/**
+		@brief Steps the axis moves per spindle revolution, takes effect from the next count on */
+		void SetRatio(Fixed aStepsPerRev);
+
+		/**
+		@brief Lock from the current spindle and step counts, the spindle may already be turning */
+		void Reset(int32_t aCounts, int32_t aSteps);
+
+		/**
+		@brief Call at the update rate with the latest spindle and step counts
+		@return steps per second towards the target, negative to move back, at most the max speed either way */
+		int32_t Update(int32_t aCounts, int32_t aSteps);
+
+		/**
+		@brief Steps the axis is behind the spindle as of the last update, negative if it is ahead */
+		int32_t GetError() const { return myError; }
+		uint32_t GetMaxError() const { return myMaxError; }
+		Fixed GetRatio() const { return Fixed::FromRaw(myRatioRaw); }
+
+	private:
+		const int64_t myCountsPerRevRaw;
+		const int32_t myUpdateHz;
+		const int32_t myMaxSpeed;
+		int32_t myRatioRaw = 0;
+		int32_t myLastCounts = 0;
+		int32_t myBaseSteps = 0;
+		// fraction of a step owed by the counts so far, in 1 / myCountsPerRevRaw steps, always >= 0
+		int64_t myRemainder = 0;
+		int32_t myTarget = 0;
+		std::array<int32_t, RATE_WINDOW> myTargets = {};
+		uint8_t myTargetIndex = 0;
+		int32_t myError = 0;
+		uint32_t myMaxError = 0;
+	};
+
+} // namespace PowerFeed
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace PowerFeed
+{
+	/**
+	@brief Bounded lock free queue for exactly one producer and one consumer, which may be on different cores.
+	Only aligned word loads and stores with acquire/release ordering are used, so it works on the Cortex-M0+,
+	which has no atomic read-modify-write instructions. Capacity must be a power of two, one slot is kept free. */
+	template <typename T, size_t Capacity>
+	class SpscQueue
+	{
+		static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+	public:
+		/**
+		@brief Producer side
+		@return false if the queue is full, the item was not added */
+		bool Push(const T &anItem)
+		{
+			const uint32_t head = myHead.load(std::memory_order_relaxed);
+			const uint32_t next = (head + 1) & MASK;
+			if (next == myTail.load(std::memory_order_acquire))
+			{
+				return false;
+			}
+
+			myItems[head] = anItem;
+			myHead.store(next, std::memory_order_release);
+			return true;
+		}
+
+		/**
+		@brief Consumer side
+		@return false if the queue was empty */
+		bool Pop(T &anItem)
+		{
+			const uint32_t tail = myTail.load(std::memory_order_relaxed);
+			if (tail == myHead.load(std::memory_order_acquire))
+			{
+				return false;
+			}
+
+			anItem = myItems[tail];
+			myTail.store((tail + 1) & MASK, std::memory_order_release);
+			return true;
+		}
+
+		bool IsEmpty() const
+		{
+			return myTail.load(std::memory_order_acquire) == myHead.load(std::memory_order_acquire);
+		}
+
+		/**
+		@brief Items queued, from the producer side at most that many, from the consumer side at least that many,
+		as the other side may be pushing or popping meanwhile */
+		size_t Size() const
+		{
+			return (myHead.load(std::memory_order_acquire) - myTail.load(std::memory_order_acquire)) & MASK;
+		}
+
+	private:
+		static constexpr uint32_t MASK = Capacity - 1;
+
+		T myItems[Capacity];
+		std::atomic<uint32_t> myHead = 0;
+		std::atomic<uint32_t> myTail = 0;
+	};
+
+} // namespace PowerFeed
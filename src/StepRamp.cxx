@@ -0,0 +1,561 @@
+#include "StepRamp.hxx"
+#include "Helpers.hxx"
+#include <algorithm>
+
+namespace PowerFeed
+{
+	namespace
+	{
+		// c0 = 0.676 * f * sqrt(2 / a), the 0.676 compensates for the error of the recurrence on its first step
+		uint32_t FirstPeriod(uint32_t aTickHz, uint32_t aAcceleration)
+		{
+			if (aAcceleration == 0)
+			{
+				aAcceleration = 1;
+			}
+			return static_cast<uint32_t>((static_cast<uint64_t>(aTickHz) * 956) / ISqrt(static_cast<uint64_t>(aAcceleration) * 1000000));
+		}
+
+		// the most a step up the ramp can add to the speed, braking planned from it may start a little early but
+		// never late
+		uint32_t PeakAcceleration(uint32_t anAcceleration, const AccelerationCurve &aCurve)
+		{
+			if (aCurve.empty())
+			{
+				return anAcceleration;
+			}
+			uint32_t peak = 1;
+			for (const AccelerationPoint &point : aCurve)
+			{
+				peak = std::max(peak, point.acceleration);
+			}
+			return peak;
+		}
+	}
+
+	StepRamp::StepRamp(uint32_t aTickHz, uint32_t aMaxStepsPerSecond, uint32_t aAcceleration, uint32_t aDeceleration, uint32_t aStartSpeed, uint16_t aTableSegments, uint32_t aJerk, const AccelerationCurve &anAccelerationCurve)
+		: myTickHz(aTickHz),
+		  myMaxSpeed(aMaxStepsPerSecond > 0 ? aMaxStepsPerSecond : 1),
+		  myAcceleration(aAcceleration > 0 ? aAcceleration : 1),
+		  myDeceleration(aDeceleration > 0 ? aDeceleration : 1),
+		  myStartSpeed(aStartSpeed > 0 ? aStartSpeed : 1),
+		  myJerk(aJerk),
+		  myCreepPeriod(aTickHz / std::max<uint32_t>(myStartSpeed, static_cast<uint32_t>(ISqrt(2ull * myDeceleration)))),
+		  myBrakePerStep((BRAKE_STEP * PeakAcceleration(myAcceleration, anAccelerationCurve)) / myDeceleration)
+	{
+		if (aJerk > 0)
+		{
+			mySCurve = std::make_unique<SCurve>(aTickHz, myAcceleration, myDeceleration, aJerk);
+		}
+		else if (aTableSegments > 0 || !anAccelerationCurve.empty())
+		{
+			const uint16_t segments = aTableSegments > 0 ? aTableSegments : CURVE_SEGMENTS;
+			myAccelerationTable = std::make_unique<RampTable>(aTickHz, aStartSpeed, myMaxSpeed, myAcceleration, segments, anAccelerationCurve);
+			myDecelerationTable = std::make_unique<RampTable>(aTickHz, aStartSpeed, myMaxSpeed, myDeceleration, segments);
+			myFirstIndex = myAccelerationTable->GetFirstIndex();
+			myStopIndex = myDecelerationTable->GetFirstIndex();
+			myFirstPeriod = myAccelerationTable->GetPeriod();
+		}
+		else
+		{
+			uint64_t startSquare = static_cast<uint64_t>(aStartSpeed) * aStartSpeed;
+			myFirstIndex = static_cast<uint32_t>(startSquare / (2ull * myAcceleration));
+			myStopIndex = static_cast<uint32_t>(startSquare / (2ull * myDeceleration));
+			myFirstPeriod = myFirstIndex == 0 ? FirstPeriod(aTickHz, myAcceleration) : aTickHz / aStartSpeed;
+		}
+
+		SetTargetSpeed(1);
+	}
+
+	void StepRamp::SetTargetSpeed(uint32_t aStepsPerSecond, uint16_t aFraction)
+	{
+		if (aStepsPerSecond == 0)
+		{
+			aStepsPerSecond = 1;
+			aFraction = 0;
+		}
+		else if (aStepsPerSecond >= myMaxSpeed)
+		{
+			aStepsPerSecond = myMaxSpeed;
+			aFraction = 0;
+		}
+
+		myTargetSpeed = aStepsPerSecond;
+		myTargetRate = (static_cast<uint64_t>(aStepsPerSecond) << RATE_FRACTION_BITS) | aFraction;
+		const uint64_t ticks = static_cast<uint64_t>(myTickHz) << RATE_FRACTION_BITS;
+		myTargetPeriod = static_cast<uint32_t>(ticks / myTargetRate);
+		myTargetRest = ticks % myTargetRate;
+		if (myTargetPeriod == 0)
+		{
+			myTargetPeriod = 1;
+			myTargetRest = 0;
+		}
+		// a new rate starts its own sequence, what was owed to the old one is less than a tick
+		myPhase = 0;
+
+		if (myState != State::STOPPED && myState != State::STOPPING)
+		{
+			Replan();
+		}
+	}
+
+	void StepRamp::Start()
+	{
+		if (myCreeping)
+		{
+			// already at the start speed, start over from it
+			Halt();
+		}
+		switch (myState)
+		{
+		case State::STOPPED:
+			if (mySCurve)
+			{
+				// slower than the start speed starts right at the target, like the trapezoid does
+				mySCurve->Reset(std::min(myStartSpeed, myTargetSpeed));
+				myPeriod = myTargetPeriod;
+				PlanCurve();
+				break;
+			}
+			myIndex = myFirstIndex;
+			myRest = 0;
+			SeekTable(myAccelerationTable.get());
+			if (myTargetPeriod >= myFirstPeriod)
+			{
+				// slower than the first step of the ramp, no need to accelerate
+				myPeriod = myTargetPeriod;
+				myState = State::CRUISING;
+			}
+			else
+			{
+				myPeriod = myFirstPeriod;
+				myState = State::ACCELERATING;
+			}
+			PlanBrake();
+			break;
+		case State::STOPPING:
+			// running again, a landing is looked for afresh
+			myLanding = false;
+			Replan();
+			break;
+		default:
+			break;
+		}
+	}
+
+	void StepRamp::Stop()
+	{
+		myLanding = false;
+		if (myCreeping)
+		{
+			Halt();
+			return;
+		}
+		if (myState == State::STOPPED || myState == State::STOPPING)
+		{
+			return;
+		}
+
+		if (mySCurve)
+		{
+			mySCurve->SetTarget(std::min(myStartSpeed, mySCurve->GetSpeed()));
+			myState = State::STOPPING;
+			return;
+		}
+
+		myRest = 0;
+		SeekPeriod(myDecelerationTable.get(), myDeceleration);
+		myState = State::STOPPING;
+		PlanBrake();
+	}
+
+	void StepRamp::Halt()
+	{
+		myState = State::STOPPED;
+		myPeriod = 0;
+		myRest = 0;
+		myLanding = false;
+		myCreeping = false;
+		myBrakeDistance = 0;
+	}
+
+	void StepRamp::SetStepsLeft(uint32_t aSteps)
+	{
+		myLimited = true;
+		myStepsLeft = aSteps;
+	}
+
+	void StepRamp::ClearStepsLeft()
+	{
+		myLimited = false;
+		myLanding = false;
+		if (myCreeping)
+		{
+			Halt();
+		}
+	}
+
+	uint32_t StepRamp::NextPeriod()
+	{
+		if (!myLimited)
+		{
+			uint32_t period = RampPeriod();
+			if (period != 0)
+			{
+				mySteps++;
+			}
+			return period;
+		}
+
+		if (myStepsLeft == 0)
+		{
+			// on the last step, braking in time has it at the start speed by now
+			Halt();
+			return 0;
+		}
+
+		uint32_t period = 0;
+		if (myCreeping)
+		{
+			period = myCreepPeriod;
+		}
+		else if (myState != State::STOPPED)
+		{
+			const bool due = IsDueToBrake();
+			if (!myLanding && due && myState != State::STOPPING)
+			{
+				Stop();
+				myLanding = true;
+			}
+
+			if (myLanding && !due && myPeriod != 0)
+			{
+				// ahead of the stopping distance, hold the speed for a step rather than arrive early and slow
+				period = myPeriod;
+			}
+			else
+			{
+				period = RampPeriod();
+			}
+
+			if (myLanding && myStepsLeft > 1 && (myState == State::STOPPED || period == 0 || period > myCreepPeriod))
+			{
+				// slowed to a speed the motor can stop dead from short of the last step, the rest at that speed
+				myState = State::STOPPING;
+				myCreeping = true;
+				period = myCreepPeriod;
+			}
+		}
+
+		if (period != 0)
+		{
+			mySteps++;
+			myStepsLeft--;
+		}
+		return period;
+	}
+
+	bool StepRamp::IsDueToBrake() const
+	{
+		return myStepsLeft <= LANDING_STEPS || (static_cast<uint64_t>(myStepsLeft - LANDING_STEPS) << BRAKE_FRACTION_BITS) <= myBrakeDistance;
+	}
+
+	void StepRamp::PlanBrake()
+	{
+		if (mySCurve)
+		{
+			// a jerk limited stop takes v^2 / 2d + v d / 2j when it reaches the deceleration limit, v > d^2 / j, and
+			// v sqrt(v / j) when it does not. Acceleration still being taken out comes first.
+			const uint64_t acceleration = static_cast<uint64_t>(std::max<int32_t>(0, mySCurve->GetAcceleration()));
+			const uint64_t jerk = myJerk;
+			const uint64_t deceleration = myDeceleration;
+			const uint64_t speed = mySCurve->GetSpeed() + (acceleration * acceleration) / (2 * jerk);
+			uint64_t distance = (speed * acceleration) / jerk;
+			if (speed * jerk > deceleration * deceleration)
+			{
+				distance += (speed * speed) / (2 * deceleration) + (speed * deceleration) / (2 * jerk);
+			}
+			else
+			{
+				distance += ISqrt((speed * speed * speed) / jerk);
+			}
+			myBrakeDistance = distance * BRAKE_STEP;
+			return;
+		}
+
+		myBrakeDistance = 0;
+		if (myState == State::DECELERATING || myState == State::STOPPING)
+		{
+			// already on the deceleration ramp, stopping takes one step per index down to the start speed's
+			if (myIndex > myStopIndex)
+			{
+				myBrakeDistance = (myIndex - myStopIndex) * BRAKE_STEP;
+			}
+			return;
+		}
+
+		// v^2 - s^2 = 2 d x between the current speed v and the start speed s
+		if (myPeriod == 0)
+		{
+			return;
+		}
+		const uint64_t speed = myTickHz / myPeriod;
+		const uint64_t start = myStartSpeed;
+		if (speed > start)
+		{
+			myBrakeDistance = ((speed * speed - start * start) * BRAKE_STEP) / (2ull * myDeceleration);
+		}
+	}
+
+	uint32_t StepRamp::RampPeriod()
+	{
+		if (myState == State::STOPPED)
+		{
+			return 0;
+		}
+
+		if (mySCurve)
+		{
+			if (myState == State::CRUISING)
+			{
+				// settled at the target, the curve has nothing left to do
+				return DitherPeriod();
+			}
+			uint32_t period = mySCurve->Step();
+			// a landing that holds its speed settles on the way down, it has not stopped until it is at the start speed
+			if (mySCurve->IsSettled() && (myState != State::STOPPING || mySCurve->GetTarget() <= myStartSpeed))
+			{
+				myState = myState == State::STOPPING ? State::STOPPED : State::CRUISING;
+			}
+			const uint32_t previous = myPeriod;
+			myPeriod = myState == State::STOPPED ? 0 : period;
+			// at speed the curve only moves on once a slice, the steps in between share its period and its braking distance
+			if (myPeriod != previous)
+			{
+				PlanBrake();
+			}
+			return period;
+		}
+
+		uint32_t period = myState == State::CRUISING ? DitherPeriod() : myPeriod;
+		Advance();
+		return period;
+	}
+
+	size_t StepRamp::GetTableFootprint() const
+	{
+		if (!myAccelerationTable)
+		{
+			return 0;
+		}
+		return myAccelerationTable->GetFootprint() + myDecelerationTable->GetFootprint();
+	}
+
+	uint32_t StepRamp::GetCurrentSpeed() const
+	{
+		if (myCreeping)
+		{
+			return myStartSpeed;
+		}
+		if (myState == State::STOPPED || myPeriod == 0)
+		{
+			return 0;
+		}
+		if (myState == State::CRUISING)
+		{
+			return myTargetSpeed;
+		}
+		if (mySCurve)
+		{
+			return mySCurve->GetSpeed();
+		}
+		return myTickHz / myPeriod;
+	}
+
+	void StepRamp::Replan()
+	{
+		if (mySCurve)
+		{
+			PlanCurve();
+			return;
+		}
+
+		if (myPeriod > myTargetPeriod)
+		{
+			// a new target while already accelerating keeps its place on the ramp, seeking again from the period
+			// can land a step back and a target changed more often than a step is taken would never get anywhere
+			if (myState != State::ACCELERATING)
+			{
+				myRest = 0;
+				SeekPeriod(myAccelerationTable.get(), myAcceleration);
+				myState = State::ACCELERATING;
+			}
+		}
+		else if (myPeriod < myTargetPeriod)
+		{
+			if (myState != State::DECELERATING)
+			{
+				myRest = 0;
+				SeekPeriod(myDecelerationTable.get(), myDeceleration);
+				myState = State::DECELERATING;
+			}
+		}
+		else
+		{
+			myState = State::CRUISING;
+		}
+		PlanBrake();
+	}
+
+	void StepRamp::Advance()
+	{
+		switch (myState)
+		{
+		case State::ACCELERATING:
+			Shrink();
+			if (myPeriod <= myTargetPeriod)
+			{
+				myPeriod = myTargetPeriod;
+				myState = State::CRUISING;
+				PlanBrake();
+			}
+			break;
+		case State::DECELERATING:
+			Grow();
+			if (myPeriod >= myTargetPeriod)
+			{
+				myPeriod = myTargetPeriod;
+				myState = State::CRUISING;
+				PlanBrake();
+			}
+			break;
+		case State::STOPPING:
+			if (myIndex <= myStopIndex)
+			{
+				myPeriod = 0;
+				myState = State::STOPPED;
+				myBrakeDistance = 0;
+			}
+			else
+			{
+				Grow();
+			}
+			break;
+		default:
+			break;
+		}
+	}
+
+	void StepRamp::Shrink()
+	{
+		// v^2 grows by 2a with every step up the ramp, and the steps it takes to brake with it
+		myBrakeDistance += myBrakePerStep;
+		if (myAccelerationTable)
+		{
+			// min/max keep the ramp monotonic across the small step a replan seek can introduce
+			myAccelerationTable->StepUp();
+			myIndex = myAccelerationTable->GetIndex();
+			myPeriod = std::min(myPeriod, myAccelerationTable->GetPeriod());
+			return;
+		}
+
+		// c(n) = c(n-1) - 2c(n-1) / (4n + 1)
+		myIndex++;
+		uint32_t numerator = 2 * myPeriod + myRest;
+		uint32_t denominator = 4 * myIndex + 1;
+		uint32_t delta = numerator / denominator;
+		myRest = numerator % denominator;
+		myPeriod = delta < myPeriod ? myPeriod - delta : 1;
+	}
+
+	void StepRamp::Grow()
+	{
+		// and a step down the deceleration ramp is one less to brake
+		myBrakeDistance -= std::min(myBrakeDistance, BRAKE_STEP);
+		if (myDecelerationTable)
+		{
+			myDecelerationTable->StepDown();
+			myIndex = myDecelerationTable->GetIndex();
+			myPeriod = std::max(myPeriod, myDecelerationTable->GetPeriod());
+			return;
+		}
+
+		// c(n-1) = c(n) + 2c(n) / (4n - 1)
+		if (myIndex == 0)
+		{
+			return;
+		}
+		uint32_t numerator = 2 * myPeriod + myRest;
+		uint32_t denominator = 4 * myIndex - 1;
+		myPeriod += numerator / denominator;
+		myRest = numerator % denominator;
+		myIndex--;
+	}
+
+	uint32_t StepRamp::IndexForPeriod(uint32_t aPeriod, uint32_t aRate) const
+	{
+		// n = v^2 / 2a with v = f / c
+		if (aPeriod == 0)
+		{
+			return 0;
+		}
+		uint64_t speed = myTickHz / aPeriod;
+		return static_cast<uint32_t>((speed * speed) / (2ull * aRate));
+	}
+
+	void StepRamp::SeekTable(RampTable *aTable)
+	{
+		if (aTable != nullptr)
+		{
+			aTable->Seek(myIndex);
+			myIndex = aTable->GetIndex();
+		}
+	}
+
+	void StepRamp::SeekPeriod(RampTable *aTable, uint32_t aRate)
+	{
+		// pick the ramp up from the current period, the tables are searched by period so that the other
+		// table's interpolation error does not show up as a step in speed
+		if (aTable != nullptr)
+		{
+			aTable->SeekPeriod(myPeriod);
+			if (aTable == myDecelerationTable.get() && aTable->GetPeriod() > myPeriod)
+			{
+				// the first Grow steps back down to the slower period, not one past it
+				aTable->StepUp();
+			}
+			myIndex = aTable->GetIndex();
+		}
+		else
+		{
+			myIndex = IndexForPeriod(myPeriod, aRate);
+		}
+	}
+
+	uint32_t StepRamp::DitherPeriod()
+	{
+		myPhase += myTargetRest;
+		if (myPhase >= myTargetRate)
+		{
+			myPhase -= myTargetRate;
+			return myTargetPeriod + 1;
+		}
+		return myTargetPeriod;
+	}
+
+	void StepRamp::PlanCurve()
+	{
+		// the curve carries its acceleration over, so a new target mid ramp does not jump
+		mySCurve->SetTarget(myTargetSpeed);
+		PlanBrake();
+		if (mySCurve->IsSettled())
+		{
+			myState = State::CRUISING;
+		}
+		else
+		{
+			myState = mySCurve->GetTarget() > mySCurve->GetSpeed() ? State::ACCELERATING : State::DECELERATING;
+		}
+	}
+
+} // namespace PowerFeed
@@ -0,0 +1,158 @@
+#pragma once
+
+#include "RampTable.hxx"
+#include "SCurve.hxx"
+#include <cstdint>
+#include <memory>
+
+namespace PowerFeed
+{
+	/**
+	@brief Integer trapezoidal ramp that produces the period of every step, in step generator ticks.
+	With table segments the periods come from precomputed RampTables, so a ramp step is a fixed point add.
+	Without them it falls back to the recurrence from Atmel AVR446, one 32 bit division per ramp step.
+	With a jerk limit the speed follows an SCurve instead and the table segments are not used.
+	An acceleration curve replaces the flat acceleration with one that follows the speed. It is always tabulated,
+	with the default number of segments if none are configured, and is ignored by the SCurve.
+	The ramp starts at, and stops from, the start speed without accelerating below it.
+	A whole number of ticks per step only gets close to most rates. While cruising, the remainder of the period
+	division is carried from step to step, Bresenham style, and every step that it adds up to a tick gets one tick
+	longer. Over a run the rate is then exact, down to the 1/65536 step per second resolution of the target.
+	With a number of steps left to go, the ramp looks ahead every step and brakes whenever the distance left is
+	what it takes to stop from the current speed, holding the speed on the steps it gets ahead of that. It runs at
+	speed for as long as it can and comes to rest on the last step, any steps left once it has slowed to a speed
+	the motor stops dead from are taken at that speed.
+	Not thread safe, callers serialize access between the producer (step generator) and the setters. */
+	class StepRamp
+	{
+	public:
+		enum class State : uint8_t
+		{
+			STOPPED,
+			ACCELERATING,
+			CRUISING,
+			DECELERATING,
+			STOPPING
+		};
+
+		// segments of an acceleration curve table when the ramp has none configured
+		static constexpr uint16_t CURVE_SEGMENTS = 128;
+
+		StepRamp(uint32_t aTickHz, uint32_t aMaxStepsPerSecond, uint32_t aAcceleration, uint32_t aDeceleration, uint32_t aStartSpeed, uint16_t aTableSegments, uint32_t aJerk = 0, const AccelerationCurve &anAccelerationCurve = {});
+
+		// bits of the fractional part of a target speed
+		static constexpr uint8_t RATE_FRACTION_BITS = 16;
+
+		/**
+		@brief Speed to ramp to and cruise at, plus aFraction / 65536 steps per second */
+		void SetTargetSpeed(uint32_t aStepsPerSecond, uint16_t aFraction = 0);
+		void Start();
+		void Stop();
+
+		/**
+		@brief Stop at once without ramping down, for an emergency stop that has already halted the step generator */
+		void Halt();
+
+		/**
+		@brief Stop with the aSteps-th step from now as the last one, braking in time to land on it */
+		void SetStepsLeft(uint32_t aSteps);
+		/**
+		@brief Back to running until stopped */
+		void ClearStepsLeft();
+
+		/**
+		@brief Advance the ramp by one step
+		@return ticks from this step to the next one, or 0 once the ramp has come to a stop */
+		uint32_t NextPeriod();
+
+		State GetState() const { return myState; }
+		uint32_t GetTargetSpeed() const { return myTargetSpeed; }
+		uint32_t GetCurrentSpeed() const;
+		uint32_t GetTickHz() const { return myTickHz; }
+		bool HasStepsLeft() const { return myLimited; }
+		uint32_t GetStepsLeft() const { return myStepsLeft; }
+		// every step the ramp has produced, wraps
+		uint32_t GetStepCount() const { return mySteps; }
+
+		/**
+		@brief Bytes used by the precomputed ramp tables, 0 when the ramp is calculated per step */
+		size_t GetTableFootprint() const;
+
+	private:
+		// steps before the last one that are always taken braking
+		static constexpr uint32_t LANDING_STEPS = 2;
+		// fraction bits of the braking distance, a step up the acceleration ramp adds a fraction of a braking step
+		static constexpr uint8_t BRAKE_FRACTION_BITS = 16;
+		// a step of braking with 1/16 to spare, for the tables and the curve's slices, which take a little longer to
+		// stop than the exact profile
+		static constexpr uint64_t BRAKE_STEP = 17ull << (BRAKE_FRACTION_BITS - 4);
+
+		/**
+		@brief NextPeriod without the steps left */
+		uint32_t RampPeriod();
+		/**
+		@return true once the steps left are no more than it takes to stop from the current speed */
+		bool IsDueToBrake() const;
+		/**
+		@brief Work the braking distance out afresh from the current speed, whenever it changes other than by a step
+		along the ramp */
+		void PlanBrake();
+		void Replan();
+		void Advance();
+		void Shrink();
+		void Grow();
+		uint32_t IndexForPeriod(uint32_t aPeriod, uint32_t aRate) const;
+		void SeekTable(RampTable *aTable);
+		void SeekPeriod(RampTable *aTable, uint32_t aRate);
+		void PlanCurve();
+		/**
+		@brief The cruise period of the next step, the base period or a tick longer */
+		uint32_t DitherPeriod();
+
+		const uint32_t myTickHz;
+		const uint32_t myMaxSpeed;
+		const uint32_t myAcceleration;
+		const uint32_t myDeceleration;
+		std::unique_ptr<RampTable> myAccelerationTable;
+		std::unique_ptr<RampTable> myDecelerationTable;
+		// ramp indexes of the start speed under acceleration and deceleration
+		uint32_t myFirstIndex = 0;
+		uint32_t myStopIndex = 0;
+		uint32_t myFirstPeriod = 0;
+		const uint32_t myStartSpeed;
+		const uint32_t myJerk;
+		std::unique_ptr<SCurve> mySCurve;
+		// steps left once braking for them has slowed down early, at sqrt(2 d) (or the start speed if faster), the
+		// speed of one step of deceleration that the motor stops dead from
+		const uint32_t myCreepPeriod;
+		// braking steps added by a step up the acceleration ramp, a / d, at the steepest point of an acceleration curve
+		const uint64_t myBrakePerStep;
+
+		State myState = State::STOPPED;
+		uint32_t myTargetSpeed = 0;
+		uint32_t myTargetPeriod = 0;
+		uint32_t myPeriod = 0;
+		// target in 1 / 2^RATE_FRACTION_BITS steps per second, the ticks per step are myTargetPeriod + myTargetRest / myTargetRate
+		uint64_t myTargetRate = 1;
+		uint64_t myTargetRest = 0;
+		// remainders carried between cruise steps, always < myTargetRate
+		uint64_t myPhase = 0;
+
+		// ramp index n of the current period under the active rate, v = sqrt(2 * rate * n)
+		uint32_t myIndex = 0;
+		// division remainder carried between steps so small periods keep ramping
+		uint32_t myRest = 0;
+
+		// steps it takes to stop from the current speed with 1/16 to spare, in 1/2^BRAKE_FRACTION_BITS steps. Kept up to
+		// date as the speed changes, the look ahead on every step is then a compare
+		uint64_t myBrakeDistance = 0;
+
+		bool myLimited = false;
+		uint32_t myStepsLeft = 0;
+		// stopping for the steps left rather than for a Stop, and taking the last of them at the start speed
+		bool myLanding = false;
+		bool myCreeping = false;
+		uint32_t mySteps = 0;
+	};
+
+} // namespace PowerFeed
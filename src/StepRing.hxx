@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace PowerFeed
+{
+	/**
+	@brief Order in which the two halves of a step ring are refilled and started, kept apart from the DMA so that it
+	can be tested on the host. Derived provides the channels, one per half:
+	- size_t FillHalf(unsigned aHalf): fill the half from the ramp, the number of words
+	- bool HasMoreSteps(): the ramp has steps past the ones filled
+	- void ArmHalf(unsigned aHalf, size_t aWords): load the half's channel without starting it, it chains nowhere
+	  and any completion still pending for it is dropped
+	- void ChainToHalf(unsigned aHalf): the other half's channel starts aHalf once it completes
+	- bool IsHalfBusy(unsigned aHalf), bool HasHalfStarted(unsigned aHalf): since the last ArmHalf
+	- void StartHalf(unsigned aHalf)
+	- void WakeFromISR(): the ring has run dry
+	A half only gets chained to once it has been refilled, so a channel never replays a half the interrupt has not
+	got round to yet. When a half completes before the other one was refilled, which at low rates happens as soon
+	as a half fits in the FIFO, the chain was not set in time and the interrupt starts the other half itself.
+	Each half holds up to REFILL_HORIZON_US of motion, so the playing half always covers the interrupt latency,
+	except for the last ones of a move, which nothing has to follow. */
+	template <typename Derived>
+	class StepRing
+	{
+	public:
+		enum class RingState : uint8_t
+		{
+			IDLE,
+			RUNNING,
+			// the ramp has stopped, the remaining queued halves are being played out
+			DRAINING
+		};
+
+		RingState GetRingState() const { return myRingState; }
+
+	protected:
+		/**
+		@brief Start streaming from an idle ring, the first half is started and the second chained behind it */
+		void PrimeRing()
+		{
+			Derived *channels = static_cast<Derived *>(this);
+			const size_t first = channels->FillHalf(0);
+			if (first == 0)
+			{
+				return;
+			}
+			channels->ArmHalf(0, first);
+			myRingState = RingState::DRAINING;
+
+			if (channels->HasMoreSteps())
+			{
+				const size_t second = channels->FillHalf(1);
+				if (second > 0)
+				{
+					channels->ArmHalf(1, second);
+					channels->ChainToHalf(1);
+					if (channels->HasMoreSteps())
+					{
+						myRingState = RingState::RUNNING;
+					}
+				}
+			}
+			channels->StartHalf(0);
+		}
+
+		/**
+		@brief From the completion interrupt of aHalf's channel */
+		void OnHalfComplete(unsigned aHalf)
+		{
+			Derived *channels = static_cast<Derived *>(this);
+			if (myRingState == RingState::RUNNING)
+			{
+				// the other half is playing now, or has already finished, refill this one to follow it
+				const size_t words = channels->FillHalf(aHalf);
+				if (words > 0)
+				{
+					channels->ArmHalf(aHalf, words);
+					channels->ChainToHalf(aHalf);
+					// completed before the chain was set, the chain never fires and the FIFO drains meanwhile
+					if (!channels->IsHalfBusy(aHalf ^ 1) && !channels->IsHalfBusy(aHalf) && !channels->HasHalfStarted(aHalf))
+					{
+						channels->StartHalf(aHalf);
+					}
+				}
+				if (words == 0 || !channels->HasMoreSteps())
+				{
+					myRingState = RingState::DRAINING;
+				}
+			}
+
+			if (myRingState == RingState::DRAINING && !channels->IsHalfBusy(0) && !channels->IsHalfBusy(1))
+			{
+				myRingState = RingState::IDLE;
+				if (channels->HasMoreSteps())
+				{
+					// restarted while the tail of the previous move was still playing
+					PrimeRing();
+				}
+				if (myRingState == RingState::IDLE)
+				{
+					channels->WakeFromISR();
+				}
+			}
+		}
+
+		/**
+		@brief After the channels have been aborted */
+		void ResetRing() { myRingState = RingState::IDLE; }
+
+	private:
+		volatile RingState myRingState = RingState::IDLE;
+	};
+
+} // namespace PowerFeed
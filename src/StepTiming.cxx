@@ -0,0 +1,84 @@
+#include "StepTiming.hxx"
+
+namespace PowerFeed
+{
+	StepTiming::StepTiming(uint32_t aClockHz)
+		: myClockHz(aClockHz > 0 ? aClockHz : 1)
+	{
+	}
+
+	void StepTiming::Reset(uint32_t aStepsPerSecond)
+	{
+		myStepsPerSecond = aStepsPerSecond > 0 ? aStepsPerSecond : 1;
+		mySamples = 0;
+		myTotalCycles = 0;
+		myLastPeriod = 0;
+		myError = {};
+		myJitter = {};
+	}
+
+	void StepTiming::Add(uint32_t aPeriodCycles)
+	{
+		// |period - clock / rate| in cycles, scaled by the rate so it stays an integer
+		const int64_t scaled = static_cast<int64_t>(aPeriodCycles) * myStepsPerSecond - myClockHz;
+		const uint64_t magnitude = static_cast<uint64_t>(scaled < 0 ? -scaled : scaled);
+		Count(myError, CyclesToNs((magnitude + myStepsPerSecond / 2) / myStepsPerSecond));
+
+		if (mySamples > 0)
+		{
+			const uint32_t jitter = aPeriodCycles > myLastPeriod ? aPeriodCycles - myLastPeriod : myLastPeriod - aPeriodCycles;
+			Count(myJitter, CyclesToNs(jitter));
+		}
+
+		myLastPeriod = aPeriodCycles;
+		myTotalCycles += aPeriodCycles;
+		mySamples++;
+	}
+
+	int32_t StepTiming::GetRateErrorPpm() const
+	{
+		if (myTotalCycles == 0)
+		{
+			return 0;
+		}
+		// samples / total seconds against the rate: (samples * clock - total * rate) / (total * rate)
+		const int64_t expected = static_cast<int64_t>(myTotalCycles) * myStepsPerSecond;
+		const int64_t difference = static_cast<int64_t>(mySamples) * myClockHz - expected;
+		return static_cast<int32_t>((difference * 1000000) / expected);
+	}
+
+	uint8_t StepTiming::Bin(uint32_t aNs)
+	{
+		uint8_t bin = 0;
+		for (uint32_t limit = FIRST_BIN_NS; bin < BINS - 1 && aNs >= limit; limit *= 2)
+		{
+			bin++;
+		}
+		return bin;
+	}
+
+	uint32_t StepTiming::BinLimitNs(uint8_t aBin)
+	{
+		if (aBin >= BINS - 1)
+		{
+			return UINT32_MAX;
+		}
+		return FIRST_BIN_NS << aBin;
+	}
+
+	void StepTiming::Count(Histogram &aHistogram, uint32_t aNs)
+	{
+		aHistogram.counts[Bin(aNs)]++;
+		if (aNs > aHistogram.maxNs)
+		{
+			aHistogram.maxNs = aNs;
+		}
+	}
+
+	uint32_t StepTiming::CyclesToNs(uint64_t aCycles) const
+	{
+		const uint64_t ns = (aCycles * 1000000000ull) / myClockHz;
+		return ns > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(ns);
+	}
+
+} // namespace PowerFeed
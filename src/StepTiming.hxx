@@ -0,0 +1,69 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace PowerFeed
+{
+	/**
+	@brief Statistics of measured step periods against the commanded rate, for the step timing diagnostics.
+	Two histograms of absolute errors in ns: the period error is each period against the exact commanded period,
+	the jitter each period against the one before it. The first bin holds everything under FIRST_BIN_NS and every
+	bin after it is twice as wide as the one before, the last one holds everything above.
+	A dithered rate alternates between periods a step generator tick apart, so with the 1us tick the period error
+	sits around the tick and the jitter at 0 or 1 tick. Anything beyond that is the stream falling behind. */
+	class StepTiming
+	{
+	public:
+		static constexpr uint8_t BINS = 12;
+		static constexpr uint32_t FIRST_BIN_NS = 16;
+
+		struct Histogram
+		{
+			std::array<uint32_t, BINS> counts;
+			uint32_t maxNs;
+		};
+
+		/**
+		@param aClockHz rate of the cycles that periods are measured in */
+		explicit StepTiming(uint32_t aClockHz);
+
+		/**
+		@brief Start over, measuring against aStepsPerSecond */
+		void Reset(uint32_t aStepsPerSecond);
+
+		/**
+		@brief Add the period from one step to the next, in clock cycles */
+		void Add(uint32_t aPeriodCycles);
+
+		const Histogram &GetError() const { return myError; }
+		const Histogram &GetJitter() const { return myJitter; }
+		uint32_t GetSamples() const { return mySamples; }
+		uint32_t GetStepsPerSecond() const { return myStepsPerSecond; }
+
+		/**
+		@brief Rate over all the samples against the commanded rate, in parts per million, positive if too fast */
+		int32_t GetRateErrorPpm() const;
+
+		/**
+		@brief Bin an absolute error in ns falls into */
+		static uint8_t Bin(uint32_t aNs);
+
+		/**
+		@brief Upper bound of bin aBin in ns, the last one has none and returns UINT32_MAX */
+		static uint32_t BinLimitNs(uint8_t aBin);
+
+	private:
+		static void Count(Histogram &aHistogram, uint32_t aNs);
+		uint32_t CyclesToNs(uint64_t aCycles) const;
+
+		const uint32_t myClockHz;
+		uint32_t myStepsPerSecond = 1;
+		uint32_t mySamples = 0;
+		uint64_t myTotalCycles = 0;
+		uint32_t myLastPeriod = 0;
+		Histogram myError = {};
+		Histogram myJitter = {};
+	};
+
+} // namespace PowerFeed
@@ -1,6 +1,6 @@
 #pragma once
 
-#include <cassert>
+#include "Fixed.hxx"
 #include <cstdint>
 #include <string>
 
@@ -18,8 +18,14 @@ namespace PowerFeed
 		{ stepper.SetSpeed(uint32_t{}) };
 		{ stepper.Start() };
 		{ stepper.Stop() };
+		{ stepper.Follow(Fixed{}) };
+		{ stepper.MoveTo(int32_t{}) };
+		{ stepper.Reciprocate(int32_t{}, int32_t{}) };
 		{ stepper.IsRunning() } -> std::convertible_to<bool>;
 		{ stepper.IsStopping() } -> std::convertible_to<bool>;
+		{ stepper.IsStalled() } -> std::convertible_to<bool>;
+		{ stepper.IsEStopped() } -> std::convertible_to<bool>;
+		{ stepper.GetPosition() } -> std::convertible_to<int32_t>;
 	};
 
 	// Forward declaration with concept constraint
@@ -42,12 +48,11 @@ namespace PowerFeed
 			return static_cast<Derived *>(this)->GetTargetDirection();
 		}
 
+		/**
+		@brief Change the direction. While running this ramps down and changes direction once stopped, a Start
+		after it carries on the other way */
 		void SetDirection(bool aDirection)
 		{
-			if (IsRunning())
-			{
-				assert(!IsRunning() && "StepperBase: Cannot change direction while running");
-			}
 			static_cast<Derived *>(this)->SetDirection(aDirection);
 		}
 
@@ -71,6 +76,30 @@ namespace PowerFeed
 			static_cast<Derived *>(this)->SetSpeed(speed);
 		}
 
+		/**
+		@brief Feed in step with the spindle at aStepsPerRev, moving in the set direction while the spindle turns
+		forward. Again while following changes the feed without losing the phase, Stop or Start ends it */
+		void Follow(Fixed aStepsPerRev)
+		{
+			static_cast<Derived *>(this)->Follow(aStepsPerRev);
+		}
+
+		/**
+		@brief Move to step position aPosition at the set speed, braking in time to stop on it. A move while
+		running waits for the axis to stop first, Stop or Start ends it */
+		void MoveTo(int32_t aPosition)
+		{
+			static_cast<Derived *>(this)->MoveTo(aPosition);
+		}
+
+		/**
+		@brief Shuttle between step positions aFrom and aTo at the set speed, to aTo first. Every stroke moves like a
+		MoveTo, dwells at the end and pulses the cross feed output. Stop, Start or a MoveTo ends it */
+		void Reciprocate(int32_t aFrom, int32_t aTo)
+		{
+			static_cast<Derived *>(this)->Reciprocate(aFrom, aTo);
+		}
+
 		uint32_t GetCurrentSpeed()
 		{
 			return static_cast<Derived *>(this)->GetCurrentSpeed();
@@ -86,6 +115,24 @@ namespace PowerFeed
 			return static_cast<Derived *>(this)->IsStopping();
 		}
 
+		// Stopped because the motor fell behind the steps, until the next Start
+		bool IsStalled()
+		{
+			return static_cast<Derived *>(this)->IsStalled();
+		}
+
+		// Halted by the emergency stop, until it is released and the axis is started again
+		bool IsEStopped()
+		{
+			return static_cast<Derived *>(this)->IsEStopped();
+		}
+
+		// Steps actually emitted, must not block so it can be read from any core or task
+		int32_t GetPosition()
+		{
+			return static_cast<Derived *>(this)->GetPosition();
+		}
+
 		virtual ~StepperBase() = default;
 	};
 
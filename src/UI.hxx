@@ -2,8 +2,10 @@
 
 #include "Display.hxx"
 #include "Event.hxx"
+#include "Mutex.hxx"
 #include "Settings.hxx"
 #include "Stepper.hxx"
+#include <algorithm>
 #include <cstdint>
 #include <memory>
 
@@ -16,6 +18,8 @@ namespace PowerFeed
 		RIGHT = 2,
 		RAPID = 4,
 		ACCELERATION_HIGH = 8,
+		// feed per spindle revolution instead of per minute
+		SYNC = 16,
 	};
 
 	enum class DeviceState : uint8_t
@@ -29,7 +33,11 @@ namespace PowerFeed
 		ACCELERATION_HIGH,
 		ACCELERATION_LOW,
 		ENCODER_CHANGED,
-		UNITS_TOGGLE
+		UNITS_TOGGLE,
+		SYNC_TOGGLE,
+		// remember where the axis is, and go back there
+		POSITION_STORE,
+		POSITION_GOTO
 	};
 
 	struct StateChange
@@ -66,18 +74,29 @@ namespace PowerFeed
 	class UI
 	{
 	public:
+		/**
+		@param aDisplayMutex shared by every UI on aDisplay, the encoder and switch tasks of all the axes call in at once.
+		It also keeps each stepper's command queue to one producer. */
 		UI(SettingsManager *aSettings,
 		   Display *aDisplay,
+		   IMutex *aDisplayMutex,
 		   StepperBase<DerivedStepper> *aStepper,
 		   uint32_t aNormalSpeed = 1,
-		   uint32_t aRapidSpeed = 2)
-			: mySettings(aSettings), myDisplay(aDisplay), myStepper(aStepper), myNormalSpeed(aNormalSpeed), myRapidSpeed(aRapidSpeed){};
+		   uint32_t aRapidSpeed = 2,
+		   uint8_t anAxis = 0)
+			: mySettings(aSettings), myDisplay(aDisplay), myDisplayMutex(aDisplayMutex), myStepper(aStepper), myNormalSpeed(aNormalSpeed), myRapidSpeed(aRapidSpeed), myAxis(anAxis)
+		{
+			// 0.1mm per revolution to begin with
+			myStepsPerRev = std::max<int32_t>(1, (mySettings->Get()->axes[myAxis].mechanical.stepsPerMm / Fixed::FromInt(10)).ToInt());
+		}
 
 		void OnValueChange(const StateChange &aStateChange)
 		{
+			LockGuard<IMutex> lock(*myDisplayMutex);
 			std::shared_ptr<Settings> settings = mySettings->Get();
-			Settings::Mechanical mechanical = settings->mechanical;
-			Settings::Controls controls = settings->controls;
+			// by reference, the settings are held by the shared pointer and an axis has vectors in it
+			const Settings::Mechanical &mechanical = settings->axes[myAxis].mechanical;
+			const Settings::Controls &controls = settings->axes[myAxis].controls;
 
 			// printf("UI::OnValueChange: %u\n", (uint16_t)aStateChange.type);
 			if (aStateChange.type == DeviceState::LEFT_HIGH || aStateChange.type == DeviceState::RIGHT_HIGH)
@@ -97,6 +116,13 @@ namespace PowerFeed
 			case DeviceState::LEFT_HIGH:
 			{
 				SetState(UIState::LEFT);
+				if (IsStateSet(UIState::SYNC))
+				{
+					myStepper->SetDirection(mechanical.moveLeftDirection);
+					myStepper->Follow(Fixed::FromInt(myStepsPerRev));
+					break;
+				}
+
 				if (IsStateSet(UIState::RAPID))
 				{
 					myStepper->SetSpeed(myRapidSpeed);
@@ -106,21 +132,13 @@ namespace PowerFeed
 					myStepper->SetSpeed(myNormalSpeed);
 				}
 
-				if (myStepper->IsRunning())
-				{
-					if (myStepper->IsStopping())
-					{
-						if (myStepper->GetDirection() == mySettings->Get()->mechanical.moveLeftDirection)
-						{
-							// it's stopping, but we want to resume in the same direction, it's safe to restart
-							myStepper->Start();
-						}
-					}
-				}
-				else
+				if (!myStepper->IsRunning() || myStepper->IsStopping() || myMovingTo)
 				{
-					// it was stopped, we can start with any direction
-					myStepper->SetDirection(mySettings->Get()->mechanical.moveLeftDirection);
+					// stopped, stopping in either direction or on a move: the stepper resumes, or ramps down, waits
+					// out the driver's direction setup time and starts the other way
+					myMovingTo = false;
+					myReciprocating = false;
+					myStepper->SetDirection(mechanical.moveLeftDirection);
 					myStepper->Start();
 				}
 			}
@@ -135,6 +153,13 @@ namespace PowerFeed
 				break;
 			case DeviceState::RIGHT_HIGH:
 				SetState(UIState::RIGHT);
+				if (IsStateSet(UIState::SYNC))
+				{
+					myStepper->SetDirection(mechanical.moveRightDirection);
+					myStepper->Follow(Fixed::FromInt(myStepsPerRev));
+					break;
+				}
+
 				if (IsStateSet(UIState::RAPID))
 				{
 					myStepper->SetSpeed(myRapidSpeed);
@@ -144,21 +169,13 @@ namespace PowerFeed
 					myStepper->SetSpeed(myNormalSpeed);
 				}
 
-				if (myStepper->IsRunning())
-				{
-					if (myStepper->IsStopping())
-					{
-						if (myStepper->GetDirection() == mySettings->Get()->mechanical.moveRightDirection)
-						{
-							// it's stopping, but we want to resume in the same direction, it's safe to restart
-							myStepper->Start();
-						}
-					}
-				}
-				else
+				if (!myStepper->IsRunning() || myStepper->IsStopping() || myMovingTo)
 				{
-					// it was stopped, we can start with any direction
-					myStepper->SetDirection(mySettings->Get()->mechanical.moveRightDirection);
+					// stopped, stopping in either direction or on a move: the stepper resumes, or ramps down, waits
+					// out the driver's direction setup time and starts the other way
+					myMovingTo = false;
+					myReciprocating = false;
+					myStepper->SetDirection(mechanical.moveRightDirection);
 					myStepper->Start();
 				}
 				break;
@@ -171,14 +188,15 @@ namespace PowerFeed
 				break;
 			case DeviceState::RAPID_HIGH:
 				SetState(UIState::RAPID);
-				if (IsStateSet(UIState::LEFT) || IsStateSet(UIState::RIGHT))
+				// no rapids while following the spindle, the feed is set by the spindle
+				if (!IsStateSet(UIState::SYNC) && (IsStateSet(UIState::LEFT) || IsStateSet(UIState::RIGHT)))
 				{
 					myStepper->SetSpeed(myRapidSpeed);
 				}
 				break;
 			case DeviceState::RAPID_LOW:
 				ClearState(UIState::RAPID);
-				if (IsStateSet(UIState::LEFT) || IsStateSet(UIState::RIGHT))
+				if (!IsStateSet(UIState::SYNC) && (IsStateSet(UIState::LEFT) || IsStateSet(UIState::RIGHT)))
 				{
 					myStepper->SetSpeed(myNormalSpeed);
 				}
@@ -187,19 +205,21 @@ namespace PowerFeed
 			{
 				const ValueChange<int16_t> &state = static_cast<const ValueChange<int16_t> &>(aStateChange);
 				bool moving = IsStateSet(UIState::LEFT) || IsStateSet(UIState::RIGHT);
+				// already scaled by how fast the knob turns, see EncoderAcceleration
 				int16_t increment = state.value;
 
-				// Apply acceleration curve to encoder input
-				if (abs(increment) > 16)
+				if (IsStateSet(UIState::SYNC))
 				{
-					increment *= 10;
-				}
-				else if (abs(increment) > 32)
-				{
-					increment *= 50;
-				}
+					// a step per revolution per count, about a micron at the usual leadscrew and microstepping
+					const int32_t maxStepsPerRev = mechanical.stepsPerLeadscrewRev.ToInt();
+					myStepsPerRev = std::clamp<int32_t>(myStepsPerRev + increment, 1, maxStepsPerRev);
 
-				if (IsStateSet(UIState::RAPID))
+					if (moving)
+					{
+						myStepper->Follow(Fixed::FromInt(myStepsPerRev));
+					}
+				}
+				else if (IsStateSet(UIState::RAPID))
 				{
 					int32_t speed = static_cast<int32_t>(myRapidSpeed) + (increment * controls.encoderCountsToStepsPerSecond);
 
@@ -238,7 +258,8 @@ namespace PowerFeed
 						myNormalSpeed = speed;
 					}
 
-					if (moving)
+					// reciprocating runs at the feed, which can be set while it runs
+					if (moving || myReciprocating)
 					{
 						myStepper->SetSpeed(myNormalSpeed);
 					}
@@ -250,41 +271,149 @@ namespace PowerFeed
 			case DeviceState::UNITS_TOGGLE:
 				myDisplay->ToggleUnits();
 				break;
+			case DeviceState::SYNC_TOGGLE:
+			{
+				const Settings::Spindle &spindle = settings->spindle;
+				if (!spindle.enabled || spindle.axis != myAxis)
+				{
+					break;
+				}
+
+				if (IsStateSet(UIState::SYNC))
+				{
+					ClearState(UIState::SYNC);
+				}
+				else
+				{
+					SetState(UIState::SYNC);
+				}
+
+				if (IsStateSet(UIState::LEFT) || IsStateSet(UIState::RIGHT))
+				{
+					// never change the kind of feed under a cut, the lever has to be moved again
+					myStepper->Stop();
+				}
+			}
+			break;
+			case DeviceState::POSITION_STORE:
+				// the one before becomes the other end to reciprocate to
+				myOtherPosition = myStoredPosition;
+				myHasOtherPosition = myHasStoredPosition;
+				myStoredPosition = myStepper->GetPosition();
+				myHasStoredPosition = true;
+				break;
+			case DeviceState::POSITION_GOTO:
+				// not under a lever or while following the spindle, the operator is already driving the axis
+				if (!myHasStoredPosition || IsStateSet(UIState::LEFT) || IsStateSet(UIState::RIGHT) || IsStateSet(UIState::SYNC))
+				{
+					break;
+				}
+				if (myReciprocating && myStepper->IsRunning())
+				{
+					// again while reciprocating stops it, wherever it is
+					myReciprocating = false;
+					myMovingTo = false;
+					myStepper->Stop();
+					break;
+				}
+				myReciprocating = false;
+				if (myHasOtherPosition && myOtherPosition != myStoredPosition && myStepper->GetPosition() == myStoredPosition)
+				{
+					// already there, shuttle between the two stored positions at the feed, to the other one first
+					myStepper->SetSpeed(myNormalSpeed);
+					myStepper->Reciprocate(myStoredPosition, myOtherPosition);
+					myReciprocating = true;
+					myMovingTo = true;
+					break;
+				}
+				// at the rapid speed, the stepper brakes in time to stop on the position
+				myStepper->SetSpeed(myRapidSpeed);
+				myStepper->MoveTo(myStoredPosition);
+				myMovingTo = true;
+				break;
 			}
 
 			UpdateDisplay();
 		}
 
+		/**
+		@brief Redraw if the stepper has stalled, been emergency stopped or been restarted since the last redraw, call periodically */
+		void Poll()
+		{
+			LockGuard<IMutex> lock(*myDisplayMutex);
+			if (myStepper->IsStalled() != myShowsStall || myStepper->IsEStopped() != myShowsEStop)
+			{
+				UpdateDisplay();
+			}
+		}
+
 		bool IsStateSet(UIState state) const
 		{
 			return (myState & static_cast<uint8_t>(state)) != 0;
 		}
 
 		Display *GetDisplay() const { return myDisplay; }
+		uint8_t GetAxis() const { return myAxis; }
 
 	private:
 		Display *myDisplay;
+		// held while handling a change or redrawing, the state and the display buffer are one at a time
+		IMutex *myDisplayMutex;
 		StepperBase<DerivedStepper> *myStepper;
 		uint32_t myNormalSpeed = 1;
 		uint32_t myRapidSpeed = 20000;
-		uint32_t myAcceleration;
+		// feed per spindle revolution while in SYNC
+		int32_t myStepsPerRev = 1;
 		uint8_t myState = 0;
 		Units myUnits = Units::Millimeter;
+		uint8_t myAxis;
+		bool myShowsStall = false;
+		bool myShowsEStop = false;
+		int32_t myStoredPosition = 0;
+		bool myHasStoredPosition = false;
+		// stored before myStoredPosition, the far end of a reciprocation
+		int32_t myOtherPosition = 0;
+		bool myHasOtherPosition = false;
+		// until stopped, the stepper also stops on its own if a stroke comes up short
+		bool myReciprocating = false;
+		// sent a move, a lever takes over from it whether or not it has got there
+		bool myMovingTo = false;
 
 		SettingsManager *mySettings;
 
 		void UpdateDisplay()
 		{
+			// every axis draws on the one display, it shows whichever was used last
+			myDisplay->SelectAxis(myAxis);
 			myDisplay->ClearBuffer();
 
-			auto speed = IsStateSet(UIState::RAPID) ? myRapidSpeed : myNormalSpeed;
-			myDisplay->DrawSpeed(speed);
+			if (IsStateSet(UIState::SYNC))
+			{
+				myDisplay->DrawFeedPerRev(myStepsPerRev);
+			}
+			else
+			{
+				auto speed = IsStateSet(UIState::RAPID) ? myRapidSpeed : myNormalSpeed;
+				myDisplay->DrawSpeed(speed);
+			}
 
-			if (IsStateSet(UIState::LEFT) && IsStateSet(UIState::RAPID))
+			myShowsStall = myStepper->IsStalled();
+			myShowsEStop = myStepper->IsEStopped();
+			if (myShowsEStop)
+			{
+				// until the stop is released and a lever moved again
+				myDisplay->DrawEStopped();
+			}
+			else if (myShowsStall)
+			{
+				// stays up while the lever is held, releasing and moving it again restarts the axis
+				myDisplay->DrawStalled();
+			}
+			else if (IsStateSet(UIState::LEFT) && IsStateSet(UIState::RAPID) && !IsStateSet(UIState::SYNC))
 			{
 				myDisplay->DrawRapidLeft();
 			}
-			else if (IsStateSet(UIState::RIGHT) && IsStateSet(UIState::RAPID))
+			else if (IsStateSet(UIState::RIGHT) && IsStateSet(UIState::RAPID) && !IsStateSet(UIState::SYNC))
 			{
 				myDisplay->DrawRapidRight();
 			}
@@ -0,0 +1,100 @@
+#include "GpioDispatch.hxx"
+#include "Assert.hxx"
+#include <hardware/gpio.h>
+#include <hardware/sync.h>
+#include <hardware/timer.h>
+#include <task.h>
+
+namespace PowerFeed::Drivers
+{
+	GpioDispatch::Entry GpioDispatch::myEntries[PIN_COUNT] = {};
+	Debouncer GpioDispatch::myDebouncer;
+	repeating_timer_t GpioDispatch::myTimer;
+	bool GpioDispatch::myTimerStarted = false;
+
+	void GpioDispatch::Claim(uint aPin, void *anOwner)
+	{
+		if (aPin >= PIN_COUNT)
+		{
+			Panic("GpioDispatch: no such pin\n");
+		}
+		if (myEntries[aPin].owner != nullptr)
+		{
+			Panic("GpioDispatch: pin registered twice\n");
+		}
+		if (xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED)
+		{
+			Panic("GpioDispatch: register before the scheduler starts\n");
+		}
+		myEntries[aPin].owner = anOwner;
+	}
+
+	void GpioDispatch::OnEdge(uint aPin, uint32_t anEvents, void *anOwner, EdgeHandler aHandler)
+	{
+		Claim(aPin, anOwner);
+		myEntries[aPin].edge = aHandler;
+		myEntries[aPin].group = 1u << aPin;
+		gpio_set_irq_enabled_with_callback(aPin, anEvents, true, &IrqCallback);
+	}
+
+	void GpioDispatch::OnDebounced(uint32_t aPins, uint32_t aDebounceUs, void *anOwner, ChangeHandler aHandler)
+	{
+		for (uint32_t pending = aPins; pending != 0; pending &= pending - 1)
+		{
+			const uint pin = static_cast<uint>(__builtin_ctz(pending));
+			Claim(pin, anOwner);
+			myEntries[pin].change = aHandler;
+			myEntries[pin].group = aPins;
+		}
+
+		// the timer may already be sampling the pins registered before these
+		const uint32_t saved = save_and_disable_interrupts();
+		myDebouncer.Add(aPins, aDebounceUs / SAMPLE_US, gpio_get_all());
+		restore_interrupts(saved);
+
+		// a negative interval keeps the samples evenly spaced however long the callback takes
+		if (!myTimerStarted && !add_repeating_timer_us(-static_cast<int64_t>(SAMPLE_US), &SampleCallback, nullptr, &myTimer))
+		{
+			Panic("GpioDispatch: no alarm slot left for the debounce timer\n");
+		}
+		myTimerStarted = true;
+	}
+
+	void GpioDispatch::IrqCallback(uint aPin, uint32_t anEvents)
+	{
+		const Entry &entry = myEntries[aPin];
+		if (entry.edge == nullptr)
+		{
+			return;
+		}
+		BaseType_t woken = pdFALSE;
+		entry.edge(entry.owner, aPin, anEvents, &woken);
+		portYIELD_FROM_ISR(woken);
+	}
+
+	bool GpioDispatch::SampleCallback(repeating_timer_t *)
+	{
+		// every registered pin in one read, the same work whether they bounce or not
+		const uint32_t raw = gpio_get_all();
+		uint32_t changed = myDebouncer.Sample(raw);
+		if (changed == 0)
+		{
+			return true;
+		}
+
+		const uint32_t time = time_us_32();
+		const uint32_t levels = (raw & ~myDebouncer.GetMask()) | myDebouncer.GetLevels();
+		BaseType_t woken = pdFALSE;
+		while (changed != 0)
+		{
+			// one call per registration that changed, however many of its pins did
+			const Entry &entry = myEntries[__builtin_ctz(changed)];
+			entry.change(entry.owner, changed & entry.group, levels, time, &woken);
+			changed &= ~entry.group;
+		}
+		portYIELD_FROM_ISR(woken);
+		// keep sampling
+		return true;
+	}
+
+} // namespace PowerFeed::Drivers
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Debouncer.hxx"
+#include <FreeRTOS.h>
+#include <cstdint>
+#include <pico/time.h>
+#include <pico/types.h>
+
+namespace PowerFeed::Drivers
+{
+	/**
+	@brief The one GPIO callback of the SDK and the one debounce timer, shared by every group of inputs, the
+	switches of each axis and whatever else reads a pin. A table indexed by GPIO number holds the owner and handler
+	of each pin, so an edge or a debounced change goes straight to its handler whatever else is registered.
+	Register from main before the scheduler starts, so the interrupt and the timer are on core 0 and nothing runs
+	them while the table is filled in. The emergency stop keeps its own raw handler, ahead of this. */
+	class GpioDispatch
+	{
+	public:
+		static constexpr uint PIN_COUNT = 30;
+		// a debounce delay is this many samples of every registered pin at once
+		static constexpr uint32_t SAMPLE_US = 1000;
+
+		/**
+		@brief Called from the GPIO interrupt for an edge of aPin, anEvents as the SDK gives them */
+		using EdgeHandler = void (*)(void *anOwner, uint aPin, uint32_t anEvents, BaseType_t *aWoken);
+
+		/**
+		@brief Called from the debounce timer once per sample for all the pins of a registration that changed
+		@param aChanged the pins that changed, as bits
+		@param aLevels every GPIO at the sample, debounced where debounced */
+		using ChangeHandler = void (*)(void *anOwner, uint32_t aChanged, uint32_t aLevels, uint32_t aTimeUs, BaseType_t *aWoken);
+
+		/**
+		@brief Hand the edges of aPin to aHandler, undebounced, from the GPIO interrupt. With an emergency stop that
+		interrupt is at the highest priority and the stop waits for the handler, keep it to waking a task */
+		static void OnEdge(uint aPin, uint32_t anEvents, void *anOwner, EdgeHandler aHandler);
+
+		/**
+		@brief Sample aPins every SAMPLE_US and hand their changes to aHandler once they held for aDebounceUs. The
+		levels they have now are where they start from, a pin held at power up is not a change. */
+		static void OnDebounced(uint32_t aPins, uint32_t aDebounceUs, void *anOwner, ChangeHandler aHandler);
+
+	private:
+		struct Entry
+		{
+			void *owner;
+			EdgeHandler edge;
+			ChangeHandler change;
+			// the pins registered along with this one, their changes at one sample go to the handler together
+			uint32_t group;
+		};
+
+		static void Claim(uint aPin, void *anOwner);
+		static void IrqCallback(uint aPin, uint32_t anEvents);
+		static bool SampleCallback(repeating_timer_t *aTimer);
+
+		static Entry myEntries[PIN_COUNT];
+		static Debouncer myDebouncer;
+		static repeating_timer_t myTimer;
+		static bool myTimerStarted;
+	};
+
+} // namespace PowerFeed::Drivers
@@ -0,0 +1,77 @@
+#include "PicoEStop.hxx"
+#include "Assert.hxx"
+#include <FreeRTOS.h>
+#include <hardware/irq.h>
+#include <hardware/timer.h>
+#include <task.h>
+
+namespace PowerFeed::Drivers
+{
+	PicoEStop *PicoEStop::myInstance = nullptr;
+
+	PicoEStop::PicoEStop(const Settings::EStop &aSettings, PicoStepper *const *aSteppers, size_t aStepperCount)
+		: myPin(aSettings.pin), myActiveHigh(aSettings.activeHigh)
+	{
+		if (myInstance != nullptr)
+		{
+			Panic("PicoEStop: there is only one emergency stop\n");
+		}
+		myInstance = this;
+
+		for (size_t i = 0; i < aStepperCount && i < Settings::MAX_AXES; i++)
+		{
+			mySteppers[myStepperCount++] = aSteppers[i];
+			aSteppers[i]->myEStop = this;
+		}
+
+		gpio_init(myPin);
+		gpio_set_dir(myPin, GPIO_IN);
+		gpio_pull_up(myPin);
+		myEvent = myActiveHigh ? GPIO_IRQ_EDGE_RISE : GPIO_IRQ_EDGE_FALL;
+
+		// a raw handler runs ahead of the GpioDispatch callback and does not go through its table
+		gpio_add_raw_irq_handler(myPin, IrqHandler);
+		// the whole bank, the encoder edges included, they are only a task notify each
+		irq_set_priority(IO_IRQ_BANK0, PICO_HIGHEST_IRQ_PRIORITY);
+		gpio_set_irq_enabled(myPin, myEvent, true);
+		irq_set_enabled(IO_IRQ_BANK0, true);
+
+		if (IsAsserted())
+		{
+			// powered up with the stop pressed or the wire broken, the tasks find it on their first update
+			Trip(time_us_32(), nullptr);
+		}
+	}
+
+	// in RAM like the rest of the path to the halted step output, a flash cache miss would cost microseconds
+	void __not_in_flash_func(PicoEStop::IrqHandler)()
+	{
+		const uint32_t trippedAt = time_us_32();
+		PicoEStop *instance = myInstance;
+		if ((gpio_get_irq_event_mask(instance->myPin) & instance->myEvent) == 0)
+		{
+			// another pin of the bank, the GpioDispatch callback deals with it
+			return;
+		}
+		gpio_acknowledge_irq(instance->myPin, instance->myEvent);
+
+		// no debounce, on an emergency stop input a glitch stops the axes too
+		BaseType_t woken = pdFALSE;
+		instance->Trip(trippedAt, &woken);
+		portYIELD_FROM_ISR(woken);
+	}
+
+	void __not_in_flash_func(PicoEStop::Trip)(uint32_t aTrippedAtUs, BaseType_t *aWoken)
+	{
+		// every step output first, the task notifications after
+		for (size_t i = 0; i < myStepperCount; i++)
+		{
+			mySteppers[i]->myStream->Halt();
+		}
+		for (size_t i = 0; i < myStepperCount; i++)
+		{
+			mySteppers[i]->PrivEStopFromISR(aTrippedAtUs, aWoken);
+		}
+	}
+
+} // namespace PowerFeed::Drivers
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "Settings.hxx"
+#include "drivers/stepper/PicoStepper.hxx"
+#include <hardware/gpio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace PowerFeed::Drivers
+{
+	/**
+	@brief Emergency stop input for every axis. The edge is handled by a raw GPIO interrupt at the highest priority,
+	ahead of the GpioDispatch callback, that halts the step state machines and disables the drivers itself before it
+	wakes the stepper tasks. Nothing on the way depends on a task being scheduled or a queue being drained.
+	The priority belongs to the GPIO bank interrupt, not to the pin, so the GpioDispatch edge handlers run at it too
+	and the stop does not outrank them. It waits for at most the one handler already running when it fires, which
+	is why edge handlers do no more than wake a task.
+	The interrupt runs on the core the stop is created on, keep that off the stepper core so the stepper's critical
+	sections cannot hold it up. Only one instance, create it from main once the steppers exist. */
+	class PicoEStop
+	{
+	public:
+		PicoEStop(const Settings::EStop &aSettings, PicoStepper *const *aSteppers, size_t aStepperCount);
+
+		bool IsAsserted() const { return gpio_get(myPin) == myActiveHigh; }
+
+	private:
+		static void IrqHandler();
+		void Trip(uint32_t aTrippedAtUs, BaseType_t *aWoken);
+
+		static PicoEStop *myInstance;
+
+		uint myPin;
+		bool myActiveHigh;
+		uint32_t myEvent;
+		PicoStepper *mySteppers[Settings::MAX_AXES] = {};
+		size_t myStepperCount = 0;
+	};
+
+} // namespace PowerFeed::Drivers
@@ -0,0 +1,32 @@
+#include "PicoQuadratureEncoder.hxx"
+#include "PioProgram.hxx"
+#include "quadrature_encoder.pio.h"
+#include <hardware/gpio.h>
+
+namespace PowerFeed::Drivers
+{
+	PicoQuadratureEncoder::PicoQuadratureEncoder(PIO aPio, uint aPinA, int aMaxStepRate, bool anInvert)
+		: myPio(aPio), myInvert(anInvert)
+	{
+		gpio_init(aPinA);
+		gpio_init(aPinA + 1);
+		PioProgram::Add(myPio, &quadrature_encoder_program);
+		mySm = pio_claim_unused_sm(myPio, true);
+		quadrature_encoder_program_init(myPio, mySm, aPinA, aMaxStepRate);
+	}
+
+	PicoQuadratureEncoder::~PicoQuadratureEncoder()
+	{
+		pio_sm_set_enabled(myPio, mySm, false);
+		pio_sm_unclaim(myPio, mySm);
+		PioProgram::Remove(myPio, &quadrature_encoder_program);
+	}
+
+	int32_t PicoQuadratureEncoder::GetCount()
+	{
+		int32_t count = quadrature_encoder_get_count(myPio, mySm);
+		// negated as unsigned so INT32_MIN wraps instead of overflowing
+		return myInvert ? static_cast<int32_t>(0u - static_cast<uint32_t>(count)) : count;
+	}
+
+} // namespace PowerFeed::Drivers
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <hardware/pio.h>
+#include <stdint.h>
+
+namespace PowerFeed::Drivers
+{
+	/**
+	@brief Quadrature encoder counted by the quadrature_encoder PIO program, B must be on the pin after A.
+	The program has to sit at offset 0, every encoder on the PIO shares the one copy. */
+	class PicoQuadratureEncoder
+	{
+	public:
+		/**
+		@param aMaxStepRate counts per second it has to keep up with, 0 runs the state machine at full speed */
+		PicoQuadratureEncoder(PIO aPio, uint aPinA, int aMaxStepRate, bool anInvert = false);
+		~PicoQuadratureEncoder();
+
+		/**
+		@brief Current count, wraps at the ends of the int32 range. Drains the RX FIFO, call from one task only */
+		int32_t GetCount();
+
+	private:
+		PIO myPio;
+		uint mySm;
+		bool myInvert;
+	};
+
+} // namespace PowerFeed::Drivers
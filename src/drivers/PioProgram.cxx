@@ -0,0 +1,61 @@
+#include "PioProgram.hxx"
+#include "Assert.hxx"
+
+namespace PowerFeed::Drivers
+{
+	PioProgram::Loaded PioProgram::myLoaded[NUM_PIOS][MAX_PROGRAMS] = {};
+
+	PioProgram::Loaded *PioProgram::Find(PIO aPio, const pio_program_t *aProgram)
+	{
+		for (Loaded &loaded : myLoaded[pio_get_index(aPio)])
+		{
+			if (loaded.users > 0 && loaded.program == aProgram)
+			{
+				return &loaded;
+			}
+		}
+		return nullptr;
+	}
+
+	uint PioProgram::Add(PIO aPio, const pio_program_t *aProgram)
+	{
+		Loaded *loaded = Find(aPio, aProgram);
+		if (loaded != nullptr)
+		{
+			loaded->users++;
+			return loaded->offset;
+		}
+
+		if (!pio_can_add_program(aPio, aProgram))
+		{
+			Panic("PioProgram: No room for the program\n");
+		}
+
+		for (Loaded &slot : myLoaded[pio_get_index(aPio)])
+		{
+			if (slot.users == 0)
+			{
+				slot = {aProgram, pio_add_program(aPio, aProgram), 1};
+				return slot.offset;
+			}
+		}
+
+		Panic("PioProgram: Too many programs\n");
+		return 0;
+	}
+
+	void PioProgram::Remove(PIO aPio, const pio_program_t *aProgram)
+	{
+		Loaded *loaded = Find(aPio, aProgram);
+		if (loaded == nullptr)
+		{
+			return;
+		}
+
+		if (--loaded->users == 0)
+		{
+			pio_remove_program(aPio, aProgram, loaded->offset);
+		}
+	}
+
+} // namespace PowerFeed::Drivers
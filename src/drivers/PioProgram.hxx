@@ -0,0 +1,39 @@
+#pragma once
+
+#include <hardware/pio.h>
+#include <stddef.h>
+
+namespace PowerFeed::Drivers
+{
+	/**
+	@brief Loads each PIO program once per PIO block and shares it between every state machine that runs it,
+	so several axes on one PIO do not each need their own copy of the step and counter programs.
+	Not thread safe, load programs from main before the scheduler starts or from a single task. */
+	class PioProgram
+	{
+	public:
+		/**
+		@brief Load aProgram into aPio if it is not there yet, panics if there is no room
+		@return offset the program is loaded at */
+		static uint Add(PIO aPio, const pio_program_t *aProgram);
+		/**
+		@brief Drop a user of aProgram, the program is removed with its last user */
+		static void Remove(PIO aPio, const pio_program_t *aProgram);
+
+	private:
+		struct Loaded
+		{
+			const pio_program_t *program;
+			uint offset;
+			uint users;
+		};
+
+		// both step programs, step counter, encoder and the diagnostic step timer
+		static constexpr size_t MAX_PROGRAMS = 5;
+
+		static Loaded *Find(PIO aPio, const pio_program_t *aProgram);
+
+		static Loaded myLoaded[NUM_PIOS][MAX_PROGRAMS];
+	};
+
+} // namespace PowerFeed::Drivers
@@ -5,39 +5,34 @@
 #include "StepperState.hxx"
 #include "UI.hxx"
 #include "config.h"
+#include "drivers/PicoQuadratureEncoder.hxx"
 #include "drivers/stepper/PicoStepper.hxx"
 #include "portmacro.h"
-#include "quadrature_encoder.pio.h"
 #include <FreeRTOS.h>
+#include <algorithm>
 #include <hardware/gpio.h>
 #include <hardware/irq.h>
 #include <hardware/pio.h>
 #include <hardware/timer.h>
 #include <memory>
+#include <pico/time.h>
 #include <pico/types.h>
-#include <queue.h>
 #include <task.h>
 #include <timers.h>
 
 namespace PowerFeed::Drivers
 {
-	template <typename DerivedStepper>
-	Switches<DerivedStepper> *Switches<DerivedStepper>::myInstance;
-
 	template <typename DerivedStepper>
 	Switches<DerivedStepper>::Switches(SettingsManager *aSettings, UI<DerivedStepper> *aUi) : mySettingsManager(aSettings), myUi(aUi)
 	{
-		myInstance = this;
-
-		PIN_STATES[0] = {mySettingsManager->Get()->controls.leftPin, DeviceState::LEFT_HIGH, DeviceState::LEFT_LOW};
-		PIN_STATES[1] = {mySettingsManager->Get()->controls.rightPin, DeviceState::RIGHT_HIGH, DeviceState::RIGHT_LOW};
-		PIN_STATES[2] = {mySettingsManager->Get()->controls.rapidPin, DeviceState::RAPID_HIGH, DeviceState::RAPID_LOW};
+		const Settings::Axis &axis = mySettingsManager->Get()->axes[myUi->GetAxis()];
+		myControls = axis.controls;
 
-		// Initialize shared pointer with shared_from_this() after construction
-		// We can't do this in the constructor directly
+		myPinStates[myControls.leftPin] = {true, DeviceState::LEFT_HIGH, DeviceState::LEFT_LOW};
+		myPinStates[myControls.rightPin] = {true, DeviceState::RIGHT_HIGH, DeviceState::RIGHT_LOW};
+		myPinStates[myControls.rapidPin] = {true, DeviceState::RAPID_HIGH, DeviceState::RAPID_LOW};
 
-		myGPIOEventQueue = xQueueCreate(10, sizeof(uint32_t));
-		Settings::Controls controls = mySettingsManager->Get()->controls;
+		const Settings::Controls &controls = myControls;
 		if (controls.encoderBPin != controls.encoderAPin + 1)
 		{
 			Panic("Switches: Encoder pins must be adjacent");
@@ -61,113 +56,152 @@ namespace PowerFeed::Drivers
 		gpio_pull_up(controls.encoderAPin);
 		gpio_pull_up(controls.encoderBPin);
 		gpio_pull_up(controls.encoderButtonPin);
-		// we don't really need to keep the offset, as this program must be loaded
-		// at offset 0
-		// pio_add_program(myEncPio, &quadrature_encoder_program);
+		// every encoder runs on pio1, the step generators default to pio0
+		myEncoder = new PicoQuadratureEncoder(pio1, controls.encoderAPin, 13300);
+		myEncoderAcceleration = new EncoderAcceleration(controls.encoderAcceleration);
 
-		bool success = pio_claim_free_sm_and_add_program_for_gpio_range(
-			&quadrature_encoder_program, &myEncPio, &myEncSm, &myEncOffset, controls.encoderAPin, 2,
-			true);
-		assert(success);
+		// the tasks exist before the dispatch can wake them
+		xTaskCreate(EncoderUpdateTask, "Encoder Task", 2048, this, 10, &myEncoderTask);
+		xTaskCreate(SwitchUpdateTask, "Switch Task", 2048, this, 10, &mySwitchTask);
 
-		quadrature_encoder_program_init(myEncPio, myEncSm, controls.encoderAPin, 13300);
+		if (axis.driver.driverCore != 0)
+		{
+			// keep the UI and display traffic off the stepper core
+			vTaskCoreAffinitySet(myEncoderTask, (1 << 0));
+			vTaskCoreAffinitySet(mySwitchTask, (1 << 0));
+		}
 
-		// Start the encoder update task
-		xTaskCreate(EncoderUpdateTask, "Encoder Task", 2048, this, 10, NULL);
-		// Start the switch update task
-		xTaskCreate(SwitchUpdateTask, "Switch Task", 2048, this, 10, NULL);
+		// the PIO counts the encoder, an edge on either pin only wakes the encoder task, B is always the pin after A
+		GpioDispatch::OnEdge(controls.encoderAPin, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, this, &EncoderEdge);
+		GpioDispatch::OnEdge(controls.encoderAPin + 1, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, this, &EncoderEdge);
+		// let the pull ups settle, a lever held at power up is not a change
+		sleep_us(100);
+		const uint32_t switchPins = (1u << controls.leftPin) | (1u << controls.rightPin) | (1u << controls.rapidPin) | (1u << controls.encoderButtonPin);
+		GpioDispatch::OnDebounced(switchPins, controls.debounceDelayUs, this, &SwitchChange);
 	}
 
 	template <typename DerivedStepper>
 	void Switches<DerivedStepper>::SwitchUpdateTask(void *anInstance)
 	{
 		Switches<DerivedStepper> *instance = static_cast<Switches<DerivedStepper> *>(anInstance);
-		Settings::Controls controls = instance->mySettingsManager->Get()->controls;
-
-		// Set up GPIO interrupts
-		gpio_set_irq_enabled_with_callback(controls.leftPin, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, true, &SwitchInterruptHandler);
-		gpio_set_irq_enabled_with_callback(controls.rightPin, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, true, &SwitchInterruptHandler);
-		gpio_set_irq_enabled_with_callback(controls.rapidPin, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, true, &SwitchInterruptHandler);
-		gpio_set_irq_enabled_with_callback(controls.encoderButtonPin, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, true, &SwitchInterruptHandler);
-		// gpio_set_irq_enabled_with_callback(ACCELERATION_PIN, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, true, &SwitchInterruptHandler);
-
 		while (true)
 		{
-			// blocks until it gets a gpio event
-			uint32_t gpio;
-			xQueueReceive(instance->myGPIOEventQueue, &gpio, portMAX_DELAY);
-			auto currentTime = time_us_32();
-			for (size_t i = 0; i < sizeof(instance->PIN_STATES) / sizeof(instance->PIN_STATES[0]); i++)
-			{
-				if (gpio == instance->PIN_STATES[i].pin)
-				{
-					// Check debounce window
-					if (currentTime - instance->myLastPinTimes[i] < controls.debounceDelayUs)
-					{
-						continue;
-					}
-					bool pinHigh = !gpio_get(gpio); // switches are active-low
-					StateChange stateChange(pinHigh ? instance->PIN_STATES[i].highState : instance->PIN_STATES[i].lowState);
-					instance->myUi->OnValueChange(stateChange);
-					instance->myLastPinTimes[i] = currentTime;
-					break;
-				}
-			}
-			if (gpio == controls.encoderButtonPin)
+			// blocks until the timer queues a debounced change, then handles everything queued since
+			ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+			SwitchEvent event;
+			while (instance->myEvents.Pop(event))
 			{
-				if (currentTime - instance->myEncoderButtonLastTime < controls.debounceDelayUs)
-				{
-					continue;
-				}
-				bool pinHigh = !gpio_get(gpio);
-				if (!pinHigh && (currentTime - instance->myEncoderButtonLastTime > controls.unitsSwitchDelayMs * 1000))
+				const uint32_t latency = time_us_32() - event.timeUs;
+				instance->myStats.events++;
+				instance->myStats.lastLatencyUs = latency;
+				instance->myStats.maxLatencyUs = std::max(instance->myStats.maxLatencyUs, latency);
+
+				for (uint32_t changed = event.changed; changed != 0; changed &= changed - 1)
 				{
-					BaseType_t woken = false;
-					StateChange stateChange(DeviceState::UNITS_TOGGLE);
-					instance->myUi->OnValueChange(stateChange);
+					instance->HandleChange(static_cast<uint>(__builtin_ctz(changed)), event);
 				}
-				instance->myEncoderButtonLastTime = currentTime;
 			}
-			taskYIELD();
 		}
 	}
 
 	template <typename DerivedStepper>
-	void Switches<DerivedStepper>::SwitchInterruptHandler(uint gpio, uint32_t events)
+	void Switches<DerivedStepper>::HandleChange(uint aPin, const SwitchEvent &anEvent)
 	{
-		BaseType_t higherPriorityTaskWoken = pdFALSE;
-		auto instance = myInstance;
-		BaseType_t result = xQueueSendFromISR(instance->myGPIOEventQueue, &gpio, &higherPriorityTaskWoken);
-		if (result == errQUEUE_FULL)
+		const bool pinHigh = (anEvent.levels & (1u << aPin)) == 0; // switches are active-low
+		const PinStateMapping &mapping = myPinStates[aPin];
+		if (mapping.isLever)
 		{
-			Panic("GPIO event queue full - cannot insert new event");
+			StateChange stateChange(pinHigh ? mapping.highState : mapping.lowState);
+			myUi->OnValueChange(stateChange);
+		}
+		else if (aPin == myControls.encoderButtonPin)
+		{
+			// with the rapid switch held and no lever the button stores and recalls a position instead, as the
+			// levers were when it was pressed
+			const uint32_t levels = anEvent.levels;
+			const bool recall = (levels & (1u << myControls.rapidPin)) == 0 && (levels & (1u << myControls.leftPin)) != 0 && (levels & (1u << myControls.rightPin)) != 0;
+			// timed between the samples, however long either waited in the ring
+			if (!pinHigh && (anEvent.timeUs - myEncoderButtonLastTime > myControls.unitsSwitchDelayMs * 1000))
+			{
+				StateChange stateChange(recall ? DeviceState::POSITION_STORE : DeviceState::UNITS_TOGGLE);
+				myUi->OnValueChange(stateChange);
+			}
+			else if (!pinHigh)
+			{
+				// a short press, feed per revolution on the axis that follows the spindle
+				StateChange stateChange(recall ? DeviceState::POSITION_GOTO : DeviceState::SYNC_TOGGLE);
+				myUi->OnValueChange(stateChange);
+			}
+			myEncoderButtonLastTime = anEvent.timeUs;
 		}
-		if (higherPriorityTaskWoken)
+	}
+
+	template <typename DerivedStepper>
+	void Switches<DerivedStepper>::EncoderEdge(void *anOwner, uint aPin, uint32_t anEvents, BaseType_t *aWoken)
+	{
+		// a fast spin is a few hundred edges a second, each is a notify and the task coalesces them
+		vTaskNotifyGiveFromISR(static_cast<Switches<DerivedStepper> *>(anOwner)->myEncoderTask, aWoken);
+	}
+
+	template <typename DerivedStepper>
+	void Switches<DerivedStepper>::SwitchChange(void *anOwner, uint32_t aChanged, uint32_t aLevels, uint32_t aTimeUs, BaseType_t *aWoken)
+	{
+		Switches<DerivedStepper> *instance = static_cast<Switches<DerivedStepper> *>(anOwner);
+		if (!instance->myEvents.Push({aTimeUs, aLevels, aChanged}))
 		{
-			portYIELD_FROM_ISR(higherPriorityTaskWoken);
+			// the switch task is held up, losing a lever change beats stopping the machine
+			instance->myStats.overflows++;
+			return;
 		}
+		instance->myStats.maxDepth = std::max<uint32_t>(instance->myStats.maxDepth, instance->myEvents.Size());
+		vTaskNotifyGiveFromISR(instance->mySwitchTask, aWoken);
 	}
 
 	template <typename DerivedStepper>
 	void Switches<DerivedStepper>::EncoderUpdateTask(void *anInstance)
 	{
 		Switches<DerivedStepper> *instance = static_cast<Switches<DerivedStepper> *>(anInstance);
+		const uint32_t intervalUs = instance->myControls.encoderIntervalMs * 1000;
 		while (1)
 		{
+			// woken by an encoder edge, or after a while to poll the UI
+			ulTaskNotifyTake(pdTRUE, MS_TO_TICKS(UI_POLL_MS));
+
+			const uint32_t sinceSent = time_us_32() - instance->myEncoderSentUs;
+			if (sinceSent < intervalUs)
+			{
+				// still turning, the PIO keeps counting and the counts go out together once the interval is up
+				vTaskDelay(MS_TO_TICKS(((intervalUs - sinceSent + 999) / 1000)));
+				// the edges in the meantime are in the count read next
+				ulTaskNotifyTake(pdTRUE, 0);
+			}
+
 			// note: thanks to two's complement arithmetic delta will always
 			// be correct even when new_value wraps around MAXINT / MININT
-			instance->myEncNewValue = quadrature_encoder_get_count(instance->myEncPio, instance->myEncSm);
+			instance->myEncNewValue = instance->myEncoder->GetCount();
+			const uint32_t readUs = time_us_32();
 			int32_t delta = static_cast<int32_t>(instance->myEncNewValue) - instance->myEncOldValue;
 			instance->myEncOldValue = instance->myEncNewValue;
 			if (delta != 0)
 			{
-				ValueChange<int16_t> stateChange(DeviceState::ENCODER_CHANGED, delta);
+				const int32_t increment = instance->myEncoderAcceleration->Apply(delta, readUs);
+				ValueChange<int16_t> stateChange(DeviceState::ENCODER_CHANGED, static_cast<int16_t>(std::clamp<int32_t>(increment, INT16_MIN, INT16_MAX)));
 				instance->myUi->OnValueChange(stateChange);
+				instance->myEncoderSentUs = time_us_32();
 			}
-			vTaskDelay(MS_TO_TICKS(100));
+			instance->myUi->Poll();
 		}
 	}
 
+	template <typename DerivedStepper>
+	typename Switches<DerivedStepper>::Stats Switches<DerivedStepper>::GetStats()
+	{
+		taskENTER_CRITICAL();
+		Stats stats = myStats;
+		taskEXIT_CRITICAL();
+		return stats;
+	}
+
 	// Explicit instantiations for the template class
 	template class Switches<PowerFeed::Drivers::PicoStepper>;
 
@@ -2,7 +2,11 @@
 
 #include "../UI.hxx"
 #include "../drivers/stepper/PicoStepper.hxx"
+#include "EncoderAcceleration.hxx"
+#include "GpioDispatch.hxx"
+#include "PicoQuadratureEncoder.hxx"
 #include "Settings.hxx"
+#include "SpscQueue.hxx"
 #include "config.h"
 #include <FreeRTOS.h>
 #include <array>
@@ -11,45 +15,88 @@
 #include <hardware/pio.h>
 #include <memory>
 #include <pico/mutex.h>
-#include <queue.h>
 
 namespace PowerFeed::Drivers
 {
 
 	struct PinStateMapping
 	{
-		uint pin;
+		bool isLever;
 		DeviceState highState;
 		DeviceState lowState;
 	};
 
+	/**
+	@brief Debounced changes of the levers and the button at one sample, the switches are active low */
+	struct SwitchEvent
+	{
+		// when the sample that let the changes through was taken, DEBOUNCE_DELAY_US after the contacts settled
+		uint32_t timeUs;
+		// every GPIO at that sample, with the debounced levels in place of the raw ones of the levers and the button
+		uint32_t levels;
+		// the pins that changed
+		uint32_t changed;
+	};
+
+	/**
+	@brief Levers, encoder and encoder button of one axis, registered with the GpioDispatch, so create it from main
+	before the scheduler starts. The PIO counts the encoder, its pins' edges only wake the encoder task, which sends
+	the count on at most once every ENCODER_INTERVAL_MS. The levers and the button have no edge interrupts, the
+	dispatch samples them and only the changes that make it through the debounce reach the switch task, so a
+	bouncing contact costs no more than a clean one. They go through a lock free ring with the time and levels they were sampled at, the task handles
+	whatever has queued up each time it runs and a full ring drops the changes and counts them. */
 	template <typename DerivedStepper>
 	class Switches
 	{
 	public:
+		/**
+		@brief Controls of the axis that aUi drives */
 		Switches(SettingsManager *aSettings, UI<DerivedStepper> *aUi);
 
+		struct Stats
+		{
+			// samples with a change handled, and dropped because the ring was full
+			uint32_t events;
+			uint32_t overflows;
+			// most changes queued at once
+			uint32_t maxDepth;
+			// from the sample to the switch task handling it
+			uint32_t lastLatencyUs;
+			uint32_t maxLatencyUs;
+		};
+
+		Stats GetStats();
+
 	private:
-		// required by the ISR handler callback unfortunately
-		static Switches<DerivedStepper> *myInstance;
 		UI<DerivedStepper> *myUi;
 		SettingsManager *mySettingsManager;
+		Settings::Controls myControls;
+
+		void HandleChange(uint aPin, const SwitchEvent &anEvent);
 
-		static void SwitchInterruptHandler(uint gpio, uint32_t events);
+		static void EncoderEdge(void *anOwner, uint aPin, uint32_t anEvents, BaseType_t *aWoken);
+		static void SwitchChange(void *anOwner, uint32_t aChanged, uint32_t aLevels, uint32_t aTimeUs, BaseType_t *aWoken);
 		static void EncoderUpdateTask(void *instance);
 		static void SwitchUpdateTask(void *instance);
 		uint32_t myEncNewValue = 0;
 		uint32_t myEncOldValue = 0;
 		uint8_t myLastEncState = 0;
-		PIO myEncPio = pio1;
-		uint myEncSm = 0;
-
-		uint myEncOffset;
-		QueueHandle_t myGPIOEventQueue;
+		PicoQuadratureEncoder *myEncoder;
+		TaskHandle_t myEncoderTask = nullptr;
+		EncoderAcceleration *myEncoderAcceleration;
+		// when the last change went to the UI
+		uint32_t myEncoderSentUs = 0;
+		// the UI redraws a stall or an emergency stop when polled, the encoder task polls it this often when idle
+		static constexpr uint32_t UI_POLL_MS = 100;
 
-		PinStateMapping PIN_STATES[3];
+		// the dispatch's debounce timer pushes, the switch task pops
+		SpscQueue<SwitchEvent, 16> myEvents;
+		TaskHandle_t mySwitchTask = nullptr;
+		// each field is written by the timer callback or by the switch task, never both
+		Stats myStats = {};
 
-		std::array<uint32_t, sizeof(PIN_STATES) / sizeof(PIN_STATES[0])> myLastPinTimes = {0};
+		// what a change of each pin means, by GPIO number
+		PinStateMapping myPinStates[GpioDispatch::PIN_COUNT] = {};
 
 		uint32_t myEncoderButtonLastTime = 0;
 		bool myEncoderButtonLastState = false;
@@ -0,0 +1,70 @@
+#include "PicoStartGroup.hxx"
+#include "Assert.hxx"
+#include "PicoStepper.hxx"
+#include <FreeRTOS.h>
+#include <task.h>
+
+namespace PowerFeed::Drivers
+{
+	PicoStartGroup::PicoStartGroup(PIO aPio) : myPio(aPio)
+	{
+	}
+
+	void PicoStartGroup::Add(PicoStepper *aStepper)
+	{
+		if (aStepper->myStream->GetPio() != myPio)
+		{
+			Panic("PicoStartGroup: Steppers that start in sync must share a PIO\n");
+		}
+		if (myMemberCount == Settings::MAX_AXES)
+		{
+			Panic("PicoStartGroup: Too many steppers\n");
+		}
+
+		aStepper->myStartGroup = this;
+		myMembers[myMemberCount++] = aStepper;
+	}
+
+	bool PicoStartGroup::Start()
+	{
+		taskENTER_CRITICAL();
+		if (myWaiting != 0)
+		{
+			taskEXIT_CRITICAL();
+			for (size_t i = 0; i < myMemberCount; i++)
+			{
+				myMembers[i]->PrivSend(PicoStepper::Command::Type::START);
+			}
+			return false;
+		}
+		myWaiting = myMemberCount;
+		myHeldMask = 0;
+		taskEXIT_CRITICAL();
+
+		for (size_t i = 0; i < myMemberCount; i++)
+		{
+			myMembers[i]->PrivSend(PicoStepper::Command::Type::START, PicoStepper::START_IN_SYNC);
+		}
+		return true;
+	}
+
+	void PicoStartGroup::Stop()
+	{
+		for (size_t i = 0; i < myMemberCount; i++)
+		{
+			myMembers[i]->PrivSend(PicoStepper::Command::Type::STOP);
+		}
+	}
+
+	void PicoStartGroup::PrivReady(uint32_t aSmMask)
+	{
+		taskENTER_CRITICAL();
+		myHeldMask |= aSmMask;
+		if (myWaiting > 0 && --myWaiting == 0 && myHeldMask != 0)
+		{
+			pio_enable_sm_mask_in_sync(myPio, myHeldMask);
+		}
+		taskEXIT_CRITICAL();
+	}
+
+} // namespace PowerFeed::Drivers
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "Settings.hxx"
+#include <hardware/pio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace PowerFeed::Drivers
+{
+	class PicoStepper;
+
+	/**
+	@brief Starts several steppers on one PIO block in the same PIO cycle. Every member queues its first steps with its
+	step state machine stopped and the last one to get there starts them all with pio_enable_sm_mask_in_sync, which
+	also lines up their clock dividers. A member that is still moving when the group starts carries on as it would
+	with Start() and does not hold the others back.
+	Built by main from the axes that share a DRIVER_START_GROUP, the members then start and stop as one whichever of
+	them is started or stopped, each at its own speed and direction. */
+	class PicoStartGroup
+	{
+	public:
+		explicit PicoStartGroup(PIO aPio);
+
+		/**
+		@brief Add every member before the first Start(), panics if aStepper runs on another PIO block */
+		void Add(PicoStepper *aStepper);
+
+		/**
+		@brief Start every member
+		@return false while the previous start is still waiting for a member, the members are then started one by one
+		so that the start is not lost */
+		bool Start();
+
+		/**
+		@brief Stop every member */
+		void Stop();
+
+	private:
+		friend class PicoStepper;
+
+		/**
+		@brief From a member's task once its steps are queued, aSmMask has its held state machine or is 0 if it could
+		not be held */
+		void PrivReady(uint32_t aSmMask);
+
+		PIO myPio;
+		PicoStepper *myMembers[Settings::MAX_AXES] = {};
+		size_t myMemberCount = 0;
+		// members that have not queued their steps yet, and the state machines held for the ones that have
+		size_t myWaiting = 0;
+		uint32_t myHeldMask = 0;
+	};
+
+} // namespace PowerFeed::Drivers
@@ -0,0 +1,55 @@
+#include "PicoStepCounter.hxx"
+#include "drivers/PioProgram.hxx"
+#include "stepper.pio.h"
+#include <hardware/dma.h>
+
+namespace PowerFeed::Drivers
+{
+	PicoStepCounter::PicoStepCounter(PIO aPio, uint aStepPin, uint aDirPin)
+		: myPio(aPio)
+	{
+		mySm = pio_claim_unused_sm(myPio, true);
+		myOffset = PioProgram::Add(myPio, &stepcounter_program);
+
+		for (uint i = 0; i < 2; i++)
+		{
+			myDmaChannels[i] = dma_claim_unused_channel(true);
+		}
+
+		// each channel reloads its full count when its partner chains to it, so the pair runs forever
+		for (uint i = 0; i < 2; i++)
+		{
+			dma_channel_config config = dma_channel_get_default_config(myDmaChannels[i]);
+			channel_config_set_transfer_data_size(&config, DMA_SIZE_32);
+			channel_config_set_read_increment(&config, false);
+			channel_config_set_write_increment(&config, false);
+			channel_config_set_dreq(&config, pio_get_dreq(myPio, mySm, false));
+			channel_config_set_chain_to(&config, myDmaChannels[i ^ 1]);
+			dma_channel_configure(myDmaChannels[i], &config, &myPosition, &myPio->rxf[mySm], CHAIN_TRANSFERS, false);
+		}
+		dma_channel_start(myDmaChannels[0]);
+
+		stepcounter_program_init(myPio, mySm, myOffset, aStepPin, aDirPin);
+	}
+
+	PicoStepCounter::~PicoStepCounter()
+	{
+		pio_sm_set_enabled(myPio, mySm, false);
+
+		for (uint i = 0; i < 2; i++)
+		{
+			// clear the chain first so the abort does not start the partner again
+			dma_channel_config config = dma_channel_get_default_config(myDmaChannels[i]);
+			dma_channel_set_config(myDmaChannels[i], &config, false);
+		}
+		for (uint i = 0; i < 2; i++)
+		{
+			dma_channel_abort(myDmaChannels[i]);
+			dma_channel_unclaim(myDmaChannels[i]);
+		}
+
+		PioProgram::Remove(myPio, &stepcounter_program);
+		pio_sm_unclaim(myPio, mySm);
+	}
+
+} // namespace PowerFeed::Drivers
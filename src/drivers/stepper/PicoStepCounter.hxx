@@ -0,0 +1,31 @@
+#pragma once
+
+#include <hardware/pio.h>
+#include <stdint.h>
+
+namespace PowerFeed::Drivers
+{
+	/**
+	@brief Counts the steps actually emitted on the step pin with the stepcounter PIO program.
+	Positive while the direction pin is high. The count is copied to memory by DMA with no CPU
+	involvement, so GetPosition() is a single 32 bit read that is safe from any core or interrupt. */
+	class PicoStepCounter
+	{
+	public:
+		PicoStepCounter(PIO aPio, uint aStepPin, uint aDirPin);
+		~PicoStepCounter();
+
+		int32_t GetPosition() const { return myPosition; }
+
+	private:
+		// transfers per DMA channel before it chains to its partner and the pair carries on
+		static constexpr uint32_t CHAIN_TRANSFERS = 0xffffffff;
+
+		PIO myPio;
+		uint mySm;
+		uint myOffset;
+		int myDmaChannels[2] = {-1, -1};
+		volatile int32_t myPosition = 0;
+	};
+
+} // namespace PowerFeed::Drivers
@@ -0,0 +1,357 @@
+#include "PicoStepStream.hxx"
+#include "Assert.hxx"
+#include "drivers/PioProgram.hxx"
+#include "stepper.pio.h"
+#include <FreeRTOS.h>
+#include <hardware/clocks.h>
+#include <hardware/irq.h>
+#include <hardware/timer.h>
+#include <task.h>
+
+namespace PowerFeed::Drivers
+{
+	PicoStepStream *PicoStepStream::myChannelOwners[NUM_DMA_CHANNELS] = {};
+	PicoStepStream *PicoStepStream::myFifoOwners[NUM_PIOS][NUM_PIO_STATE_MACHINES] = {};
+	bool PicoStepStream::myHandlerAdded[NUM_IRQS] = {};
+
+	PicoStepStream::PicoStepStream(StepRamp *aRamp, PIO aPio, uint aStepPin, Feed aFeed, uint32_t aPulseNs)
+		: myRamp(aRamp), myPio(aPio), myFeed(aFeed)
+	{
+		myHorizonTicks = static_cast<uint32_t>((static_cast<uint64_t>(GetTickHz(aPulseNs)) * REFILL_HORIZON_US) / 1000000);
+		myProgram = aPulseNs > 0 ? &pulsestepper_program : &simplestepper_program;
+		myHighLoops = aPulseNs > 0 ? pulsestepper_high_loops(aPulseNs) : 0;
+		myWordsPerStep = aPulseNs > 0 ? 1 : 2;
+
+		mySm = pio_claim_unused_sm(myPio, true);
+		myOffset = PioProgram::Add(myPio, myProgram);
+
+		if (aPulseNs > 0)
+		{
+			pulsestepper_program_init(myPio, mySm, myOffset, aStepPin, myHighLoops);
+			myIdlePc = myOffset + pulsestepper_offset_start;
+		}
+		else
+		{
+			simplestepper_program_init(myPio, mySm, myOffset, aStepPin, SPLIT_PERIOD_CLOCK_DIVIDER);
+			myIdlePc = myOffset + simplestepper_offset_start;
+		}
+
+		if (myFeed != Feed::DMA)
+		{
+			return;
+		}
+
+		for (uint half = 0; half < 2; half++)
+		{
+			myDmaChannels[half] = dma_claim_unused_channel(true);
+		}
+	}
+
+	void PicoStepStream::AttachInterrupts()
+	{
+		myIrqIndex = get_core_num();
+
+		if (myFeed != Feed::DMA)
+		{
+			myFifoOwners[pio_get_index(myPio)][mySm] = this;
+			uint irq = PIO0_IRQ_0 + 2 * pio_get_index(myPio) + myIrqIndex;
+			AddHandler(irq, myIrqIndex == 0 ? PioIrq0Handler : PioIrq1Handler);
+			return;
+		}
+
+		for (uint half = 0; half < 2; half++)
+		{
+			myChannelOwners[myDmaChannels[half]] = this;
+			dma_irqn_set_channel_enabled(myIrqIndex, myDmaChannels[half], true);
+		}
+
+		AddHandler(DMA_IRQ_0 + myIrqIndex, myIrqIndex == 0 ? DmaIrq0Handler : DmaIrq1Handler);
+	}
+
+	void PicoStepStream::AddHandler(uint anIrq, irq_handler_t aHandler)
+	{
+		// every stream on this core shares the handler, it finds its owners through the tables
+		taskENTER_CRITICAL();
+		if (!myHandlerAdded[anIrq])
+		{
+			irq_add_shared_handler(anIrq, aHandler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+			myHandlerAdded[anIrq] = true;
+		}
+		taskEXIT_CRITICAL();
+		irq_set_enabled(anIrq, true);
+	}
+
+	PicoStepStream::~PicoStepStream()
+	{
+		if (myFeed != Feed::DMA)
+		{
+			pio_set_irqn_source_enabled(myPio, myIrqIndex, static_cast<pio_interrupt_source>(pis_sm0_tx_fifo_not_full + mySm), false);
+			myFifoOwners[pio_get_index(myPio)][mySm] = nullptr;
+		}
+
+		for (uint half = 0; half < 2; half++)
+		{
+			if (myDmaChannels[half] < 0)
+			{
+				continue;
+			}
+			dma_irqn_set_channel_enabled(myIrqIndex, myDmaChannels[half], false);
+			dma_channel_abort(myDmaChannels[half]);
+			myChannelOwners[myDmaChannels[half]] = nullptr;
+			dma_channel_unclaim(myDmaChannels[half]);
+		}
+
+		pio_sm_set_enabled(myPio, mySm, false);
+		PioProgram::Remove(myPio, myProgram);
+		pio_sm_unclaim(myPio, mySm);
+	}
+
+	uint32_t PicoStepStream::GetTickHz(uint32_t aPulseNs)
+	{
+		if (aPulseNs > 0)
+		{
+			return clock_get_hz(clk_sys);
+		}
+		return static_cast<uint32_t>(clock_get_hz(clk_sys) / SPLIT_PERIOD_CLOCK_DIVIDER);
+	}
+
+	void PicoStepStream::Kick()
+	{
+		if (myFeed == Feed::DMA && GetRingState() == RingState::IDLE)
+		{
+			PrimeRing();
+		}
+	}
+
+	bool PicoStepStream::Service()
+	{
+		uint64_t begin = time_us_64();
+		uint32_t steps = 0;
+		// fill the FIFO right up, splitting a step across calls if need be, so the not full interrupt only fires once a word has been consumed
+		while (!pio_sm_is_tx_fifo_full(myPio, mySm))
+		{
+			if (myPendingNext == myPendingCount)
+			{
+				uint32_t period = myRamp->NextPeriod();
+				if (period == 0)
+				{
+					break;
+				}
+				myPendingCount = Encode(period, myPending);
+				myPendingNext = 0;
+				steps++;
+			}
+			pio_sm_put(myPio, mySm, myPending[myPendingNext++]);
+		}
+
+		if (steps > 0)
+		{
+			myStats.refills++;
+			myStats.steps += steps;
+			myStats.busyUs += time_us_64() - begin;
+		}
+
+		return myPendingNext != myPendingCount || myRamp->GetState() != StepRamp::State::STOPPED;
+	}
+
+	void PicoStepStream::ArmRefill()
+	{
+		pio_set_irqn_source_enabled(myPio, myIrqIndex, static_cast<pio_interrupt_source>(pis_sm0_tx_fifo_not_full + mySm), true);
+	}
+
+	void PicoStepStream::Hold()
+	{
+		pio_sm_set_enabled(myPio, mySm, false);
+	}
+
+	void __not_in_flash_func(PicoStepStream::Halt)()
+	{
+		// atomic clear, pio_sm_set_enabled is a read modify write of a register the other core may be writing
+		hw_clear_bits(&myPio->ctrl, 1u << (PIO_CTRL_SM_ENABLE_LSB + mySm));
+		// both programs have a single side set bit for the step pin, it is driven low whatever was executing
+		pio_sm_exec(myPio, mySm, pio_encode_nop() | pio_encode_sideset(1, 0));
+	}
+
+	void PicoStepStream::Abort()
+	{
+		Halt();
+		if (myFeed == Feed::DMA)
+		{
+			for (uint half = 0; half < 2; half++)
+			{
+				// no chaining and no completion interrupt from the abort, the ring is not coming back to refill
+				int channel = myDmaChannels[half];
+				dma_irqn_set_channel_enabled(myIrqIndex, channel, false);
+				dma_channel_config config = dma_channel_get_default_config(channel);
+				dma_channel_set_config(channel, &config, false);
+				dma_channel_abort(channel);
+				dma_irqn_acknowledge_channel(myIrqIndex, channel);
+				dma_irqn_set_channel_enabled(myIrqIndex, channel, true);
+			}
+			ResetRing();
+		}
+		else
+		{
+			pio_set_irqn_source_enabled(myPio, myIrqIndex, static_cast<pio_interrupt_source>(pis_sm0_tx_fifo_not_full + mySm), false);
+		}
+		myPendingCount = 0;
+		myPendingNext = 0;
+
+		// back to the first pull, no restart since pulsestepper keeps its high time in ISR
+		pio_sm_clear_fifos(myPio, mySm);
+		pio_sm_exec(myPio, mySm, pio_encode_jmp(myIdlePc) | pio_encode_sideset(1, 0));
+		pio_sm_set_enabled(myPio, mySm, true);
+	}
+
+	bool PicoStepStream::IsIdle() const
+	{
+		if (GetRingState() != RingState::IDLE || myPendingNext != myPendingCount)
+		{
+			return false;
+		}
+
+		// the program stalls on its first pull once it has finished the last queued step
+		return pio_sm_is_tx_fifo_empty(myPio, mySm) &&
+			   pio_sm_get_pc(myPio, mySm) == myIdlePc;
+	}
+
+	uint PicoStepStream::Encode(uint32_t aPeriod, uint32_t *aWords) const
+	{
+		if (myWordsPerStep == 1)
+		{
+			aWords[0] = pulsestepper_encode(aPeriod, myHighLoops);
+			return 1;
+		}
+
+		simplestepper_encode(aPeriod, aWords);
+		return 2;
+	}
+
+	size_t PicoStepStream::Fill(uint32_t *aBuffer, size_t aMaxWords)
+	{
+		uint64_t begin = time_us_64();
+		size_t words = 0;
+		uint32_t steps = 0;
+		uint32_t ticks = 0;
+		while (words + MAX_WORDS_PER_STEP <= aMaxWords && ticks < myHorizonTicks)
+		{
+			uint32_t period = myRamp->NextPeriod();
+			if (period == 0)
+			{
+				break;
+			}
+
+			words += Encode(period, &aBuffer[words]);
+			ticks += period;
+			steps++;
+		}
+
+		myStats.refills++;
+		myStats.steps += steps;
+		myStats.busyUs += time_us_64() - begin;
+		return words;
+	}
+
+	void PicoStepStream::ArmHalf(uint aHalf, size_t aWords)
+	{
+		int channel = myDmaChannels[aHalf];
+		dma_channel_config config = dma_channel_get_default_config(channel);
+		channel_config_set_transfer_data_size(&config, DMA_SIZE_32);
+		channel_config_set_read_increment(&config, true);
+		channel_config_set_write_increment(&config, false);
+		channel_config_set_dreq(&config, pio_get_dreq(myPio, mySm, true));
+		// chaining to itself disables chaining, the other half is chained on once it has been refilled
+		channel_config_set_chain_to(&config, channel);
+		dma_channel_configure(channel, &config, &myPio->txf[mySm], myBuffers[aHalf], aWords, false);
+		// a completion left over from before a restart is not this one's
+		dma_irqn_acknowledge_channel(myIrqIndex, channel);
+	}
+
+	void PicoStepStream::ChainToHalf(uint aHalf)
+	{
+		// only the chain field of the other channel, which may be running, its busy and error bits stay as they are
+		dma_channel_hw_t *other = dma_channel_hw_addr(myDmaChannels[aHalf ^ 1]);
+		hw_write_masked(&other->al1_ctrl, static_cast<uint32_t>(myDmaChannels[aHalf]) << DMA_CH0_CTRL_TRIG_CHAIN_TO_LSB, DMA_CH0_CTRL_TRIG_CHAIN_TO_BITS);
+	}
+
+	bool PicoStepStream::IsHalfBusy(uint aHalf) const
+	{
+		return dma_channel_is_busy(myDmaChannels[aHalf]);
+	}
+
+	bool PicoStepStream::HasHalfStarted(uint aHalf) const
+	{
+		// the transfer count reads 0 before a trigger as well as after, the read address only moves once triggered
+		return dma_channel_hw_addr(myDmaChannels[aHalf])->read_addr != reinterpret_cast<uintptr_t>(myBuffers[aHalf]);
+	}
+
+	void PicoStepStream::StartHalf(uint aHalf)
+	{
+		dma_channel_start(myDmaChannels[aHalf]);
+	}
+
+	void PicoStepStream::OnDmaComplete(uint aHalf)
+	{
+		UBaseType_t saved = taskENTER_CRITICAL_FROM_ISR();
+		OnHalfComplete(aHalf);
+		taskEXIT_CRITICAL_FROM_ISR(saved);
+	}
+
+	void PicoStepStream::WakeFromISR()
+	{
+		if (myWakeTask == nullptr)
+		{
+			return;
+		}
+		BaseType_t woken = pdFALSE;
+		vTaskNotifyGiveFromISR(myWakeTask, &woken);
+		portYIELD_FROM_ISR(woken);
+	}
+
+	void PicoStepStream::DmaIrqHandler(uint anIrqIndex)
+	{
+		uint32_t pending = anIrqIndex == 0 ? dma_hw->ints0 : dma_hw->ints1;
+		while (pending != 0)
+		{
+			uint channel = __builtin_ctz(pending);
+			pending &= pending - 1;
+
+			PicoStepStream *owner = myChannelOwners[channel];
+			if (owner == nullptr)
+			{
+				// belongs to another user of the shared DMA interrupt
+				continue;
+			}
+			if (((anIrqIndex == 0 ? dma_hw->ints0 : dma_hw->ints1) & (1u << channel)) == 0)
+			{
+				// dropped by a restart from the completion of the other half
+				continue;
+			}
+
+			dma_irqn_acknowledge_channel(anIrqIndex, channel);
+			owner->OnDmaComplete(static_cast<int>(channel) == owner->myDmaChannels[0] ? 0 : 1);
+		}
+	}
+
+	void PicoStepStream::PioIrqHandler(uint anIrqIndex)
+	{
+		for (uint index = 0; index < NUM_PIOS; index++)
+		{
+			PIO pio = pio_get_instance(index);
+			uint32_t pending = anIrqIndex == 0 ? pio->ints0 : pio->ints1;
+			for (uint sm = 0; sm < NUM_PIO_STATE_MACHINES; sm++)
+			{
+				PicoStepStream *owner = myFifoOwners[index][sm];
+				if (owner == nullptr || owner->myIrqIndex != anIrqIndex || (pending & (PIO_INTR_SM0_TXNFULL_BITS << sm)) == 0)
+				{
+					continue;
+				}
+
+				// level triggered, disarm until the owner has refilled the FIFO
+				pio_set_irqn_source_enabled(pio, anIrqIndex, static_cast<pio_interrupt_source>(pis_sm0_tx_fifo_not_full + sm), false);
+				owner->WakeFromISR();
+			}
+		}
+	}
+
+} // namespace PowerFeed::Drivers
@@ -0,0 +1,158 @@
+#pragma once
+
+#include "StepRamp.hxx"
+#include "StepRing.hxx"
+#include <FreeRTOS.h>
+#include <hardware/dma.h>
+#include <hardware/irq.h>
+#include <hardware/pio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <task.h>
+
+namespace PowerFeed::Drivers
+{
+	/**
+	@brief Feeds a step PIO program with the step periods produced by a StepRamp.
+	With a pulse width of 0 the simplestepper program is used, two words per step at a 1us tick.
+	Otherwise pulsestepper runs at the system clock with that fixed high time and one word per step.
+	In TASK mode the owner pushes words into the TX FIFO by calling Service() whenever the wake task is notified
+	by the TX FIFO not full interrupt.
+	In DMA mode two DMA channels stream a ring buffer into the FIFO and each half of the ring
+	is refilled from the DMA completion interrupt, so no task has to keep up with the step rate.
+	A half is chained behind the other once it has been refilled, see StepRing for the order.
+	The wake task is only notified once the ring has run dry.
+	The caller must hold a critical section while it touches the ramp, the DMA interrupt takes the same one.
+	Interrupts use IRQ line 0 of the DMA and the PIO on core 0 and line 1 on core 1, so streams of axes that run on
+	different cores never service each other's interrupts. */
+	class PicoStepStream : private StepRing<PicoStepStream>
+	{
+		friend class StepRing<PicoStepStream>;
+
+	public:
+		enum class Feed : uint8_t
+		{
+			TASK,
+			DMA
+		};
+
+		struct Stats
+		{
+			uint32_t refills;
+			uint32_t steps;
+			// time spent generating and encoding periods, compare against wall time for the CPU load of step generation
+			uint64_t busyUs;
+		};
+
+		/**
+		@brief Claims a free state machine on aPio, the step program is shared with the other streams on it */
+		PicoStepStream(StepRamp *aRamp, PIO aPio, uint aStepPin, Feed aFeed, uint32_t aPulseNs);
+		~PicoStepStream();
+
+		/**
+		@brief Hook up the DMA or PIO interrupt. Interrupts are enabled per core, call this from the core that should service them
+		and before the first Kick() or ArmRefill(). */
+		void AttachInterrupts();
+
+		/**
+		@brief Start streaming the ramp if the ring is idle. Has no effect in TASK mode. */
+		void Kick();
+
+		/**
+		@brief Top up the TX FIFO from the ramp. TASK mode only, must be called faster than the FIFO drains.
+		@return true while there is more to push, arm the refill interrupt and wait for it before calling again */
+		bool Service();
+
+		/**
+		@brief Notify the wake task once the TX FIFO has room again. TASK mode only, the interrupt disarms itself when it fires. */
+		void ArmRefill();
+
+		/**
+		@brief Task to notify when the stream needs the attention of its owner */
+		void SetWakeTask(TaskHandle_t aTask) { myWakeTask = aTask; }
+
+		/**
+		@brief True once every queued step has been emitted and the state machine is waiting for more */
+		bool IsIdle() const;
+
+		/**
+		@brief Stop the state machine so the next Kick() or Service() only queues steps, for starting several axes in
+		the same PIO cycle with pio_enable_sm_mask_in_sync. Only while idle, it would freeze a move otherwise. */
+		void Hold();
+
+		/**
+		@brief Stop the step output at once, from any core and from an interrupt. The pin is left low, a pulse that
+		was in progress is cut short. The queued steps stay where they are until Abort(). */
+		void Halt();
+
+		/**
+		@brief Drop every queued step after a Halt() and leave the stream idle and ready for the next Kick().
+		Takes the same critical section as the refill interrupt. */
+		void Abort();
+
+		Feed GetFeed() const { return myFeed; }
+		PIO GetPio() const { return myPio; }
+		uint GetSm() const { return mySm; }
+		Stats GetStats() const { return myStats; }
+
+		/**
+		@brief Rate of the ticks that step periods are expressed in for the program selected by aPulseNs */
+		static uint32_t GetTickHz(uint32_t aPulseNs);
+
+	private:
+		static constexpr float SPLIT_PERIOD_CLOCK_DIVIDER = 125.0f;
+		static constexpr uint MAX_WORDS_PER_STEP = 2;
+		static constexpr size_t HALF_WORDS = 256;
+		// stop filling a half once it holds this much motion, so that speed changes are not stuck behind a long queue at low speeds
+		static constexpr uint32_t REFILL_HORIZON_US = 2000;
+
+		uint Encode(uint32_t aPeriod, uint32_t *aWords) const;
+		size_t Fill(uint32_t *aBuffer, size_t aMaxWords);
+		void OnDmaComplete(uint aHalf);
+
+		// the channels of the StepRing
+		size_t FillHalf(uint aHalf) { return Fill(myBuffers[aHalf], HALF_WORDS); }
+		bool HasMoreSteps() const { return myRamp->GetState() != StepRamp::State::STOPPED; }
+		void ArmHalf(uint aHalf, size_t aWords);
+		void ChainToHalf(uint aHalf);
+		bool IsHalfBusy(uint aHalf) const;
+		bool HasHalfStarted(uint aHalf) const;
+		void StartHalf(uint aHalf);
+		void WakeFromISR();
+
+		static void DmaIrqHandler(uint anIrqIndex);
+		static void DmaIrq0Handler() { DmaIrqHandler(0); }
+		static void DmaIrq1Handler() { DmaIrqHandler(1); }
+		static void PioIrqHandler(uint anIrqIndex);
+		static void PioIrq0Handler() { PioIrqHandler(0); }
+		static void PioIrq1Handler() { PioIrqHandler(1); }
+		static void AddHandler(uint anIrq, irq_handler_t aHandler);
+
+		static PicoStepStream *myChannelOwners[NUM_DMA_CHANNELS];
+		static PicoStepStream *myFifoOwners[NUM_PIOS][NUM_PIO_STATE_MACHINES];
+		static bool myHandlerAdded[NUM_IRQS];
+
+		StepRamp *myRamp;
+		PIO myPio;
+		uint mySm;
+		uint myOffset;
+		uint myIdlePc;
+		Feed myFeed;
+		// DMA and PIO interrupt line, the index of the core the interrupts were attached from
+		uint myIrqIndex = 0;
+		const pio_program_t *myProgram;
+		uint myWordsPerStep;
+		// pulsestepper only
+		uint32_t myHighLoops;
+		uint32_t myHorizonTicks;
+		int myDmaChannels[2] = {-1, -1};
+		uint32_t myBuffers[2][HALF_WORDS];
+		// words of a step that did not fit in the TX FIFO yet, TASK mode only
+		uint32_t myPending[MAX_WORDS_PER_STEP];
+		uint myPendingCount = 0;
+		uint myPendingNext = 0;
+		TaskHandle_t myWakeTask = nullptr;
+		Stats myStats = {};
+	};
+
+} // namespace PowerFeed::Drivers
@@ -0,0 +1,82 @@
+#include "PicoStepTimer.hxx"
+#include "drivers/PioProgram.hxx"
+#include "stepper.pio.h"
+#include <hardware/dma.h>
+
+namespace PowerFeed::Drivers
+{
+	PicoStepTimer::PicoStepTimer(PIO aPio, uint aStepPin)
+		: myPio(aPio)
+	{
+		mySm = pio_claim_unused_sm(myPio, true);
+		myOffset = PioProgram::Add(myPio, &steptimer_program);
+		myDmaChannel = dma_claim_unused_channel(true);
+
+		dma_channel_config config = dma_channel_get_default_config(myDmaChannel);
+		channel_config_set_transfer_data_size(&config, DMA_SIZE_32);
+		channel_config_set_read_increment(&config, false);
+		channel_config_set_write_increment(&config, true);
+		channel_config_set_dreq(&config, pio_get_dreq(myPio, mySm, false));
+		dma_channel_configure(myDmaChannel, &config, myEdges, &myPio->rxf[mySm], CAPTURE_EDGES, false);
+
+		steptimer_program_init(myPio, mySm, myOffset, aStepPin);
+	}
+
+	PicoStepTimer::~PicoStepTimer()
+	{
+		pio_sm_set_enabled(myPio, mySm, false);
+		dma_channel_abort(myDmaChannel);
+		dma_channel_unclaim(myDmaChannel);
+		PioProgram::Remove(myPio, &steptimer_program);
+		pio_sm_unclaim(myPio, mySm);
+	}
+
+	void PicoStepTimer::Start()
+	{
+		Cancel();
+		myCancelled = false;
+
+		// from the top of the program, so the first edge is not one half seen before the restart
+		pio_sm_clear_fifos(myPio, mySm);
+		pio_sm_restart(myPio, mySm);
+		pio_sm_exec(myPio, mySm, pio_encode_jmp(myOffset));
+		dma_channel_set_write_addr(myDmaChannel, myEdges, false);
+		dma_channel_set_trans_count(myDmaChannel, CAPTURE_EDGES, true);
+		pio_sm_set_enabled(myPio, mySm, true);
+	}
+
+	void PicoStepTimer::Cancel()
+	{
+		pio_sm_set_enabled(myPio, mySm, false);
+		if (dma_channel_is_busy(myDmaChannel))
+		{
+			myCancelledAt = GetCaptured();
+			myCancelled = true;
+			dma_channel_abort(myDmaChannel);
+		}
+	}
+
+	bool PicoStepTimer::IsDone() const
+	{
+		return !dma_channel_is_busy(myDmaChannel);
+	}
+
+	uint32_t PicoStepTimer::GetCaptured() const
+	{
+		if (myCancelled)
+		{
+			return myCancelledAt;
+		}
+		return CAPTURE_EDGES - dma_channel_hw_addr(myDmaChannel)->transfer_count;
+	}
+
+	void PicoStepTimer::Analyze(StepTiming &aTiming) const
+	{
+		const uint32_t captured = GetCaptured();
+		for (uint32_t i = 1; i < captured; i++)
+		{
+			aTiming.Add(steptimer_period_cycles(myEdges[i - 1], myEdges[i]));
+		}
+	}
+
+} // namespace PowerFeed::Drivers
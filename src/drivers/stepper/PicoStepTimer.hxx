@@ -0,0 +1,50 @@
+#pragma once
+
+#include "StepTiming.hxx"
+#include <hardware/pio.h>
+#include <stdint.h>
+
+namespace PowerFeed::Drivers
+{
+	/**
+	@brief Timestamps the rising edges of a step pin with the steptimer PIO program, for diagnostics.
+	A capture fills a buffer of edges by DMA without the CPU, then the periods between them are fed to a StepTiming.
+	Takes a spare state machine and a DMA channel. The pin only has to be readable, any PIO block can time any pin. */
+	class PicoStepTimer
+	{
+	public:
+		static constexpr uint32_t CAPTURE_EDGES = 1024;
+
+		PicoStepTimer(PIO aPio, uint aStepPin);
+		~PicoStepTimer();
+
+		/**
+		@brief Drop what was captured so far and capture the next CAPTURE_EDGES edges */
+		void Start();
+
+		/**
+		@brief Stop capturing, the edges captured so far are kept */
+		void Cancel();
+
+		bool IsDone() const;
+
+		/**
+		@brief Edges in the buffer from the last Start() */
+		uint32_t GetCaptured() const;
+
+		/**
+		@brief Add the periods between the captured edges to aTiming */
+		void Analyze(StepTiming &aTiming) const;
+
+	private:
+		PIO myPio;
+		uint mySm;
+		uint myOffset;
+		int myDmaChannel = -1;
+		uint32_t myEdges[CAPTURE_EDGES];
+		// captured by the last capture that was cancelled, dma transfer count is reset by the abort
+		uint32_t myCancelledAt = 0;
+		bool myCancelled = false;
+	};
+
+} // namespace PowerFeed::Drivers
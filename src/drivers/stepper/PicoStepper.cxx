@@ -1,19 +1,27 @@
 #include "PicoStepper.hxx"
 #include "Assert.hxx"
+#include "Helpers.hxx"
+#include "drivers/PicoEStop.hxx"
 #include <FreeRTOS.h>
-#include <PIOStepper.hxx>
+#include <algorithm>
 #include <hardware/gpio.h>
+#include <hardware/timer.h>
 #include <task.h>
 
 namespace PowerFeed::Drivers
 {
-	PicoStepper::PicoStepper(SettingsManager *aSettings, Time *aTime, PIO pio, uint sm)
+	PicoStepper::PicoStepper(SettingsManager *aSettings, Time *aTime, uint8_t anAxis)
 		: mySettingsManager(aSettings), myTime(aTime), myStoppedAt(0), myDirection(false), myTargetDirection(false), myIsEnabled(false), myTaskHandle(nullptr)
 	{
+		const Settings::Axis &axis = mySettingsManager->Get()->axes[anAxis];
+		Settings::Driver driver = axis.driver;
+		Settings::Mechanical mech = axis.mechanical;
 
-		uint sysclk = clock_get_hz(clk_sys);
-		Settings::Driver driver = mySettingsManager->Get()->driver;
-		Settings::Mechanical mech = mySettingsManager->Get()->mechanical;
+		if (driver.driverPio >= NUM_PIOS)
+		{
+			Panic("PicoStepper: DRIVER_PIO must be 0 or 1\n");
+		}
+		PIO pio = pio_get_instance(driver.driverPio);
 
 		gpio_init(driver.driverDirPin);
 		gpio_set_dir(driver.driverDirPin, GPIO_OUT);
@@ -21,29 +29,84 @@ namespace PowerFeed::Drivers
 		gpio_init(driver.driverEnPin);
 		gpio_set_dir(driver.driverEnPin, GPIO_OUT);
 
-		myPIOStepper = new PIOStepperSpeedController::PIOStepper(
-			driver.driverStepPin,
-			driver.driverDirPin,
+		myRamp = new StepRamp(
+			PicoStepStream::GetTickHz(driver.driverStepPulseNs),
 			mech.maxStepsPerSecond,
 			mech.acceleration,
 			mech.deceleration,
-			sysclk,
-			125,
-			nullptr,
-			nullptr,
-			nullptr,
-			nullptr);
+			mech.accelerationJerk,
+			mech.rampTableSegments,
+			mech.jerk,
+			mech.accelerationCurve);
+
+		myStream = new PicoStepStream(
+			myRamp,
+			pio,
+			driver.driverStepPin,
+			driver.driverUseDma ? PicoStepStream::Feed::DMA : PicoStepStream::Feed::TASK,
+			driver.driverStepPulseNs);
+
+		myCounter = new PicoStepCounter(pio, driver.driverStepPin, driver.driverDirPin);
+
+		if (axis.limits.enabled)
+		{
+			// the counter counts up with the direction pin high
+			const int32_t left = static_cast<int32_t>(axis.limits.leftSteps);
+			const int32_t right = static_cast<int32_t>(axis.limits.rightSteps);
+			const int32_t leftEnd = mech.moveLeftDirection ? left : -left;
+			const int32_t rightEnd = mech.moveRightDirection ? right : -right;
+			myLimited = true;
+			myMinPosition = std::min(leftEnd, rightEnd);
+			myMaxPosition = std::max(leftEnd, rightEnd);
+		}
+
+		// the cross feed pulse is timed whether there is an output for it or not, it only costs a wake up
+		const Settings::Reciprocate &reciprocate = axis.reciprocate;
+		myReciprocator = new Reciprocator(reciprocate.dwellMs * 1000, reciprocate.crossFeedEnabled ? reciprocate.crossFeedPulseMs * 1000 : 0);
+		if (reciprocate.crossFeedEnabled)
+		{
+			myCrossFeed = true;
+			myCrossFeedPin = reciprocate.crossFeedPin;
+			gpio_init(myCrossFeedPin);
+			gpio_set_dir(myCrossFeedPin, GPIO_OUT);
+			gpio_put(myCrossFeedPin, false);
+		}
+
+		if (axis.feedback.enabled)
+		{
+			// on pio1 with the knob encoders, at full speed since a motor encoder counts far faster than a knob
+			myFeedbackEncoder = new PicoQuadratureEncoder(pio1, axis.feedback.encoderAPin, 0, axis.feedback.invert);
+			myFollowingError = new FollowingError(axis.feedback.stepsPerEncoderRev, axis.feedback.encoderCountsPerRev, axis.feedback.followingErrorSteps);
+		}
+
+		const Settings::Spindle &spindle = mySettingsManager->Get()->spindle;
+		if (spindle.enabled && spindle.axis == anAxis)
+		{
+			// full speed like the feedback encoder, a 4096 count encoder at 3000rpm is 200k counts a second
+			mySpindleEncoder = new PicoQuadratureEncoder(pio1, spindle.encoderAPin, 0, spindle.invert);
+			mySpindleSync = new SpindleSync(spindle.encoderCountsPerRev, configTICK_RATE_HZ, mech.maxStepsPerSecond);
+		}
 
 		myEnableValue = driver.driverEnableValue;
 		myEnablePin = driver.driverEnPin;
 		myDirPin = driver.driverDirPin;
 		myDisableTimeout = driver.driverDisableTimeout;
+		myDirectionDelayUs = driver.driverDirectionChangeDelayMs * 1000;
 
-		xTaskCreate(PrivUpdateTask, "Stepper", 4 * 2048, this, 15, &myTaskHandle);
+		if (driver.driverCore >= configNUMBER_OF_CORES)
+		{
+			Panic("PicoStepper: DRIVER_CORE must be 0 or 1\n");
+		}
+
+		xTaskCreate(PrivUpdateTask, axis.name.c_str(), 4 * 2048, this, 15, &myTaskHandle);
+
+		// the stepper interrupts are attached from the task, so they follow it onto this core
+		vTaskCoreAffinitySet(myTaskHandle, (1 << driver.driverCore));
 
-		vTaskCoreAffinitySet(myTaskHandle, (1 << 0));
+		myStream->SetWakeTask(myTaskHandle);
 
 		PrivDisable();
+		PrivPublish();
 	}
 
 	PicoStepper::~PicoStepper()
@@ -54,26 +117,70 @@ namespace PowerFeed::Drivers
 			myTaskHandle = nullptr;
 		}
 
-		delete myPIOStepper;
+		delete mySpindleSync;
+		delete mySpindleEncoder;
+		delete myFollowingError;
+		delete myFeedbackEncoder;
+		delete myReciprocator;
+		delete myCounter;
+		delete myStream;
+		delete myRamp;
 	}
 
 	void PicoStepper::SetSpeed(uint32_t speed)
 	{
-		LockGuard<Mutex> lock(myMutex);
-		myPIOStepper->SetTargetHz(speed);
+		PrivSend(Command::Type::SET_SPEED, speed);
 	}
 
-	void PicoStepper::PrivUpdate()
+	TickType_t PicoStepper::PrivUpdate()
 	{
-		LockGuard<Mutex> lock(myMutex);
+		TickType_t wait = portMAX_DELAY;
+
+		// before the commands, a start queued behind the emergency stop must find it latched
+		PrivHandleEStop();
+
+		Command command;
+		while (myCommands.Pop(command))
+		{
+			PrivApply(command);
+		}
+
+		TickType_t startWait = PrivSequence();
+		TickType_t followWait = PrivCheckFollowing();
+		if (followWait < startWait)
+		{
+			startWait = followWait;
+		}
+		TickType_t spindleWait = PrivFollowSpindle();
+		if (spindleWait < startWait)
+		{
+			startWait = spindleWait;
+		}
+		TickType_t reciprocateWait = PrivReciprocate();
+		if (reciprocateWait < startWait)
+		{
+			startWait = reciprocateWait;
+		}
+
 		taskENTER_CRITICAL();
 
-		myPIOStepper->Update();
+		if (myStream->GetFeed() == PicoStepStream::Feed::TASK && myStream->Service())
+		{
+			// the FIFO is full, sleep until the not full interrupt says a word has gone out
+			myStream->ArmRefill();
+		}
 
-		// Check if the stepper is stopped and disable the driver if it is
-		if (myPIOStepper->GetState() == PIOStepperSpeedController::StepperState::STOPPED)
+		// Check if the stepper is stopped and disable the driver if it is, not while it waits on the spindle
+		if (myRamp->GetState() == StepRamp::State::STOPPED && myStream->IsIdle() && !myFollowing)
 		{
-			if (myDisableTimeout >= 0)
+			if (myMovingTo && !myMovePending && !myStartPending && !myReversing)
+			{
+				// landed on the target, or had no room to move towards it
+				myMovingTo = false;
+			}
+
+			// holding the axis at the end of a stroke through the dwell
+			if (myDisableTimeout >= 0 && !myReciprocator->IsActive())
 			{
 				if (myIsEnabled)
 				{
@@ -90,6 +197,12 @@ namespace PowerFeed::Drivers
 							myStoppedAt = 0;
 						}
 					}
+
+					if (myIsEnabled && myDisableTimeout > 0)
+					{
+						// come back when the disable timeout runs out
+						wait = static_cast<TickType_t>(MS_TO_TICKS((myStoppedAt + myDisableTimeout - currentTime))) + 1;
+					}
 				}
 			}
 		}
@@ -100,104 +213,712 @@ namespace PowerFeed::Drivers
 				// it was previously counting down to a disable, but we're no longer stopped, so reset that.
 				myStoppedAt = 0;
 			}
+
+			auto state = myRamp->GetState();
+			if (state == StepRamp::State::STOPPED)
+			{
+				// the last few steps are playing out of the FIFO, nothing will notify when they are done
+				wait = 1;
+			}
+			else if (state != StepRamp::State::CRUISING && myStream->GetFeed() == PicoStepStream::Feed::DMA)
+			{
+				// the DMA interrupt moves the ramp along without waking the task, poll so the published speed follows it
+				wait = 1;
+			}
 		}
+
+		PrivPublish();
 		taskEXIT_CRITICAL();
+		return startWait < wait ? startWait : wait;
 	}
 
 	void PicoStepper::Stop()
 	{
-		LockGuard<Mutex> lock(myMutex);
-		if (myPIOStepper->GetState() != PIOStepperSpeedController::StepperState::STOPPED &&
-			myPIOStepper->GetState() != PIOStepperSpeedController::StepperState::STOPPING)
+		if (myStartGroup != nullptr)
 		{
-			myPIOStepper->Stop();
+			myStartGroup->Stop();
+			return;
 		}
+		PrivSend(Command::Type::STOP);
 	}
 
 	void PicoStepper::Start()
+	{
+		if (myStartGroup != nullptr)
+		{
+			myStartGroup->Start();
+			return;
+		}
+		PrivSend(Command::Type::START);
+	}
+
+	void PicoStepper::Follow(Fixed aStepsPerRev)
+	{
+		PrivSend(Command::Type::FOLLOW, static_cast<uint32_t>(aStepsPerRev.Raw()));
+	}
+
+	void PicoStepper::MoveTo(int32_t aPosition)
+	{
+		PrivSend(Command::Type::MOVE_TO, static_cast<uint32_t>(aPosition));
+	}
+
+	void PicoStepper::Reciprocate(int32_t aFrom, int32_t aTo)
+	{
+		PrivSend(Command::Type::RECIPROCATE_END, static_cast<uint32_t>(aFrom));
+		PrivSend(Command::Type::RECIPROCATE, static_cast<uint32_t>(aTo));
+	}
+
+	void PicoStepper::PrivSend(Command::Type aType, uint32_t aValue)
+	{
+		Command command = {aType, aValue, time_us_64()};
+		while (!myCommands.Push(command))
+		{
+			// only a burst of commands faster than the higher priority stepper task can drain them gets here
+			vTaskDelay(1);
+		}
+		PrivWake();
+	}
+
+	void PicoStepper::PrivApply(const Command &aCommand)
+	{
+		switch (aCommand.type)
+		{
+		case Command::Type::SET_SPEED:
+			mySpeed = aCommand.value;
+			if (!myFollowing)
+			{
+				taskENTER_CRITICAL();
+				myRamp->SetTargetSpeed(aCommand.value);
+				taskEXIT_CRITICAL();
+			}
+			break;
+		case Command::Type::START:
+			if (aCommand.value == START_IN_SYNC && myStartGroup != nullptr)
+			{
+				myStartInSync = true;
+			}
+			if (!PrivClearEStop())
+			{
+				// still held by the emergency stop, the rest of the group starts without this one
+				PrivLeaveStartGroup();
+				break;
+			}
+			// a new start from the operator clears the alarm, and takes over from a move
+			myStalled = false;
+			PrivEndMove();
+			if (myFollowing)
+			{
+				// back to the set speed
+				myFollowing = false;
+				taskENTER_CRITICAL();
+				myRamp->SetTargetSpeed(mySpeed);
+				taskEXIT_CRITICAL();
+			}
+			PrivStart();
+			break;
+		case Command::Type::STOP:
+			// also calls off a planned reversal, the direction stays as it is
+			PrivEndMove();
+			myReversing = false;
+			myStartPending = false;
+			// do not keep the rest of the group waiting for a start that is not coming
+			PrivLeaveStartGroup();
+			myReversalStartedAtUs = 0;
+			myTargetDirection = myDirection;
+			taskENTER_CRITICAL();
+			myRamp->Stop();
+			if (myFollowing)
+			{
+				// the ramp is stopping so this does not replan it, it is what the next start runs at
+				myFollowing = false;
+				myRamp->SetTargetSpeed(mySpeed);
+			}
+			taskEXIT_CRITICAL();
+			break;
+		case Command::Type::SET_DIRECTION:
+			PrivSetDirection(aCommand.value != 0);
+			break;
+		case Command::Type::FOLLOW:
+			if (mySpindleSync == nullptr || !PrivClearEStop())
+			{
+				break;
+			}
+			PrivEndMove();
+			// a new feed applies from the next spindle count on, the steps owed so far are kept
+			mySpindleSync->SetRatio(Fixed::FromRaw(static_cast<int32_t>(aCommand.value)));
+			if (!myFollowing)
+			{
+				const int32_t position = myCounter->GetPosition();
+				myStalled = false;
+				myFollowing = true;
+				// the direction sent along with the follow, the axis may still be turning around to it
+				myFollowDirection = myTargetDirection;
+				mySpindleSync->Reset(mySpindleEncoder->GetCount(), myFollowDirection ? position : -position);
+				myLastFollowTick = xTaskGetTickCount();
+				myLastFollowUs = time_us_64();
+			}
+			break;
+		case Command::Type::RECIPROCATE_END:
+			myReciprocateEnd = static_cast<int32_t>(aCommand.value);
+			break;
+		case Command::Type::MOVE_TO:
+		case Command::Type::RECIPROCATE:
+			if (!PrivClearEStop())
+			{
+				break;
+			}
+			myStalled = false;
+			if (myFollowing)
+			{
+				myFollowing = false;
+				taskENTER_CRITICAL();
+				myRamp->SetTargetSpeed(mySpeed);
+				taskEXIT_CRITICAL();
+			}
+			if (aCommand.type == Command::Type::RECIPROCATE)
+			{
+				// the first stroke is this move, the reciprocator takes over once it lands
+				myReciprocator->Start(myReciprocateEnd, static_cast<int32_t>(aCommand.value), time_us_64());
+			}
+			else
+			{
+				PrivStopReciprocating();
+			}
+			myMovingTo = true;
+			myMoveTarget = static_cast<int32_t>(aCommand.value);
+			if (myRamp->GetState() == StepRamp::State::STOPPED && myStream->IsIdle())
+			{
+				PrivBeginMove();
+				break;
+			}
+			// a ramp under way may be too close to the target to brake for it, or going the other way, so the move
+			// sets off from wherever the axis comes to rest
+			myMovePending = true;
+			myReversing = false;
+			myStartPending = false;
+			PrivLeaveStartGroup();
+			myReversalStartedAtUs = 0;
+			myTargetDirection = myDirection;
+			taskENTER_CRITICAL();
+			myRamp->Stop();
+			taskEXIT_CRITICAL();
+			break;
+		}
+
+		uint32_t latency = static_cast<uint32_t>(time_us_64() - aCommand.sentAtUs);
+		taskENTER_CRITICAL();
+		myTaskStats.commands++;
+		myTaskStats.lastCommandLatencyUs = latency;
+		if (latency > myTaskStats.maxCommandLatencyUs)
+		{
+			myTaskStats.maxCommandLatencyUs = latency;
+		}
+		taskEXIT_CRITICAL();
+	}
+
+	void PicoStepper::PrivStart()
 	{
 		if (!myIsEnabled)
 		{
 			PrivEnable();
+			// the driver takes the same setup time after being enabled as after a direction change
+			myStartAtUs = time_us_64() + myDirectionDelayUs;
+		}
+
+		if (myReversing || (myRamp->GetState() == StepRamp::State::STOPPED && time_us_64() < myStartAtUs))
+		{
+			// PrivSequence starts it once the ramp down and the setup time are done
+			myStartPending = true;
+			return;
+		}
+
+		PrivStartRamp();
+	}
+
+	void PicoStepper::PrivSetDirection(bool aDirection)
+	{
+		myTargetDirection = aDirection;
+		if (aDirection == myDirection)
+		{
+			// back to the direction it is still moving in before the reversal got to the end of its ramp down
+			myReversing = false;
+			myReversalStartedAtUs = 0;
+			return;
+		}
+
+		if (myRamp->GetState() == StepRamp::State::STOPPED && myStream->IsIdle())
+		{
+			PrivChangeDirection(aDirection);
+			return;
+		}
+
+		// ramp down in the old direction, PrivSequence flips the pin once the last step is out
+		myReversing = true;
+		myReversalStartedAtUs = time_us_64();
+		taskENTER_CRITICAL();
+		myRamp->Stop();
+		taskEXIT_CRITICAL();
+	}
+
+	TickType_t PicoStepper::PrivSequence()
+	{
+		if (myReversing && myRamp->GetState() == StepRamp::State::STOPPED && myStream->IsIdle())
+		{
+			myReversing = false;
+			PrivChangeDirection(myTargetDirection);
+		}
+
+		if (myMovePending && myRamp->GetState() == StepRamp::State::STOPPED && myStream->IsIdle())
+		{
+			myMovePending = false;
+			PrivBeginMove();
+		}
+
+		if (!myStartPending || myReversing)
+		{
+			return portMAX_DELAY;
+		}
+
+		const uint64_t now = time_us_64();
+		if (now < myStartAtUs)
+		{
+			// round up, starting a tick late is fine, starting early is not
+			return static_cast<TickType_t>(MS_TO_TICKS(((myStartAtUs - now + 999) / 1000))) + 1;
+		}
+
+		myStartPending = false;
+		PrivStartRamp();
+		taskENTER_CRITICAL();
+		if (myReversalStartedAtUs != 0)
+		{
+			myTaskStats.reversals++;
+			myTaskStats.lastReversalUs = static_cast<uint32_t>(now - myReversalStartedAtUs);
+		}
+		taskEXIT_CRITICAL();
+		myReversalStartedAtUs = 0;
+		return portMAX_DELAY;
+	}
+
+	void PicoStepper::PrivStartRamp()
+	{
+		taskENTER_CRITICAL();
+		// a ramp that is still moving carries on, it stops on the limit with the new steps left
+		const bool room = PrivUpdateStepsLeft() || myRamp->GetState() != StepRamp::State::STOPPED;
+		taskEXIT_CRITICAL();
+		if (!room)
+		{
+			// on the soft limit, or already at the target
+			PrivLeaveStartGroup();
+			return;
+		}
+
+		// only a start from standstill can be held, a ramp that is still moving has to keep stepping
+		const bool hold = myStartInSync && myRamp->GetState() == StepRamp::State::STOPPED && myStream->IsIdle();
+		if (hold)
+		{
+			myStream->Hold();
+		}
+
+		taskENTER_CRITICAL();
+		myRamp->Start();
+		myStream->Kick();
+		if (hold && myStream->GetFeed() == PicoStepStream::Feed::TASK)
+		{
+			// queue the first steps now, the group may release the state machine before the next update
+			myStream->Service();
+		}
+		taskEXIT_CRITICAL();
+
+		if (myStartInSync)
+		{
+			myStartInSync = false;
+			myStartGroup->PrivReady(hold ? (1u << myStream->GetSm()) : 0);
+		}
+	}
+
+	void PicoStepper::PrivLeaveStartGroup()
+	{
+		if (myStartInSync)
+		{
+			myStartInSync = false;
+			myStartGroup->PrivReady(0);
+		}
+	}
+
+	TickType_t PicoStepper::PrivCheckFollowing()
+	{
+		if (myFollowingError == nullptr)
+		{
+			return portMAX_DELAY;
+		}
+
+		const int32_t steps = myCounter->GetPosition();
+		const int32_t counts = myFeedbackEncoder->GetCount();
+		if (myRamp->GetState() == StepRamp::State::STOPPED && myStream->IsIdle())
+		{
+			// at rest, follow the encoder so a turn of the handwheel is not taken for a stall on the next move
+			myFollowingError->Reset(steps, counts);
+			return portMAX_DELAY;
+		}
+
+		if (!myStalled && myFollowingError->Update(steps, counts))
+		{
+			// a controlled stop, whatever the reason for the lost steps, the motor may still be turning
+			myStalled = true;
+			myFollowing = false;
+			PrivEndMove();
+			myReversing = false;
+			myStartPending = false;
+			PrivLeaveStartGroup();
+			myReversalStartedAtUs = 0;
+			myTargetDirection = myDirection;
+			taskENTER_CRITICAL();
+			myRamp->Stop();
+			myTaskStats.stalls++;
+			taskEXIT_CRITICAL();
+		}
+
+		taskENTER_CRITICAL();
+		myTaskStats.maxFollowingError = myFollowingError->GetMaxError();
+		taskEXIT_CRITICAL();
+
+		// the DMA ring and the FIFO only wake the task when they need it, poll every tick while moving
+		return 1;
+	}
+
+	TickType_t PicoStepper::PrivFollowSpindle()
+	{
+		if (!myFollowing)
+		{
+			return portMAX_DELAY;
+		}
 
-			// TODO figure out a better way to handle this, maybe enabling/disabling should be the layer above? should not be in a section protected by a mutex.
-			// vTaskDelay(pdMS_TO_TICKS(mySettingsManager->Get()->driver.driverDirectionChangeDelayMs));
+		// the task also wakes for the stream and for commands, correct once a tick so the rate window stays even
+		const TickType_t tick = xTaskGetTickCount();
+		if (tick == myLastFollowTick)
+		{
+			return 1;
 		}
+		myLastFollowTick = tick;
+
+		const uint64_t now = time_us_64();
+		const uint32_t interval = static_cast<uint32_t>(now - myLastFollowUs);
+		myLastFollowUs = now;
+
+		const int32_t position = myCounter->GetPosition();
+		const int32_t rate = mySpindleSync->Update(mySpindleEncoder->GetCount(), myFollowDirection ? position : -position);
+		const bool direction = rate >= 0 ? myFollowDirection : !myFollowDirection;
 
-		if (myPIOStepper->GetState() == PIOStepperSpeedController::StepperState::STOPPED ||
-			myPIOStepper->GetState() == PIOStepperSpeedController::StepperState::STOPPING)
+		if (rate == 0)
+		{
+			// within a step of a spindle that has stopped, a start still waiting on the setup time is not needed
+			myStartPending = false;
+			PrivLeaveStartGroup();
+			taskENTER_CRITICAL();
+			myRamp->Stop();
+			taskEXIT_CRITICAL();
+		}
+		else if (direction != myTargetDirection)
 		{
-			myPIOStepper->Start();
+			// the spindle has reversed, the same planned ramp down, setup time and ramp up as a lever reversal
+			PrivSetDirection(direction);
+			PrivStart();
+		}
+		else
+		{
+			const StepRamp::State state = myRamp->GetState();
+			taskENTER_CRITICAL();
+			myRamp->SetTargetSpeed(static_cast<uint32_t>(rate < 0 ? -rate : rate));
+			taskEXIT_CRITICAL();
+			if ((state == StepRamp::State::STOPPED || state == StepRamp::State::STOPPING) && !myStartPending)
+			{
+				PrivStart();
+			}
 		}
+
+		taskENTER_CRITICAL();
+		myTaskStats.maxSyncError = mySpindleSync->GetMaxError();
+		if (interval > myTaskStats.maxSyncIntervalUs)
+		{
+			myTaskStats.maxSyncIntervalUs = interval;
+		}
+		taskEXIT_CRITICAL();
+		return 1;
+	}
+
+	void PicoStepper::PrivChangeDirection(bool aDirection)
+	{
+		// the ramp and the stream are idle, the position stays put while the counting turns around
+		PrivRebase(PrivRampPosition());
+		gpio_put(myDirPin, aDirection);
+		myDirection = aDirection;
+		myStartAtUs = time_us_64() + myDirectionDelayUs;
+	}
+
+	void PicoStepper::PrivPublish()
+	{
+		Status status;
+		status.state = myRamp->GetState();
+		// steps still queued in the FIFO or the DMA ring count as running, the direction must not change under them
+		bool idle = myStream->IsIdle();
+		// following a spindle that stands still counts as running too, the axis is engaged
+		status.running = status.state != StepRamp::State::STOPPED || !idle || myReversing || myStartPending || myFollowing || myMovePending || myReciprocator->IsActive();
+		status.stopping = status.state == StepRamp::State::STOPPING || (status.state == StepRamp::State::STOPPED && !idle);
+		status.stalled = myStalled;
+		status.eStopped = myEStopLatched || myEStopTrips != myEStopsHandled;
+		status.direction = myDirection;
+		status.targetDirection = myTargetDirection;
+		status.currentSpeed = myRamp->GetCurrentSpeed();
+		status.targetSpeed = 0;
+		if (status.state != StepRamp::State::STOPPED && status.state != StepRamp::State::STOPPING)
+		{
+			status.targetSpeed = myRamp->GetTargetSpeed();
+		}
+		myStatus.Write(status);
 	}
 
 	void PicoStepper::PrivUpdateTask(void *pvParameters)
 	{
 		auto stepper = static_cast<PicoStepper *>(pvParameters);
+		stepper->myStream->AttachInterrupts();
+		stepper->myTaskStartedAt = time_us_64();
 		while (true)
 		{
-			stepper->PrivUpdate();
-			portYIELD();
+			uint64_t begin = time_us_64();
+			TickType_t wait = stepper->PrivUpdate();
+
+			taskENTER_CRITICAL();
+			stepper->myTaskStats.wakeups++;
+			stepper->myTaskStats.busyUs += time_us_64() - begin;
+			taskEXIT_CRITICAL();
+
+			// woken by the stream when it needs feeding, by a command, or by the timeout
+			ulTaskNotifyTake(pdTRUE, wait);
+		}
+	}
+
+	void PicoStepper::PrivWake()
+	{
+		if (myTaskHandle != nullptr)
+		{
+			xTaskNotifyGive(myTaskHandle);
+		}
+	}
+
+	bool PicoStepper::GetDirection() { return myStatus.Read().direction; }
+	bool PicoStepper::GetTargetDirection() { return myStatus.Read().targetDirection; }
+	uint32_t PicoStepper::GetTargetSpeed() { return myStatus.Read().targetSpeed; }
+	uint32_t PicoStepper::GetCurrentSpeed() { return myStatus.Read().currentSpeed; }
+
+	void PicoStepper::SetDirection(bool direction)
+	{
+		PrivSend(Command::Type::SET_DIRECTION, direction ? 1 : 0);
+	}
+
+	bool PicoStepper::IsRunning() { return myStatus.Read().running; }
+	bool PicoStepper::IsStopping() { return myStatus.Read().stopping; }
+	bool PicoStepper::IsStalled() { return myStatus.Read().stalled; }
+	bool PicoStepper::IsEStopped() { return myStatus.Read().eStopped; }
+
+	int32_t PicoStepper::GetPosition()
+	{
+		// no lock, the counter is a single word kept up to date by DMA
+		return myCounter->GetPosition();
+	}
+
+	PicoStepStream::Stats PicoStepper::GetStreamStats()
+	{
+		taskENTER_CRITICAL();
+		PicoStepStream::Stats stats = myStream->GetStats();
+		taskEXIT_CRITICAL();
+		return stats;
+	}
+
+	PicoStepper::TaskStats PicoStepper::GetTaskStats()
+	{
+		taskENTER_CRITICAL();
+		TaskStats stats = myTaskStats;
+		stats.elapsedUs = time_us_64() - myTaskStartedAt;
+		taskEXIT_CRITICAL();
+		return stats;
+	}
+
+	// in RAM with the rest of PicoEStop::Trip, which has halted every stream before it gets here
+	void __not_in_flash_func(PicoStepper::PrivEStopFromISR)(uint32_t aTrippedAtUs, BaseType_t *aWoken)
+	{
+		gpio_put(myEnablePin, !myEnableValue);
+		myEStopHaltUs = time_us_32() - aTrippedAtUs;
+		myEStopTrips = myEStopTrips + 1;
+
+		if (aWoken != nullptr && myTaskHandle != nullptr)
+		{
+			vTaskNotifyGiveFromISR(myTaskHandle, aWoken);
 		}
 	}
 
-	bool PicoStepper::GetDirection() { return myDirection; }
-	bool PicoStepper::GetTargetDirection() { return myTargetDirection; }
-	uint32_t PicoStepper::GetTargetSpeed()
+	void PicoStepper::PrivHandleEStop()
 	{
-		uint32_t speed = 0;
-		LockGuard<Mutex> lock(myMutex);
-		auto stepperState = myPIOStepper->GetState();
-		if (stepperState != PIOStepperSpeedController::StepperState::STOPPED &&
-			stepperState != PIOStepperSpeedController::StepperState::STOPPING)
+		const uint32_t trips = myEStopTrips;
+		if (trips == myEStopsHandled)
 		{
-			speed = myPIOStepper->GetTargetFrequency();
+			return;
 		}
-		return speed;
+
+		myEStopsHandled = trips;
+		myEStopLatched = true;
+		myFollowing = false;
+		myMovingTo = false;
+		myMovePending = false;
+		PrivStopReciprocating();
+		myReversing = false;
+		myStartPending = false;
+		myReversalStartedAtUs = 0;
+		myTargetDirection = myDirection;
+		PrivLeaveStartGroup();
+
+		taskENTER_CRITICAL();
+		// the steps still queued were never sent, the step counter has the position the axis stopped at
+		myStream->Abort();
+		myRamp->Halt();
+		PrivRebase(myCounter->GetPosition());
+		myTaskStats.eStops++;
+		myTaskStats.lastEStopHaltUs = myEStopHaltUs;
+		taskEXIT_CRITICAL();
+
+		// again, a start applied between the interrupt and here may have enabled it
+		PrivDisable();
+		myStoppedAt = 0;
 	}
 
-	uint32_t PicoStepper::GetCurrentSpeed()
+	bool PicoStepper::PrivClearEStop()
 	{
-		uint32_t speed = 0;
-		LockGuard<Mutex> lock(myMutex);
-		auto state = myPIOStepper->GetState();
-		if (state != PIOStepperSpeedController::StepperState::STOPPED)
+		if (!myEStopLatched)
+		{
+			return true;
+		}
+		if (myEStop->IsAsserted())
 		{
-			speed = myPIOStepper->GetCurrentFrequency();
+			return false;
 		}
-		return speed;
+		myEStopLatched = false;
+		return true;
 	}
 
-	void PicoStepper::SetDirection(bool direction)
+	void PicoStepper::PrivBeginMove()
+	{
+		taskENTER_CRITICAL();
+		const int32_t position = PrivRampPosition();
+		taskEXIT_CRITICAL();
+		if (position == myMoveTarget)
+		{
+			myMovingTo = false;
+			return;
+		}
+
+		// the counter counts up with the direction pin high
+		PrivSetDirection(myMoveTarget > position);
+		PrivStart();
+	}
+
+	void PicoStepper::PrivEndMove()
 	{
-		LockGuard<Mutex> lock(myMutex);
-		if (myPIOStepper->GetState() != PIOStepperSpeedController::StepperState::STOPPED)
+		// also between strokes, when there is no move to end
+		PrivStopReciprocating();
+		if (!myMovingTo)
 		{
-			Panic("PicoStepper::SetDirection: Stepper is running, cannot change direction\n");
 			return;
 		}
+		myMovingTo = false;
+		myMovePending = false;
+		taskENTER_CRITICAL();
+		PrivUpdateStepsLeft();
+		taskEXIT_CRITICAL();
+	}
+
+	TickType_t PicoStepper::PrivReciprocate()
+	{
+		if (!myReciprocator->IsActive())
+		{
+			return portMAX_DELAY;
+		}
 
-		myTargetDirection = direction;
-		gpio_put(myDirPin, direction);
-		myDirection = direction;
-		// TODO implement this at the layer above just before Start occurs
-		//  vTaskDelay(pdMS_TO_TICKS(mySettingsManager->Get()->driver.driverDirectionChangeDelayMs));
+		const uint64_t now = time_us_64();
+		taskENTER_CRITICAL();
+		const int32_t position = PrivRampPosition();
+		taskEXIT_CRITICAL();
+		// the move is over once the last step is out and the idle check has let go of it
+		if (myReciprocator->Update(now, !myMovingTo, position))
+		{
+			myMovingTo = true;
+			myMoveTarget = myReciprocator->GetTarget();
+			PrivBeginMove();
+		}
+		if (myCrossFeed)
+		{
+			gpio_put(myCrossFeedPin, myReciprocator->IsCrossFeedOn(now));
+		}
+
+		taskENTER_CRITICAL();
+		myTaskStats.strokes = myReciprocator->GetStrokes();
+		myTaskStats.strokesPerMinuteTenths = myReciprocator->GetStrokesPerMinuteTenths();
+		taskEXIT_CRITICAL();
+
+		if (myReciprocator->GetPhase() == Reciprocator::Phase::MOVING)
+		{
+			// nothing notifies when the last step is out, poll for the landing, which also ends the pulse in time
+			return 1;
+		}
+		const uint64_t wakeAt = myReciprocator->GetWakeAtUs(now);
+		if (wakeAt == 0)
+		{
+			return portMAX_DELAY;
+		}
+		// round up, the dwell may be a tick long but never short
+		return static_cast<TickType_t>(MS_TO_TICKS(((wakeAt - now + 999) / 1000))) + 1;
+	}
+
+	void PicoStepper::PrivStopReciprocating()
+	{
+		myReciprocator->Stop();
+		if (myCrossFeed)
+		{
+			gpio_put(myCrossFeedPin, false);
+		}
+	}
+
+	bool PicoStepper::PrivUpdateStepsLeft()
+	{
+		if (!myLimited && !myMovingTo)
+		{
+			myRamp->ClearStepsLeft();
+			return true;
+		}
+
+		const int64_t position = PrivRampPosition();
+		int64_t left = INT64_MAX;
+		if (myLimited)
+		{
+			left = myDirection ? myMaxPosition - position : position - myMinPosition;
+		}
+		if (myMovingTo)
+		{
+			left = std::min<int64_t>(left, myDirection ? myMoveTarget - position : position - myMoveTarget);
+		}
+		left = std::clamp<int64_t>(left, 0, UINT32_MAX);
+		myRamp->SetStepsLeft(static_cast<uint32_t>(left));
+		return left > 0;
 	}
 
-	bool PicoStepper::IsRunning()
+	int32_t PicoStepper::PrivRampPosition() const
 	{
-		bool running = false;
-		LockGuard<Mutex> lock(myMutex);
-		running = myPIOStepper->GetState() != PIOStepperSpeedController::StepperState::STOPPED;
-		return running;
+		const int32_t steps = static_cast<int32_t>(myRamp->GetStepCount() - myRampBaseSteps);
+		return myDirection ? myRampBase + steps : myRampBase - steps;
 	}
 
-	bool PicoStepper::IsStopping()
+	void PicoStepper::PrivRebase(int32_t aPosition)
 	{
-		bool stopping = false;
-		LockGuard<Mutex> lock(myMutex);
-		stopping = myPIOStepper->GetState() == PIOStepperSpeedController::StepperState::STOPPING;
-		return stopping;
+		myRampBase = aPosition;
+		myRampBaseSteps = myRamp->GetStepCount();
 	}
 
 	void PicoStepper::PrivEnable()
@@ -213,4 +934,4 @@ namespace PowerFeed::Drivers
 				 !myEnableValue);
 		myIsEnabled = false;
 	}
-}
\ No newline at end of file
+}
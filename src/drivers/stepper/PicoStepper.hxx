@@ -1,25 +1,79 @@
 #pragma once
 #include "Common.hxx"
+#include "FollowingError.hxx"
 #include "FreeRTOS.h"
+#include "PicoStepCounter.hxx"
+#include "PicoStartGroup.hxx"
+#include "PicoStepStream.hxx"
+#include "Reciprocator.hxx"
+#include "SeqLock.hxx"
 #include "Settings.hxx"
+#include "SpindleSync.hxx"
+#include "SpscQueue.hxx"
+#include "StepRamp.hxx"
+#include "drivers/PicoQuadratureEncoder.hxx"
 #include "Stepper.hxx"
 #include "hardware/clocks.h"
 #include "hardware/pio.h"
 #include "task.h"
-#include <Mutex.hxx>
-#include <PIOStepperSpeedController/PIOStepper.hxx>
-#include <PIOStepperSpeedController/Stepper.hxx>
 #include <semphr.h>
 #include <stdint.h>
 #include <time.h>
 
 namespace PowerFeed::Drivers
 {
+	class PicoEStop;
 
+	/**
+	@brief Stepper driven by a PIO step generator. The ramp, stream and driver pins are only touched by the
+	stepper task. Commands reach it through a lock free queue and the state is read back from a snapshot that
+	the task publishes, so callers never wait on the task and the task never waits on them.
+	A direction change while running is planned: ramp down, hold the direction for the driver's setup time, then
+	start again if a start was asked for. The setup time is a timed wait of the task, never a delay in a command.
+	The axis the spindle encoder is configured for can follow the spindle instead of running at a set speed, the
+	task then reads the spindle every tick and steers the ramp at the rate that keeps it in phase.
+	The task keeps the position the ramp has stepped to, the counter's position plus the steps still queued, and
+	gives the ramp the steps left to a soft limit or to a MoveTo target so that it brakes in time to stop on it.
+	Reciprocating is a MoveTo to one end after the other, timed by the task so the dwell and the cross feed pulse
+	are as exact as its tick.
+	An emergency stop does not go through the queue, PicoEStop halts the step generator and disables the driver
+	straight from its interrupt and the task cleans up after it. */
 	class PicoStepper : public StepperBase<PicoStepper>
 	{
+		friend class PicoStartGroup;
+		friend class PicoEStop;
+
 	public:
-		PicoStepper(SettingsManager *aSettings, Time *aTime, PIO pio, uint sm);
+		struct TaskStats
+		{
+			uint32_t wakeups;
+			// time spent in PrivUpdate, divide by elapsedUs for the CPU load of the stepper task
+			uint64_t busyUs;
+			uint64_t elapsedUs;
+			uint32_t commands;
+			// from a command being sent to the stepper task applying it
+			uint32_t lastCommandLatencyUs;
+			uint32_t maxCommandLatencyUs;
+			uint32_t reversals;
+			// from a direction change being asked for while running to the ramp starting the other way
+			uint32_t lastReversalUs;
+			// stops because the feedback encoder fell too far behind the steps, and the worst following error seen
+			uint32_t stalls;
+			uint32_t maxFollowingError;
+			// steps behind (or ahead of) the spindle while following it, and the longest gap between corrections
+			uint32_t maxSyncError;
+			uint32_t maxSyncIntervalUs;
+			// emergency stops, and the time from entering the interrupt to the step output being halted for the last one
+			uint32_t eStops;
+			uint32_t lastEStopHaltUs;
+			// strokes since reciprocating was started, and how many a minute in tenths with the dwells
+			uint32_t strokes;
+			uint32_t strokesPerMinuteTenths;
+		};
+
+		/**
+		@brief Stepper for axis anAxis of the settings, on the PIO block the axis is configured for */
+		PicoStepper(SettingsManager *aSettings, Time *aTime, uint8_t anAxis);
 		~PicoStepper();
 
 		void SetDirection(bool direction);
@@ -30,17 +84,166 @@ namespace PowerFeed::Drivers
 		uint32_t GetCurrentSpeed();
 		void Start();
 		void Stop();
+		void Follow(Fixed aStepsPerRev);
+		void MoveTo(int32_t aPosition);
+		void Reciprocate(int32_t aFrom, int32_t aTo);
 		bool IsRunning();
 		bool IsStopping();
+		bool IsStalled();
+		bool IsEStopped();
+		int32_t GetPosition();
+
+		PicoStepStream::Stats GetStreamStats();
+		TaskStats GetTaskStats();
 
 	private:
-		void PrivUpdate();
+		struct Command
+		{
+			enum class Type : uint8_t
+			{
+				SET_SPEED,
+				START,
+				STOP,
+				SET_DIRECTION,
+				FOLLOW,
+				MOVE_TO,
+				// the end a RECIPROCATE comes back to, sent just before it
+				RECIPROCATE_END,
+				RECIPROCATE
+			};
+
+			Type type;
+			uint32_t value;
+			uint64_t sentAtUs;
+		};
+
+		struct Status
+		{
+			StepRamp::State state;
+			bool running;
+			bool stopping;
+			bool stalled;
+			bool eStopped;
+			bool direction;
+			bool targetDirection;
+			uint32_t currentSpeed;
+			uint32_t targetSpeed;
+		};
+
+		static constexpr size_t COMMAND_QUEUE_DEPTH = 16;
+		// START value that has the stepper hold its first steps for its start group
+		static constexpr uint32_t START_IN_SYNC = 1;
+
+		/**
+		@brief Feed the stream if it needs it and handle the disable timeout
+		@return ticks to block for before the next update, unless a notification arrives first */
+		TickType_t PrivUpdate();
 		static void PrivUpdateTask(void *pvParameters);
+		void PrivWake();
+		/**
+		@brief Queue a command for the task, only from a UI holding the display mutex, which keeps myCommands to one
+		producer */
+		void PrivSend(Command::Type aType, uint32_t aValue = 0);
+		void PrivApply(const Command &aCommand);
+		void PrivPublish();
+		void PrivStart();
+		void PrivSetDirection(bool aDirection);
+		void PrivChangeDirection(bool aDirection);
+		/**
+		@brief Carry a planned reversal or a held back start on
+		@return ticks until the start is due, portMAX_DELAY if nothing is waiting */
+		TickType_t PrivSequence();
+		/**
+		@brief Start the ramp and the stream, held for the start group if the start came from one */
+		void PrivStartRamp();
+		/**
+		@brief Tell the start group this stepper is not holding a start for it, if it was asked to */
+		void PrivLeaveStartGroup();
+		/**
+		@brief Compare the steps sent with the feedback encoder and stop if the motor has fallen behind
+		@return ticks until it wants to check again, portMAX_DELAY while at rest */
+		TickType_t PrivCheckFollowing();
+		/**
+		@brief Once a tick while following the spindle, steer the ramp towards the spindle's position
+		@return ticks until the next correction, portMAX_DELAY when not following */
+		TickType_t PrivFollowSpindle();
+		/**
+		@brief Disable the driver, from the emergency stop interrupt once it has halted the step output
+		@param aWoken nullptr to leave the task to find it on its next update, as before the scheduler runs */
+		void PrivEStopFromISR(uint32_t aTrippedAtUs, BaseType_t *aWoken);
+		/**
+		@brief Clean up after an emergency stop the interrupt has halted the step output for */
+		void PrivHandleEStop();
+		/**
+		@return false while an emergency stop is latched and the input still asserted, a start is refused then */
+		bool PrivClearEStop();
+		/**
+		@brief Set off towards myMoveTarget from standstill */
+		void PrivBeginMove();
+		/**
+		@brief Call off a move, the ramp is left with the steps to the soft limit */
+		void PrivEndMove();
+		/**
+		@brief Set off on the next stroke once the last one has landed and dwelt, and time the cross feed pulse
+		@return ticks until the dwell or the pulse ends, 1 while a stroke is under way, portMAX_DELAY when idle */
+		TickType_t PrivReciprocate();
+		/**
+		@brief End the reciprocating, the stroke under way is ended by the caller */
+		void PrivStopReciprocating();
+		/**
+		@brief Give the ramp the steps to the nearer of the soft limit and the move target ahead, in a critical section
+		@return false if there is no room to move in the current direction */
+		bool PrivUpdateStepsLeft();
+		/**
+		@brief Step position the ramp has got to, including the steps still queued, in a critical section */
+		int32_t PrivRampPosition() const;
+		/**
+		@brief Count the ramp position on from aPosition, only while the ramp and the stream are idle */
+		void PrivRebase(int32_t aPosition);
 		void PrivEnable();
 		void PrivDisable();
 
 		SettingsManager *mySettingsManager;
-		PIOStepperSpeedController::PIOStepper *myPIOStepper;
+		StepRamp *myRamp;
+		PicoStepStream *myStream;
+		PicoStepCounter *myCounter;
+		// both nullptr without a feedback encoder
+		PicoQuadratureEncoder *myFeedbackEncoder = nullptr;
+		FollowingError *myFollowingError = nullptr;
+		bool myStalled = false;
+		// nullptr without an emergency stop input
+		PicoEStop *myEStop = nullptr;
+		// counted by the interrupt, the task has dealt with the emergency stops up to myEStopsHandled
+		volatile uint32_t myEStopTrips = 0;
+		uint32_t myEStopsHandled = 0;
+		volatile uint32_t myEStopHaltUs = 0;
+		// until the input is released and the axis is started again
+		bool myEStopLatched = false;
+		// both nullptr unless this is the axis the spindle encoder is configured for
+		PicoQuadratureEncoder *mySpindleEncoder = nullptr;
+		SpindleSync *mySpindleSync = nullptr;
+		bool myFollowing = false;
+		// direction the axis moves in while the spindle turns forward
+		bool myFollowDirection = false;
+		TickType_t myLastFollowTick = 0;
+		uint64_t myLastFollowUs = 0;
+		// soft limits in step positions, counted from the position at power up
+		bool myLimited = false;
+		int32_t myMinPosition = 0;
+		int32_t myMaxPosition = 0;
+		// moving to myMoveTarget, pending while the axis comes to rest to set off from there
+		bool myMovingTo = false;
+		bool myMovePending = false;
+		int32_t myMoveTarget = 0;
+		Reciprocator *myReciprocator;
+		int32_t myReciprocateEnd = 0;
+		bool myCrossFeed = false;
+		uint myCrossFeedPin = 0;
+		// the ramp position is myRampBase plus the steps the ramp has produced since myRampBaseSteps, in myDirection
+		int32_t myRampBase = 0;
+		uint32_t myRampBaseSteps = 0;
+		// from SET_SPEED, what a start runs at once the axis stops following
+		uint32_t mySpeed = 0;
 		Time *myTime;
 		uint64_t myStoppedAt;
 		bool myDirection;
@@ -50,8 +253,23 @@ namespace PowerFeed::Drivers
 		uint myEnablePin;
 		uint myDirPin;
 		uint16_t myDisableTimeout;
+		// the driver needs this long between a direction (or enable) change and the next step
+		uint32_t myDirectionDelayUs;
+		// ramping down to change direction
+		bool myReversing = false;
+		// a start that waits for the reversal or the direction setup time
+		bool myStartPending = false;
+		uint64_t myStartAtUs = 0;
+		uint64_t myReversalStartedAtUs = 0;
+		PicoStartGroup *myStartGroup = nullptr;
+		// the start group is waiting for this stepper to queue its first steps
+		bool myStartInSync = false;
 		TaskHandle_t myTaskHandle;
-		Mutex myMutex;
+		// the UIs are the only producer, one at a time under the display mutex they all share
+		SpscQueue<Command, COMMAND_QUEUE_DEPTH> myCommands;
+		SeqLock<Status> myStatus;
+		TaskStats myTaskStats = {};
+		uint64_t myTaskStartedAt = 0;
 	};
 
 	static_assert(PowerFeed::StepperImpl<PicoStepper>,
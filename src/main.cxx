@@ -24,17 +24,27 @@ extern "C"
 #include "config.h"
 #include "drivers/display/ConsoleDisplay.hxx"
 #include "drivers/display/SSD1306Display.hxx"
+#include "drivers/PicoEStop.hxx"
+#include "drivers/stepper/PicoStartGroup.hxx"
 #include "drivers/stepper/PicoStepper.hxx"
+#ifdef STEP_TIMING_DIAGNOSTICS
+#include "StepTiming.hxx"
+#include "drivers/stepper/PicoStepTimer.hxx"
+#endif
 
 using namespace PowerFeed;
 using namespace PowerFeed::Drivers;
 
 SettingsManager *settingsManager;
-PicoStepper *stepper;
 PowerFeed::Time *iTime;
-UI<PicoStepper> *uiState;
-Drivers::Switches<PicoStepper> *switches;
+// one of each per axis
+PicoStepper *steppers[Settings::MAX_AXES];
+UI<PicoStepper> *uiStates[Settings::MAX_AXES];
+Drivers::Switches<PicoStepper> *switches[Settings::MAX_AXES];
 Display *display;
+// every UI draws on the one display
+Mutex *displayMutex;
+PicoEStop *eStop;
 
 // Forward declaration of the HardFault_Handler
 extern "C" void isr_hardfault(void);
@@ -80,6 +90,72 @@ extern "C" void __attribute__((naked)) isr_hardfault(void)
 using namespace PowerFeed;
 using namespace PowerFeed::Drivers;
 
+#ifdef STEP_TIMING_DIAGNOSTICS
+PicoStepTimer *stepTimer;
+
+void PrintHistogram(const char *aName, const StepTiming::Histogram &aHistogram)
+{
+	printf("  %s, max %u ns\n", aName, static_cast<unsigned>(aHistogram.maxNs));
+	for (uint8_t bin = 0; bin < StepTiming::BINS; bin++)
+	{
+		if (aHistogram.counts[bin] == 0)
+		{
+			continue;
+		}
+		if (bin == StepTiming::BINS - 1)
+		{
+			printf("    >= %6u ns %5u\n", static_cast<unsigned>(StepTiming::BinLimitNs(bin - 1)), static_cast<unsigned>(aHistogram.counts[bin]));
+		}
+		else
+		{
+			printf("    <  %6u ns %5u\n", static_cast<unsigned>(StepTiming::BinLimitNs(bin)), static_cast<unsigned>(aHistogram.counts[bin]));
+		}
+	}
+}
+
+// Captures the steps of the first axis whenever it cruises and prints how far they are from the commanded rate.
+// Runs on core 0 at the lowest priority so it does not disturb what it measures, apart from the printing.
+void StepTimingTask(void *)
+{
+	StepTiming timing(clock_get_hz(clk_sys));
+	PicoStepper *stepper = steppers[0];
+
+	while (true)
+	{
+		vTaskDelay(pdMS_TO_TICKS(2000));
+		const uint32_t speed = stepper->GetTargetSpeed();
+		if (!stepper->IsRunning() || stepper->GetCurrentSpeed() != speed)
+		{
+			continue;
+		}
+
+		const PicoStepStream::Stats streamBefore = stepper->GetStreamStats();
+		stepTimer->Start();
+		// a capture at the slowest rates takes minutes, report what came in by then
+		for (uint32_t waited = 0; !stepTimer->IsDone() && waited < 5000; waited += 10)
+		{
+			vTaskDelay(pdMS_TO_TICKS(10));
+		}
+		stepTimer->Cancel();
+		const PicoStepStream::Stats streamAfter = stepper->GetStreamStats();
+
+		if (stepper->GetTargetSpeed() != speed || stepTimer->GetCaptured() < 2)
+		{
+			// the rate changed under the capture
+			continue;
+		}
+
+		timing.Reset(speed);
+		stepTimer->Analyze(timing);
+		printf("Step timing: %u steps/s, %u periods, rate error %d ppm, %u refills\n",
+			   static_cast<unsigned>(speed), static_cast<unsigned>(timing.GetSamples()),
+			   static_cast<int>(timing.GetRateErrorPpm()), static_cast<unsigned>(streamAfter.refills - streamBefore.refills));
+		PrintHistogram("period error", timing.GetError());
+		PrintHistogram("jitter", timing.GetJitter());
+	}
+}
+#endif
+
 int main()
 {
 	// board_init(); //todo TINYUSB
@@ -108,22 +184,64 @@ int main()
 		display = new ConsoleDisplay(settingsManager);
 	}
 
+	displayMutex = new Mutex();
 	display->DrawStart();
 	display->WriteBuffer();
 	sleep_ms(500);
 
-	stepper = new PicoStepper(settingsManager, iTime, pio0, 0);
+	for (uint8_t axis = 0; axis < settings->axes.size(); axis++)
+	{
+		steppers[axis] = new PicoStepper(settingsManager, iTime, axis);
+
+		uiStates[axis] = new UI<PicoStepper>(
+			settingsManager,
+			display,
+			displayMutex,
+			steppers[axis],
+			10,
+			settings->axes[axis].mechanical.maxDriverStepsPerSecond,
+			axis);
+
+		// todo: load saved units and speed from eeprom
 
-	uiState = new UI<PicoStepper>(
-		settingsManager,
-		display,
-		stepper,
-		10,
-		settingsManager->Get()->mechanical.maxDriverStepsPerSecond);
+		switches[axis] = new Switches<PicoStepper>(settingsManager, uiStates[axis]);
+	}
 
-	// todo: load saved units and speed from eeprom
+	// a group for each DRIVER_START_GROUP in use, the settings have checked its axes share a PIO
+	PicoStartGroup *startGroups[Settings::MAX_AXES] = {};
+	for (uint8_t axis = 0; axis < settings->axes.size(); axis++)
+	{
+		const Settings::Driver &driver = settings->axes[axis].driver;
+		if (driver.driverStartGroup == 0)
+		{
+			continue;
+		}
+		// kept with the first axis of the group
+		uint8_t first = 0;
+		while (settings->axes[first].driver.driverStartGroup != driver.driverStartGroup)
+		{
+			first++;
+		}
+		if (startGroups[first] == nullptr)
+		{
+			startGroups[first] = new PicoStartGroup(pio_get_instance(driver.driverPio));
+		}
+		startGroups[first]->Add(steppers[axis]);
+	}
+
+	if (settings->eStop.enabled)
+	{
+		// from main, so its interrupt is on core 0 and not held up by the stepper core
+		eStop = new PicoEStop(settings->eStop, steppers, settings->axes.size());
+	}
 
-	switches = new Switches<PicoStepper>(settingsManager, uiState);
+#ifdef STEP_TIMING_DIAGNOSTICS
+	const Settings::Driver &timedDriver = settings->axes[0].driver;
+	stepTimer = new PicoStepTimer(pio_get_instance(timedDriver.driverPio), timedDriver.driverStepPin);
+	TaskHandle_t timingTask;
+	xTaskCreate(StepTimingTask, "StepTiming", 2048, nullptr, tskIDLE_PRIORITY + 1, &timingTask);
+	vTaskCoreAffinitySet(timingTask, 1 << 0);
+#endif
 
 	printf("Started Subsystems\n");
 
@@ -27,7 +27,10 @@ namespace PowerFeed
 		MOCK_METHOD(void, DrawStopped, (), (override));
 		MOCK_METHOD(void, DrawRapidLeft, (), (override));
 		MOCK_METHOD(void, DrawRapidRight, (), (override));
+		MOCK_METHOD(void, DrawStalled, (), (override));
+		MOCK_METHOD(void, DrawEStopped, (), (override));
 		MOCK_METHOD(void, DrawSpeed, (uint32_t aSpeed), (override));
+		MOCK_METHOD(void, DrawFeedPerRev, (uint32_t aStepsPerRev), (override));
 		MOCK_METHOD(void, ToggleUnits, (), (override));
 		MOCK_METHOD(void, WriteBuffer, (), (override));
 		MOCK_METHOD(void, Refresh, (), (override));
@@ -20,9 +20,15 @@ namespace PowerFeed
 			MOCK_METHOD(void, Stop, (), ());
 			MOCK_METHOD(void, Start, (), ());
 			MOCK_METHOD(void, SetSpeed, (uint32_t speed), ());
+			MOCK_METHOD(void, Follow, (Fixed aStepsPerRev), ());
+			MOCK_METHOD(void, MoveTo, (int32_t aPosition), ());
+			MOCK_METHOD(void, Reciprocate, (int32_t aFrom, int32_t aTo), ());
 			MOCK_METHOD(void, Init, (), ());
 			MOCK_METHOD(uint32_t, GetCurrentSpeed, (), ());
 			MOCK_METHOD(bool, IsRunning, (), ());
+			MOCK_METHOD(bool, IsStalled, (), ());
+			MOCK_METHOD(bool, IsEStopped, (), ());
+			MOCK_METHOD(int32_t, GetPosition, (), ());
 			MOCK_METHOD(bool, Update, (), ());
 		};
 
@@ -0,0 +1,68 @@
+// Host benchmark of the time a rapid takes to get up to speed, flat ACCELERATION against an ACCELERATION_CURVE.
+// The ramp runs at the 125MHz step generator tick, the times are what the axis would take, not host time.
+#include "../src/Settings.hxx"
+#include "../src/StepRamp.hxx"
+#include <chrono>
+#include <cstdio>
+
+using PowerFeed::AccelerationCurve;
+using PowerFeed::StepRamp;
+
+namespace
+{
+	constexpr uint32_t TICK_HZ = 125000000;
+
+	struct Run
+	{
+		double seconds;
+		uint32_t steps;
+	};
+
+	Run ToSpeed(StepRamp &aRamp, uint32_t aSpeed)
+	{
+		aRamp.SetTargetSpeed(aSpeed);
+		aRamp.Start();
+
+		uint64_t elapsed = 0;
+		uint32_t steps = 0;
+		while (aRamp.GetState() == StepRamp::State::ACCELERATING)
+		{
+			elapsed += aRamp.NextPeriod();
+			steps++;
+		}
+		return {static_cast<double>(elapsed) / TICK_HZ, steps};
+	}
+}
+
+int main()
+{
+	PowerFeed::SettingsManager settings;
+	const PowerFeed::Settings::Mechanical &mech = settings.Get()->axes[0].mechanical;
+	const uint32_t rapid = mech.maxStepsPerSecond;
+	const uint32_t flat = mech.acceleration;
+
+	// the shape of a typical hybrid stepper pull-out curve, torque falling off with speed. Flat ACCELERATION has to
+	// be the rate at the top, the curve starts at three and two times that
+	const AccelerationCurve curves[] = {
+		{{0, 3 * flat}, {rapid / 2, 2 * flat}, {rapid, flat}},
+		{{0, 2 * flat}, {rapid, flat}},
+	};
+	const char *names[] = {"3x falling to 1x", "2x falling to 1x"};
+
+	StepRamp flatRamp(TICK_HZ, rapid, flat, mech.deceleration, mech.accelerationJerk, mech.rampTableSegments);
+	const Run flatRun = ToSpeed(flatRamp, rapid);
+	printf("0 to %u steps/s, flat %u steps/s^2: %7.1f ms %6u steps\n", rapid, flat, flatRun.seconds * 1000, flatRun.steps);
+
+	for (size_t i = 0; i < sizeof(curves) / sizeof(curves[0]); i++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		StepRamp curveRamp(TICK_HZ, rapid, flat, mech.deceleration, mech.accelerationJerk, mech.rampTableSegments, 0, curves[i]);
+		auto built = std::chrono::steady_clock::now();
+
+		const Run curveRun = ToSpeed(curveRamp, rapid);
+		printf("0 to %u steps/s, curve %s: %7.1f ms %6u steps, %.0f%% of the flat time, table built in %.0f us\n",
+			   rapid, names[i], curveRun.seconds * 1000, curveRun.steps, 100 * curveRun.seconds / flatRun.seconds,
+			   std::chrono::duration<double, std::micro>(built - start).count());
+	}
+	return 0;
+}
@@ -0,0 +1,52 @@
+// Host benchmark of the feed rate conversion and formatting done on every display redraw, float against fixed point.
+// The host has an FPU so the gap here is smaller than on the M0+, where every float operation is a library call.
+#include "../src/Settings.hxx"
+#include <chrono>
+#include <cstdio>
+
+namespace
+{
+	constexpr uint32_t ITERATIONS = 2000000;
+	constexpr uint32_t MAX_STEPS = 800000;
+
+	template <typename Function>
+	double NanosecondsPerCall(Function aFunction)
+	{
+		auto start = std::chrono::steady_clock::now();
+		for (uint32_t i = 0; i < ITERATIONS; i++)
+		{
+			aFunction(i % MAX_STEPS);
+		}
+		auto end = std::chrono::steady_clock::now();
+		return std::chrono::duration<double, std::nano>(end - start).count() / ITERATIONS;
+	}
+}
+
+int main()
+{
+	PowerFeed::SettingsManager settings;
+	const PowerFeed::Settings::Mechanical &mech = settings.Get()->axes[0].mechanical;
+	const float stepsPerMm = static_cast<float>(mech.stepsPerMm.ToDouble());
+	const float inchPerMm = 1.0f / 25.4f;
+
+	volatile float floatSink = 0;
+	volatile uint32_t fixedSink = 0;
+	char text[14];
+
+	double floatMath = NanosecondsPerCall([&](uint32_t aSteps)
+										  { floatSink = (static_cast<float>(aSteps) / stepsPerMm) * 60.0f * inchPerMm; });
+	double fixedMath = NanosecondsPerCall([&](uint32_t aSteps)
+										  { fixedSink = mech.StepsToTenths(aSteps, true); });
+
+	double floatFormat = NanosecondsPerCall([&](uint32_t aSteps)
+											{ snprintf(text, sizeof(text), "%.1f %s", (static_cast<float>(aSteps) / stepsPerMm) * 60.0f, "mm "); });
+	double fixedFormat = NanosecondsPerCall([&](uint32_t aSteps)
+											{
+												uint32_t tenths = mech.StepsToTenths(aSteps, false);
+												snprintf(text, sizeof(text), "%u.%u %s", static_cast<unsigned>(tenths / 10), static_cast<unsigned>(tenths % 10), "mm ");
+											});
+
+	printf("conversion         float %6.2f ns  fixed %6.2f ns\n", floatMath, fixedMath);
+	printf("conversion+format  float %6.2f ns  fixed %6.2f ns\n", floatFormat, fixedFormat);
+	return 0;
+}
@@ -0,0 +1,149 @@
+#include "../src/Debouncer.hxx"
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <random>
+
+namespace PowerFeed
+{
+	namespace
+	{
+		// 10 samples of 1ms, DEBOUNCE_DELAY_US of the default config, on the pins of the default levers and button
+		constexpr uint32_t SAMPLES = 10;
+		constexpr uint32_t LEFT = 1u << 8;
+		constexpr uint32_t RIGHT = 1u << 7;
+		constexpr uint32_t RAPID = 1u << 9;
+		constexpr uint32_t BUTTON = 1u << 12;
+		constexpr uint32_t MASK = LEFT | RIGHT | RAPID | BUTTON;
+	}
+
+	TEST(DebouncerTest, CleanChangeAfterTheSamples)
+	{
+		Debouncer debouncer(MASK, SAMPLES, MASK);
+		for (uint32_t i = 0; i + 1 < SAMPLES; i++)
+		{
+			EXPECT_EQ(debouncer.Sample(MASK & ~LEFT), 0u);
+		}
+		EXPECT_EQ(debouncer.Sample(MASK & ~LEFT), LEFT);
+		EXPECT_EQ(debouncer.GetLevels(), MASK & ~LEFT);
+		EXPECT_EQ(debouncer.Sample(MASK & ~LEFT), 0u);
+	}
+
+	TEST(DebouncerTest, IgnoresPinsOutsideTheMask)
+	{
+		Debouncer debouncer(MASK, SAMPLES, 0);
+		for (uint32_t i = 0; i < 100; i++)
+		{
+			EXPECT_EQ(debouncer.Sample(~MASK), 0u);
+		}
+		EXPECT_EQ(debouncer.GetLevels(), 0u);
+	}
+
+	TEST(DebouncerTest, AddedInputsKeepTheirOwnSamples)
+	{
+		// the levers of one axis at 10 samples and limit switches added later at 3, starting high
+		constexpr uint32_t LIMIT = 1u << 20;
+		Debouncer debouncer(MASK, SAMPLES, MASK);
+		debouncer.Add(LIMIT, 3, LIMIT);
+		EXPECT_EQ(debouncer.GetMask(), MASK | LIMIT);
+		EXPECT_EQ(debouncer.GetLevels(), MASK | LIMIT);
+
+		uint32_t changedAt[2] = {};
+		for (uint32_t i = 1; i <= SAMPLES; i++)
+		{
+			const uint32_t changed = debouncer.Sample(MASK & ~(LEFT | LIMIT));
+			changedAt[0] = (changed & LIMIT) != 0 ? i : changedAt[0];
+			changedAt[1] = (changed & LEFT) != 0 ? i : changedAt[1];
+		}
+		EXPECT_EQ(changedAt[0], 3u);
+		EXPECT_EQ(changedAt[1], SAMPLES);
+	}
+
+	TEST(DebouncerTest, GlitchesShorterThanTheSamplesNeverGetThrough)
+	{
+		Debouncer debouncer(MASK, SAMPLES, MASK);
+		for (uint32_t glitch = 1; glitch < SAMPLES; glitch++)
+		{
+			for (uint32_t i = 0; i < glitch; i++)
+			{
+				EXPECT_EQ(debouncer.Sample(0), 0u);
+			}
+			for (uint32_t i = 0; i < SAMPLES; i++)
+			{
+				EXPECT_EQ(debouncer.Sample(MASK), 0u);
+			}
+		}
+	}
+
+	TEST(DebouncerTest, BounceStormGivesOneChangePerPress)
+	{
+		// every input bounces at random for up to 8ms on each of 2000 presses and releases, the change has to come
+		// out once and within the samples of the contact settling
+		std::mt19937 random(20240517);
+		std::uniform_int_distribution<uint32_t> bounceLength(0, SAMPLES - 2);
+		std::bernoulli_distribution coin(0.5);
+
+		Debouncer debouncer(MASK, SAMPLES, MASK);
+		uint32_t level = MASK;
+		uint32_t changes = 0;
+		uint32_t samples = 0;
+		uint32_t maxPerSample = 0;
+		for (uint32_t press = 0; press < 2000; press++)
+		{
+			const uint32_t target = level ^ MASK;
+			const uint32_t bounce = bounceLength(random);
+			uint32_t seen = 0;
+			for (uint32_t i = 0; i < bounce; i++)
+			{
+				uint32_t noisy = 0;
+				for (uint32_t pin : {LEFT, RIGHT, RAPID, BUTTON})
+				{
+					noisy |= coin(random) ? pin : 0;
+				}
+				const uint32_t changed = debouncer.Sample(noisy);
+				seen |= changed;
+				maxPerSample = std::max<uint32_t>(maxPerSample, __builtin_popcount(changed));
+				changes += __builtin_popcount(changed);
+				samples++;
+			}
+			// settled, held long enough to be a press
+			for (uint32_t i = 0; i < SAMPLES * 3; i++)
+			{
+				const uint32_t changed = debouncer.Sample(target);
+				EXPECT_EQ(changed & seen, 0u) << "press " << press << " changed twice";
+				seen |= changed;
+				changes += __builtin_popcount(changed);
+				samples++;
+				if (i == SAMPLES - 1)
+				{
+					ASSERT_EQ(debouncer.GetLevels(), target) << "press " << press;
+				}
+			}
+			ASSERT_EQ(seen, MASK) << "press " << press;
+			level = target;
+		}
+
+		// exactly one change per input per press, never more than one per input per sample
+		EXPECT_EQ(changes, 2000u * 4);
+		EXPECT_LE(maxPerSample, 4u);
+		EXPECT_GT(samples, 2000u * SAMPLES * 3);
+	}
+
+	TEST(DebouncerTest, ContinuousNoiseIsBounded)
+	{
+		// a broken wire picking up noise on one input, the changes it lets through are at most one per
+		// SAMPLES samples whatever the noise, the other inputs are not disturbed
+		std::mt19937 random(7);
+		std::bernoulli_distribution coin(0.5);
+		Debouncer debouncer(MASK, SAMPLES, MASK);
+		uint32_t changes = 0;
+		constexpr uint32_t NOISE_SAMPLES = 100000;
+		for (uint32_t i = 0; i < NOISE_SAMPLES; i++)
+		{
+			const uint32_t changed = debouncer.Sample((MASK & ~RAPID) | (coin(random) ? RAPID : 0));
+			EXPECT_EQ(changed & ~RAPID, 0u);
+			changes += __builtin_popcount(changed);
+		}
+		EXPECT_LE(changes, NOISE_SAMPLES / SAMPLES);
+	}
+
+} // namespace PowerFeed
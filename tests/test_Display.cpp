@@ -50,6 +50,45 @@ namespace PowerFeed
 		myDisplay->DrawSpeed(speed);
 	}
 
+	TEST_F(DisplayTest, DrawFeedPerRevInBothUnits)
+	{
+		// ~1022 steps per mm, 102 steps per revolution is 0.1mm or 0.0039in
+		EXPECT_CALL(*myDisplay, DrawText(testing::StrEq("0.100 mm/r"), _, _, _)).Times(1);
+		myDisplay->DrawFeedPerRev(102);
+
+		myDisplay->ToggleUnits();
+		EXPECT_CALL(*myDisplay, DrawText(testing::StrEq("0.0039 in/r"), _, _, _)).Times(1);
+		myDisplay->DrawFeedPerRev(102);
+	}
+
+	TEST_F(DisplayTest, DrawSpeedNamesTheAxisWhenThereAreSeveral)
+	{
+		class TwoAxisSettings : public SettingsManager
+		{
+		public:
+			TwoAxisSettings()
+			{
+				nlohmann::json j = myDefaultSettings->to_json();
+				nlohmann::json y = j["AXES"][0];
+				y["NAME"] = "Y";
+				y["MECHANICAL"]["MM_PER_LEADSCREW_REV"] = 3.175;
+				j["AXES"].push_back(y);
+				myDefaultSettings = std::make_shared<Settings>(Settings::from_json(j));
+			}
+		};
+
+		TwoAxisSettings settings;
+		TestDisplay display(&settings, font_5x8);
+
+		EXPECT_CALL(display, DrawText(testing::StrEq("X 587.2 mm "), _, _, _)).Times(1);
+		display.DrawSpeed(10000);
+
+		// half the pitch, half the feed rate for the same step rate
+		display.SelectAxis(1);
+		EXPECT_CALL(display, DrawText(testing::StrEq("Y 293.6 mm "), _, _, _)).Times(1);
+		display.DrawSpeed(10000);
+	}
+
 } // namespace
 
 TEST(BasicTest, SimpleAssertion)
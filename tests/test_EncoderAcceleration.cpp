@@ -0,0 +1,98 @@
+#include "../src/EncoderAcceleration.hxx"
+#include "../src/Settings.hxx"
+#include <gtest/gtest.h>
+
+namespace PowerFeed
+{
+	namespace
+	{
+		// the curve of the default config, read every 5ms while the knob turns like the encoder task does
+		const EncoderAccelerationCurve CURVE = SettingsManager().Get()->axes[0].controls.encoderAcceleration;
+		constexpr uint32_t READ_US = 5000;
+
+		// turns the knob at aCountsPerSecond for aSeconds, returns the scaled counts
+		int64_t Turn(EncoderAcceleration &anAcceleration, uint32_t &aNowUs, int32_t aCountsPerSecond, double aSeconds)
+		{
+			int64_t total = 0;
+			const uint32_t reads = static_cast<uint32_t>(aSeconds * 1000000 / READ_US);
+			double owed = 0;
+			for (uint32_t i = 0; i < reads; i++)
+			{
+				aNowUs += READ_US;
+				owed += aCountsPerSecond * (READ_US / 1000000.0);
+				const int32_t counts = static_cast<int32_t>(owed);
+				if (counts != 0)
+				{
+					owed -= counts;
+					total += anAcceleration.Apply(counts, aNowUs);
+				}
+			}
+			return total;
+		}
+	}
+
+	TEST(EncoderAccelerationTest, SlowTurnsCountOnce)
+	{
+		EncoderAcceleration acceleration(CURVE);
+		uint32_t now = 0;
+		// two detents a second, and a single count after a pause
+		EXPECT_EQ(Turn(acceleration, now, 8, 2.0), 16);
+		now += 1000000;
+		EXPECT_EQ(acceleration.Apply(1, now), 1);
+		EXPECT_EQ(acceleration.Apply(-1, now + 20000), -1);
+	}
+
+	TEST(EncoderAccelerationTest, FlickCrossesTheSpeedRange)
+	{
+		// ten steps a second a count, from 100 to 15000 steps/s is 1490 counts, in a quarter of a second at a
+		// turn a second of a 24 detent knob
+		EncoderAcceleration acceleration(CURVE);
+		uint32_t now = 0;
+		const int64_t total = Turn(acceleration, now, 96 * 5, 0.25);
+		EXPECT_GT(total, 1490);
+		EXPECT_NEAR(acceleration.GetCountsPerSecond(), 480u, 100u);
+	}
+
+	TEST(EncoderAccelerationTest, SpeedDoesNotDependOnTheReadInterval)
+	{
+		EncoderAcceleration every5(CURVE);
+		EncoderAcceleration every20(CURVE);
+		uint32_t now5 = 0;
+		uint32_t now20 = 0;
+		for (int i = 0; i < 40; i++)
+		{
+			now5 += 5000;
+			every5.Apply(2, now5);
+			if (i % 4 == 3)
+			{
+				now20 += 20000;
+				every20.Apply(8, now20);
+			}
+		}
+		EXPECT_EQ(every5.GetCountsPerSecond(), 400u);
+		EXPECT_EQ(every20.GetCountsPerSecond(), 400u);
+		EXPECT_EQ(every5.MultiplierAt(400), every20.MultiplierAt(400));
+	}
+
+	TEST(EncoderAccelerationTest, CurveInterpolatesAndHoldsFlat)
+	{
+		EncoderAcceleration acceleration({{100, 1}, {300, 10}, {600, 40}});
+		EXPECT_EQ(acceleration.MultiplierAt(0), 1u);
+		EXPECT_EQ(acceleration.MultiplierAt(100), 1u);
+		EXPECT_EQ(acceleration.MultiplierAt(200), 6u);
+		EXPECT_EQ(acceleration.MultiplierAt(450), 25u);
+		EXPECT_EQ(acceleration.MultiplierAt(100000), 40u);
+
+		EncoderAcceleration none({});
+		EXPECT_EQ(none.MultiplierAt(100000), 1u);
+	}
+
+	TEST(EncoderAccelerationTest, TurningBackStartsSlow)
+	{
+		EncoderAcceleration acceleration(CURVE);
+		uint32_t now = 0;
+		Turn(acceleration, now, 800, 0.1);
+		EXPECT_EQ(acceleration.Apply(-4, now + READ_US), -4);
+	}
+
+} // namespace PowerFeed
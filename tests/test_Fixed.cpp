@@ -0,0 +1,58 @@
+#include "../src/Fixed.hxx"
+#include "../src/Settings.hxx"
+#include <cmath>
+#include <gtest/gtest.h>
+
+namespace PowerFeed
+{
+	TEST(FixedTest, ArithmeticRoundsToNearest)
+	{
+		EXPECT_EQ(Fixed::FromInt(3).ToInt(), 3);
+		EXPECT_EQ((Fixed::FromInt(7) / Fixed::FromInt(2)).Raw(), 7 * Fixed::ONE / 2);
+		EXPECT_EQ((Fixed::FromRatio(1, 3) * Fixed::FromInt(3)).ToInt(), 1);
+		EXPECT_EQ(Fixed::FromRatio(127, 5).Raw(), Fixed::FromDouble(25.4).Raw());
+		EXPECT_EQ(Fixed::FromRatio(-1, 2).Raw(), -Fixed::ONE / 2);
+		EXPECT_EQ(Fixed::FromRatio(5, 2).Scale(3), 8);
+	}
+
+	TEST(FixedTest, SaturatesInsteadOfWrapping)
+	{
+		const Fixed big = Fixed::FromInt(30000);
+		EXPECT_EQ((big + big).Raw(), INT32_MAX);
+		EXPECT_EQ((Fixed::FromInt(0) - big - big).Raw(), INT32_MIN);
+		EXPECT_EQ((big * big).Raw(), INT32_MAX);
+		EXPECT_EQ((big * Fixed::FromInt(-2)).Raw(), INT32_MIN);
+		EXPECT_EQ((big / Fixed::FromInt(0)).Raw(), INT32_MAX);
+		EXPECT_EQ(Fixed::FromInt(100000).Raw(), INT32_MAX);
+		EXPECT_EQ(Fixed::FromDouble(-1e9).Raw(), INT32_MIN);
+		EXPECT_EQ(Fixed::FromInt(30000).Scale(INT32_MAX), INT32_MAX);
+	}
+
+	// the fixed point conversions against the float math Display::DrawSpeed used to do
+	TEST(FixedTest, FeedRateMatchesFloatPath)
+	{
+		SettingsManager settings;
+		const Settings::Mechanical &mech = settings.Get()->axes[0].mechanical;
+
+		const double stepsPerMm = mech.stepsPerMotorRev * mech.motorToLeadscrewReduction.ToDouble() / mech.mmPerLeadscrewRev.ToDouble();
+		EXPECT_NEAR(mech.stepsPerMm.ToDouble(), stepsPerMm, stepsPerMm * 1e-6);
+
+		for (uint32_t steps = 0; steps <= 800000; steps += 7)
+		{
+			const float mmPerMinute = (static_cast<float>(steps) / static_cast<float>(stepsPerMm)) * 60.0f;
+			const float inchPerMinute = mmPerMinute * (1.0f / 25.4f);
+
+			// within a tenth, i.e. the last digit shown is never off by more than one
+			ASSERT_NEAR(mech.StepsToTenths(steps, false), mmPerMinute * 10, 1.0) << steps;
+			ASSERT_NEAR(mech.StepsToTenths(steps, true), inchPerMinute * 10, 1.0) << steps;
+		}
+
+		for (uint32_t tenths = 0; tenths <= 200000; tenths += 3)
+		{
+			const double steps = tenths / 600.0 * stepsPerMm;
+			ASSERT_NEAR(mech.TenthsToSteps(tenths, false), steps, 1.0 + steps * 1e-5) << tenths;
+			ASSERT_NEAR(mech.TenthsToSteps(tenths / 10, true), tenths / 10 * 25.4 / 600.0 * stepsPerMm, 1.0 + steps * 1e-5) << tenths;
+		}
+	}
+
+} // namespace PowerFeed
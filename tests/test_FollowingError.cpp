@@ -0,0 +1,73 @@
+#include "../src/FollowingError.hxx"
+#include <cstdlib>
+#include <gtest/gtest.h>
+
+namespace PowerFeed
+{
+	// 1600 steps per motor rev through a 4.0556:1 reduction, a 4000 count encoder on the leadscrew
+	class FollowingErrorTest : public ::testing::Test
+	{
+	protected:
+		static constexpr uint32_t COUNTS_PER_REV = 4000;
+		static constexpr uint32_t LIMIT = 50;
+
+		const Fixed myStepsPerRev = Fixed::FromInt(1600) * Fixed::FromDouble(4.055555556);
+		FollowingError myError{myStepsPerRev, COUNTS_PER_REV, LIMIT};
+
+		int32_t CountsForSteps(int64_t aSteps) const
+		{
+			return static_cast<int32_t>((aSteps * COUNTS_PER_REV * Fixed::ONE) / myStepsPerRev.Raw());
+		}
+	};
+
+	TEST_F(FollowingErrorTest, TracksALongMoveWithoutDrifting)
+	{
+		myError.Reset(0, 0);
+		// a metre of travel, one encoder reading per thousand steps
+		for (int32_t steps = 0; steps <= 1000000; steps += 1000)
+		{
+			ASSERT_FALSE(myError.Update(steps, CountsForSteps(steps))) << steps;
+		}
+		// within an encoder count, 1.6 steps here
+		EXPECT_LE(myError.GetMaxError(), 2u);
+	}
+
+	TEST_F(FollowingErrorTest, LostStepsCrossTheLimit)
+	{
+		myError.Reset(0, 0);
+		EXPECT_FALSE(myError.Update(10000, CountsForSteps(10000 - LIMIT + 2)));
+		EXPECT_NEAR(myError.GetError(), static_cast<int32_t>(LIMIT), 2);
+		EXPECT_TRUE(myError.Update(10100, CountsForSteps(10100 - LIMIT - 5)));
+
+		// the motor overrunning trips it as well
+		myError.Reset(0, 0);
+		EXPECT_TRUE(myError.Update(1000, CountsForSteps(1100)));
+		EXPECT_LT(myError.GetError(), 0);
+	}
+
+	TEST_F(FollowingErrorTest, CountersWrapAround)
+	{
+		const int32_t steps = INT32_MAX - 500;
+		const int32_t counts = INT32_MIN + 200;
+		myError.Reset(steps, counts);
+
+		const int32_t moved = 20000;
+		const int32_t wrappedSteps = static_cast<int32_t>(static_cast<uint32_t>(steps) + moved);
+		const int32_t wrappedCounts = static_cast<int32_t>(static_cast<uint32_t>(counts) - CountsForSteps(moved));
+		EXPECT_TRUE(myError.Update(wrappedSteps, wrappedCounts));
+
+		const int32_t followedCounts = static_cast<int32_t>(static_cast<uint32_t>(counts) + CountsForSteps(moved));
+		EXPECT_FALSE(myError.Update(wrappedSteps, followedCounts));
+		EXPECT_LE(std::abs(myError.GetError()), 2);
+	}
+
+	TEST_F(FollowingErrorTest, ResetStartsFromTheCurrentPosition)
+	{
+		myError.Reset(0, 0);
+		// turned by hand while the driver was disabled
+		EXPECT_TRUE(myError.Update(0, 5000));
+		myError.Reset(0, 5000);
+		EXPECT_FALSE(myError.Update(1000, 5000 + CountsForSteps(1000)));
+	}
+
+} // namespace PowerFeed
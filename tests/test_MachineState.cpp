@@ -15,10 +15,10 @@ protected:
 	void SetUp() override
 	{
 		mySettings = std::make_shared<SettingsManager>();
-		MOVE_LEFT_DIRECTION = mySettings->Get()->mechanical.moveLeftDirection;
-		MOVE_RIGHT_DIRECTION = mySettings->Get()->mechanical.moveRightDirection;
-		ENCODER_COUNTS_TO_STEPS_PER_SECOND = mySettings->Get()->controls.encoderCountsToStepsPerSecond;
-		ACCELERATION_JERK = mySettings->Get()->mechanical.accelerationJerk;
+		MOVE_LEFT_DIRECTION = mySettings->Get()->axes[0].mechanical.moveLeftDirection;
+		MOVE_RIGHT_DIRECTION = mySettings->Get()->axes[0].mechanical.moveRightDirection;
+		ENCODER_COUNTS_TO_STEPS_PER_SECOND = mySettings->Get()->axes[0].controls.encoderCountsToStepsPerSecond;
+		ACCELERATION_JERK = mySettings->Get()->axes[0].mechanical.accelerationJerk;
 		display = std::make_shared<MockDisplay>();
 		stepper = std::make_shared<::Drivers::TestStepper>();
 		time = std::make_shared<TestTime>();
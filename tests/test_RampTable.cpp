@@ -0,0 +1,137 @@
+#include "../src/RampTable.hxx"
+#include <cmath>
+#include <gtest/gtest.h>
+
+namespace PowerFeed
+{
+	namespace
+	{
+		constexpr uint32_t TICK_HZ = 125000000;
+		constexpr uint32_t START_SPEED = 10;
+		constexpr uint32_t MAX_SPEED = 800000;
+		constexpr uint32_t RATE = 200000;
+
+		double ExactPeriod(uint32_t anIndex)
+		{
+			double square = std::max(2.0 * RATE * (anIndex + 0.5), static_cast<double>(START_SPEED) * START_SPEED);
+			return TICK_HZ / std::sqrt(square);
+		}
+	}
+
+	TEST(RampTableTest, InterpolationStaysCloseToExactRamp)
+	{
+		RampTable table(TICK_HZ, START_SPEED, MAX_SPEED, RATE, 128);
+
+		double worst = 0;
+		while (table.GetPeriod() > TICK_HZ / MAX_SPEED)
+		{
+			// periods are whole ticks, so half a tick of the error is rounding rather than interpolation
+			double exact = ExactPeriod(table.GetIndex());
+			worst = std::max(worst, (std::abs(table.GetPeriod() - exact) - 0.5) / exact);
+			table.StepUp();
+		}
+
+		EXPECT_LT(worst, 0.003);
+	}
+
+	TEST(RampTableTest, StepDownRetracesStepUp)
+	{
+		RampTable table(TICK_HZ, START_SPEED, MAX_SPEED, RATE, 64);
+
+		std::vector<uint32_t> periods;
+		for (uint32_t i = 0; i < 100000; i++)
+		{
+			periods.push_back(table.GetPeriod());
+			table.StepUp();
+		}
+		for (uint32_t i = 100000; i > 0; i--)
+		{
+			table.StepDown();
+			// fixed point steps may round differently on the way back
+			ASSERT_NEAR(table.GetPeriod(), periods[i - 1], 1) << "at index " << table.GetIndex();
+		}
+		EXPECT_EQ(table.GetIndex(), table.GetFirstIndex());
+	}
+
+	TEST(RampTableTest, SeekMatchesWalking)
+	{
+		RampTable walked(TICK_HZ, START_SPEED, MAX_SPEED, RATE, 128);
+		RampTable sought(TICK_HZ, START_SPEED, MAX_SPEED, RATE, 128);
+
+		for (uint32_t i = 0; i < 50000; i++)
+		{
+			walked.StepUp();
+		}
+		sought.Seek(walked.GetIndex());
+		EXPECT_EQ(sought.GetIndex(), walked.GetIndex());
+		EXPECT_NEAR(sought.GetPeriod(), walked.GetPeriod(), 1);
+	}
+
+	TEST(RampTableTest, ClampsOutsideTheTable)
+	{
+		RampTable table(TICK_HZ, START_SPEED, MAX_SPEED, RATE, 128);
+
+		table.StepDown();
+		EXPECT_EQ(table.GetIndex(), table.GetFirstIndex());
+
+		// past the max speed the period holds at its minimum
+		table.Seek(0xffffffff);
+		EXPECT_EQ(table.GetPeriod(), TICK_HZ / MAX_SPEED);
+		table.StepUp();
+		EXPECT_EQ(table.GetPeriod(), TICK_HZ / MAX_SPEED);
+	}
+
+	TEST(RampTableTest, FootprintFollowsSegments)
+	{
+		RampTable small(TICK_HZ, START_SPEED, MAX_SPEED, RATE, 16);
+		RampTable large(TICK_HZ, START_SPEED, MAX_SPEED, RATE, 256);
+
+		EXPECT_LT(small.GetFootprint(), large.GetFootprint());
+		EXPECT_LE(large.GetFootprint(), 257 * 24u);
+	}
+
+	TEST(RampTableTest, FlatCurveMatchesFlatRate)
+	{
+		RampTable flat(TICK_HZ, START_SPEED, MAX_SPEED, RATE, 128);
+		RampTable curve(TICK_HZ, START_SPEED, MAX_SPEED, 1, 128, {{0, RATE}});
+
+		EXPECT_EQ(curve.GetFirstIndex(), flat.GetFirstIndex());
+		for (uint32_t i = 0; i < 100000; i++)
+		{
+			ASSERT_NEAR(curve.GetPeriod(), flat.GetPeriod(), 1) << "at index " << flat.GetIndex();
+			flat.StepUp();
+			curve.StepUp();
+		}
+	}
+
+	TEST(RampTableTest, CurveAcceleratesAtTheRateForTheSpeed)
+	{
+		// twice the rate at low speed, falling off to half of it towards the top
+		const AccelerationCurve curve = {{50000, 2 * RATE}, {400000, RATE}, {700000, RATE / 2}};
+		RampTable table(TICK_HZ, START_SPEED, MAX_SPEED, RATE, 128, curve);
+
+		// time to each speed against the integral of dv / a(v). Periods are whole ticks, which is too coarse to
+		// measure the rate over a few steps near the top, but it averages out over the ramp
+		double elapsed = 0;
+		double expected = 0;
+		double speed = 0;
+		double worst = 0;
+		for (uint32_t checkpoint = 100000; checkpoint < MAX_SPEED; checkpoint += 100000)
+		{
+			while (static_cast<double>(TICK_HZ) / table.GetPeriod() < checkpoint)
+			{
+				elapsed += static_cast<double>(table.GetPeriod()) / TICK_HZ;
+				table.StepUp();
+			}
+			const double reached = static_cast<double>(TICK_HZ) / table.GetPeriod();
+			for (; speed < reached; speed += 10)
+			{
+				expected += 10 / RampTable::AccelerationAt(curve, speed + 5);
+			}
+			worst = std::max(worst, std::abs(elapsed - expected) / expected);
+		}
+
+		EXPECT_LT(worst, 0.01);
+	}
+
+} // namespace PowerFeed
@@ -0,0 +1,149 @@
+#include "../src/Reciprocator.hxx"
+#include "../src/StepRamp.hxx"
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <tuple>
+
+namespace PowerFeed
+{
+	// an axis stepped by a StepRamp the way the stepper task drives it, on a 1MHz tick so ticks are microseconds
+	class SimulatedAxis
+	{
+	public:
+		SimulatedAxis(uint32_t aJerk) : myRamp(1000000, 100000, 10000, 20000, 10, aJerk > 0 ? 0 : 128, aJerk) {}
+
+		void MoveTo(int32_t aTarget, uint32_t aSpeed)
+		{
+			myDirection = aTarget > myPosition;
+			myRamp.SetTargetSpeed(aSpeed);
+			myRamp.SetStepsLeft(static_cast<uint32_t>(std::abs(aTarget - myPosition)));
+			myRamp.Start();
+		}
+
+		// until the ramp stops, returns the steps taken
+		uint32_t Run()
+		{
+			uint32_t steps = 0;
+			while (uint32_t period = myRamp.NextPeriod())
+			{
+				myNowUs += period;
+				myPosition += myDirection ? 1 : -1;
+				steps++;
+			}
+			return steps;
+		}
+
+		void Wait(uint64_t aUntilUs)
+		{
+			if (aUntilUs > myNowUs)
+			{
+				myNowUs = aUntilUs;
+			}
+		}
+
+		int32_t GetPosition() const { return myPosition; }
+		uint64_t GetNowUs() const { return myNowUs; }
+
+	private:
+		StepRamp myRamp;
+		int32_t myPosition = 0;
+		bool myDirection = true;
+		uint64_t myNowUs = 0;
+	};
+
+	class ReciprocatorTest : public ::testing::TestWithParam<uint32_t>
+	{
+	};
+
+	TEST_P(ReciprocatorTest, ReversalPointsDoNotDriftOverThousandsOfStrokes)
+	{
+		static constexpr int32_t FROM = -1234;
+		static constexpr int32_t TO = 1777;
+		static constexpr uint32_t STROKES = 5000;
+		static constexpr uint32_t DWELL_US = 50000;
+		static constexpr uint32_t PULSE_US = 20000;
+
+		SimulatedAxis axis(GetParam());
+		axis.MoveTo(FROM, 20000);
+		axis.Run();
+		ASSERT_EQ(axis.GetPosition(), FROM);
+
+		Reciprocator reciprocator(DWELL_US, PULSE_US);
+		reciprocator.Start(FROM, TO, axis.GetNowUs());
+		axis.MoveTo(reciprocator.GetTarget(), 8000);
+
+		uint32_t pulses = 0;
+		while (reciprocator.GetStrokes() < STROKES)
+		{
+			const uint32_t steps = axis.Run();
+			ASSERT_EQ(steps, static_cast<uint32_t>(TO - FROM)) << "stroke " << reciprocator.GetStrokes();
+			const int32_t end = reciprocator.GetTarget();
+			ASSERT_EQ(axis.GetPosition(), end) << "stroke " << reciprocator.GetStrokes();
+
+			// arrives, pulses the cross feed and dwells before setting off the other way
+			const uint64_t arrived = axis.GetNowUs();
+			ASSERT_FALSE(reciprocator.Update(arrived, true, axis.GetPosition()));
+			ASSERT_EQ(reciprocator.GetPhase(), Reciprocator::Phase::DWELLING);
+			ASSERT_TRUE(reciprocator.IsCrossFeedOn(arrived));
+			pulses++;
+			ASSERT_EQ(reciprocator.GetWakeAtUs(arrived), arrived + PULSE_US);
+			axis.Wait(reciprocator.GetWakeAtUs(arrived));
+			ASSERT_FALSE(reciprocator.Update(axis.GetNowUs(), true, axis.GetPosition()));
+			ASSERT_FALSE(reciprocator.IsCrossFeedOn(axis.GetNowUs()));
+			axis.Wait(reciprocator.GetWakeAtUs(axis.GetNowUs()));
+			ASSERT_EQ(axis.GetNowUs(), arrived + DWELL_US);
+			ASSERT_TRUE(reciprocator.Update(axis.GetNowUs(), true, axis.GetPosition()));
+			ASSERT_EQ(reciprocator.GetTarget(), end == TO ? FROM : TO);
+			axis.MoveTo(reciprocator.GetTarget(), 8000);
+		}
+
+		EXPECT_EQ(pulses, STROKES);
+		EXPECT_EQ(axis.GetPosition(), STROKES % 2 == 0 ? FROM : TO);
+		// every stroke takes the same time, so the rate is that of the last one with its dwell
+		const uint32_t perMinute = reciprocator.GetStrokesPerMinuteTenths();
+		EXPECT_NEAR(perMinute, 600000000.0 / (reciprocator.GetLastStrokeUs() + DWELL_US), perMinute * 0.01);
+		// 3011 steps never reach 8000 steps/s, the ramp alone takes a second, the landing must not add much to it
+		EXPECT_LT(reciprocator.GetLastStrokeUs(), 1500000u);
+	}
+
+	INSTANTIATE_TEST_SUITE_P(Trapezoid, ReciprocatorTest, ::testing::Values(0u));
+	INSTANTIATE_TEST_SUITE_P(SCurve, ReciprocatorTest, ::testing::Values(100000u));
+
+	TEST(ReciprocatorTest, WaitsWhileMoving)
+	{
+		Reciprocator reciprocator(0, 0);
+		reciprocator.Start(0, 100, 0);
+		EXPECT_TRUE(reciprocator.IsActive());
+		EXPECT_FALSE(reciprocator.Update(10, false, 50));
+		EXPECT_EQ(reciprocator.GetStrokes(), 0u);
+
+		// no dwell, it turns around on the same update
+		EXPECT_TRUE(reciprocator.Update(20, true, 100));
+		EXPECT_EQ(reciprocator.GetTarget(), 0);
+		EXPECT_EQ(reciprocator.GetStrokes(), 1u);
+		EXPECT_EQ(reciprocator.GetWakeAtUs(20), 0u);
+	}
+
+	TEST(ReciprocatorTest, StopsIfTheAxisStopsShort)
+	{
+		Reciprocator reciprocator(1000, 1000);
+		reciprocator.Start(0, 100, 0);
+		EXPECT_FALSE(reciprocator.Update(10, true, 60));
+		EXPECT_FALSE(reciprocator.IsActive());
+		EXPECT_FALSE(reciprocator.IsCrossFeedOn(10));
+		EXPECT_EQ(reciprocator.GetStrokes(), 0u);
+	}
+
+	TEST(ReciprocatorTest, StopEndsTheDwellAndThePulse)
+	{
+		Reciprocator reciprocator(1000, 500);
+		reciprocator.Start(0, 100, 0);
+		reciprocator.Update(100, true, 100);
+		EXPECT_TRUE(reciprocator.IsCrossFeedOn(200));
+		reciprocator.Stop();
+		EXPECT_FALSE(reciprocator.IsCrossFeedOn(200));
+		EXPECT_FALSE(reciprocator.Update(2000, true, 100));
+		EXPECT_EQ(reciprocator.GetWakeAtUs(200), 0u);
+	}
+
+} // namespace PowerFeed
@@ -0,0 +1,167 @@
+#include "../src/SCurve.hxx"
+#include "../src/StepRamp.hxx"
+#include <cmath>
+#include <cstdlib>
+#include <gtest/gtest.h>
+
+namespace PowerFeed
+{
+	class SCurveTest : public ::testing::Test
+	{
+	protected:
+		static constexpr uint32_t TICK_HZ = 1000000;
+		static constexpr uint32_t ACCELERATION = 10000;
+		static constexpr uint32_t DECELERATION = 20000;
+		static constexpr uint32_t JERK = 100000;
+
+		// Step until the curve settles, checking the limits on the way. Returns elapsed seconds.
+		double RunToTarget(SCurve &aCurve, uint32_t aLimit = 1000000)
+		{
+			uint64_t elapsed = 0;
+			int32_t lastAcceleration = aCurve.GetAcceleration();
+			// the curve may already be part way through a slice when it is handed over
+			int64_t lastChange = -static_cast<int64_t>(SCurve::SLICE_US * (TICK_HZ / 1000000));
+			uint32_t steps = 0;
+			while (!aCurve.IsSettled() && steps++ < aLimit)
+			{
+				elapsed += aCurve.Step();
+
+				int32_t acceleration = aCurve.GetAcceleration();
+				EXPECT_LE(std::abs(acceleration), static_cast<int32_t>(DECELERATION));
+				if (acceleration != lastAcceleration)
+				{
+					// several steps share a slice at speed, the change covers all of them
+					double seconds = static_cast<double>(static_cast<int64_t>(elapsed) - lastChange) / TICK_HZ;
+					EXPECT_LE(std::abs(acceleration - lastAcceleration), JERK * seconds + 2) << "at " << elapsed;
+					lastAcceleration = acceleration;
+					lastChange = static_cast<int64_t>(elapsed);
+				}
+			}
+			return static_cast<double>(elapsed) / TICK_HZ;
+		}
+	};
+
+	TEST_F(SCurveTest, ReachesTargetInTrapezoidTimePlusJerkRamps)
+	{
+		SCurve curve(TICK_HZ, ACCELERATION, DECELERATION, JERK);
+		curve.Reset(10);
+		curve.SetTarget(10000);
+
+		// dv / a for the trapezoid, plus a / j for the ramps in and out of full acceleration
+		double seconds = RunToTarget(curve);
+		EXPECT_TRUE(curve.IsSettled());
+		EXPECT_EQ(curve.GetSpeed(), 10000u);
+		EXPECT_NEAR(seconds, 9990.0 / ACCELERATION + static_cast<double>(ACCELERATION) / JERK, 0.02);
+	}
+
+	TEST_F(SCurveTest, SlowsDownAtTheDecelerationLimit)
+	{
+		SCurve curve(TICK_HZ, ACCELERATION, DECELERATION, JERK);
+		curve.Reset(10000);
+		curve.SetTarget(10);
+
+		double seconds = RunToTarget(curve);
+		EXPECT_EQ(curve.GetSpeed(), 10u);
+		EXPECT_NEAR(seconds, 9990.0 / DECELERATION + static_cast<double>(DECELERATION) / JERK, 0.02);
+	}
+
+	TEST_F(SCurveTest, SmallChangesNeverReachFullAcceleration)
+	{
+		SCurve curve(TICK_HZ, ACCELERATION, DECELERATION, JERK);
+		curve.Reset(1000);
+		curve.SetTarget(1100);
+
+		// triangular acceleration, peaks at sqrt(dv * j) and takes 2 * sqrt(dv / j)
+		int32_t peak = 0;
+		uint64_t elapsed = 0;
+		while (!curve.IsSettled())
+		{
+			elapsed += curve.Step();
+			peak = std::max(peak, curve.GetAcceleration());
+		}
+		EXPECT_NEAR(peak, std::sqrt(100.0 * JERK), 250);
+		EXPECT_NEAR(static_cast<double>(elapsed) / TICK_HZ, 2 * std::sqrt(100.0 / JERK), 0.006);
+	}
+
+	TEST_F(SCurveTest, NewTargetMidRampKeepsSpeedContinuous)
+	{
+		SCurve curve(TICK_HZ, ACCELERATION, DECELERATION, JERK);
+		curve.Reset(10);
+		curve.SetTarget(10000);
+
+		uint64_t elapsed = 0;
+		while (elapsed < TICK_HZ / 2)
+		{
+			elapsed += curve.Step();
+		}
+		uint32_t speed = curve.GetSpeed();
+		EXPECT_GT(curve.GetAcceleration(), 0);
+
+		curve.SetTarget(2000);
+		EXPECT_EQ(curve.GetSpeed(), speed);
+		RunToTarget(curve);
+		EXPECT_EQ(curve.GetSpeed(), 2000u);
+	}
+
+	TEST_F(SCurveTest, EncoderUpdatesKeepAccelerationContinuous)
+	{
+		SCurve curve(TICK_HZ, ACCELERATION, DECELERATION, JERK);
+		curve.Reset(3000);
+
+		// a new target every 10ms, often closer than the acceleration can run out in
+		uint64_t elapsed = 0;
+		uint64_t nextUpdate = 0;
+		uint32_t update = 0;
+		int32_t lastAcceleration = 0;
+		int64_t lastChange = 0;
+		while (elapsed < 2 * TICK_HZ)
+		{
+			if (elapsed >= nextUpdate)
+			{
+				curve.SetTarget(3000 + (update % 2 == 0 ? 100 : 0) + (update % 5) * 150);
+				update++;
+				nextUpdate += TICK_HZ / 100;
+			}
+
+			elapsed += curve.Step();
+			int32_t acceleration = curve.GetAcceleration();
+			EXPECT_LE(std::abs(acceleration), static_cast<int32_t>(DECELERATION));
+			if (acceleration != lastAcceleration)
+			{
+				double seconds = static_cast<double>(static_cast<int64_t>(elapsed) - lastChange) / TICK_HZ;
+				EXPECT_LE(std::abs(acceleration - lastAcceleration), JERK * seconds + 2) << "at " << elapsed;
+				lastAcceleration = acceleration;
+				lastChange = static_cast<int64_t>(elapsed);
+			}
+		}
+	}
+
+	TEST_F(SCurveTest, StepRampWithJerkStartsAndStops)
+	{
+		StepRamp ramp(TICK_HZ, 100000, ACCELERATION, DECELERATION, 10, 128, JERK);
+		EXPECT_EQ(ramp.GetTableFootprint(), 0u);
+
+		ramp.SetTargetSpeed(5000);
+		ramp.Start();
+		EXPECT_EQ(ramp.GetState(), StepRamp::State::ACCELERATING);
+
+		uint32_t steps = 0;
+		while (ramp.GetState() != StepRamp::State::CRUISING && steps++ < 100000)
+		{
+			ramp.NextPeriod();
+		}
+		EXPECT_EQ(ramp.GetCurrentSpeed(), 5000u);
+
+		ramp.Stop();
+		EXPECT_EQ(ramp.GetState(), StepRamp::State::STOPPING);
+		steps = 0;
+		while (ramp.NextPeriod() != 0 && steps++ < 100000)
+		{
+		}
+		EXPECT_EQ(ramp.GetState(), StepRamp::State::STOPPED);
+		EXPECT_EQ(ramp.GetCurrentSpeed(), 0u);
+		// 5000 / 20000 + 20000 / 100000 = 0.45 s at an average of about 2500 steps/s
+		EXPECT_NEAR(steps, 1125, 120);
+	}
+
+} // namespace PowerFeed
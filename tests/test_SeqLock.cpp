@@ -0,0 +1,57 @@
+#include "../src/SeqLock.hxx"
+#include <atomic>
+#include <gtest/gtest.h>
+#include <thread>
+
+namespace PowerFeed
+{
+	namespace
+	{
+		struct Snapshot
+		{
+			uint32_t a;
+			uint32_t b;
+			uint64_t c;
+		};
+	}
+
+	TEST(SeqLockTest, ReadReturnsLastWrite)
+	{
+		SeqLock<Snapshot> lock;
+		EXPECT_EQ(lock.Read().a, 0u);
+
+		lock.Write({1, 2, 3});
+		Snapshot snapshot = lock.Read();
+		EXPECT_EQ(snapshot.a, 1u);
+		EXPECT_EQ(snapshot.b, 2u);
+		EXPECT_EQ(snapshot.c, 3u);
+	}
+
+	TEST(SeqLockTest, ReadersNeverSeeATornWrite)
+	{
+		SeqLock<Snapshot> lock;
+		lock.Write({0, ~0u, 0});
+		std::atomic<bool> done = false;
+
+		std::thread writer([&lock, &done]()
+						   {
+			for (uint32_t i = 1; i < 20000; i++)
+			{
+				lock.Write({i, ~i, static_cast<uint64_t>(i) * 3});
+			}
+			done = true; });
+
+		uint32_t last = 0;
+		while (!done)
+		{
+			Snapshot snapshot = lock.Read();
+			ASSERT_EQ(snapshot.b, ~snapshot.a);
+			ASSERT_EQ(snapshot.c, static_cast<uint64_t>(snapshot.a) * 3);
+			ASSERT_GE(snapshot.a, last);
+			last = snapshot.a;
+			std::this_thread::yield();
+		}
+		writer.join();
+	}
+
+} // namespace PowerFeed
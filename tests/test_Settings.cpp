@@ -0,0 +1,236 @@
+#include "../src/Settings.hxx"
+#include <gtest/gtest.h>
+#include <stdexcept>
+
+namespace PowerFeed
+{
+	namespace
+	{
+		// the default config with a second axis that has its own pins and a finer leadscrew
+		nlohmann::json TwoAxisJson()
+		{
+			SettingsManager settings;
+			nlohmann::json j = settings.Get()->to_json();
+			nlohmann::json y = j["AXES"][0];
+			y["NAME"] = "Y";
+			y["DRIVER"]["DRIVER_STEP_PIN"] = 20;
+			y["DRIVER"]["DRIVER_DIR_PIN"] = 21;
+			y["MECHANICAL"]["MM_PER_LEADSCREW_REV"] = 2.0;
+			j["AXES"].push_back(y);
+			return j;
+		}
+
+		std::string ErrorOf(const nlohmann::json &j)
+		{
+			try
+			{
+				Settings::from_json(j);
+			}
+			catch (const std::runtime_error &e)
+			{
+				return e.what();
+			}
+			return "";
+		}
+	}
+
+	TEST(SettingsTest, DefaultConfigHasOneAxis)
+	{
+		SettingsManager settings;
+		ASSERT_EQ(settings.Get()->axes.size(), 1u);
+		EXPECT_EQ(settings.Get()->axes[0].name, "X");
+		EXPECT_EQ(settings.Get()->axes[0].driver.driverPio, 0);
+	}
+
+	TEST(SettingsTest, AxesAreConfiguredIndependently)
+	{
+		Settings settings = Settings::from_json(TwoAxisJson());
+		ASSERT_EQ(settings.axes.size(), 2u);
+		EXPECT_EQ(settings.axes[1].name, "Y");
+		EXPECT_EQ(settings.axes[0].driver.driverStepPin, 6);
+		EXPECT_EQ(settings.axes[1].driver.driverStepPin, 20);
+		EXPECT_GT(settings.axes[1].mechanical.stepsPerMm, settings.axes[0].mechanical.stepsPerMm);
+
+		EXPECT_EQ(Settings::from_json(settings.to_json()).to_json(), settings.to_json());
+	}
+
+	TEST(SettingsTest, RejectsMoreAxesThanFit)
+	{
+		nlohmann::json j = TwoAxisJson();
+		j["AXES"].push_back(j["AXES"][0]);
+		// a third axis is within MAX_AXES but its step generator finds no state machine on PIO 0
+		EXPECT_EQ(ErrorOf(j).rfind("PIO 0 needs 6 state machines", 0), 0u);
+		j["AXES"].push_back(j["AXES"][0]);
+		EXPECT_EQ(ErrorOf(j).rfind("AXES must have", 0), 0u);
+		j["AXES"] = nlohmann::json::array();
+		EXPECT_THROW(Settings::from_json(j), std::runtime_error);
+	}
+
+	TEST(SettingsTest, AccelerationCurveIsOptionalAndInRisingSpeed)
+	{
+		nlohmann::json j = TwoAxisJson();
+		j["AXES"][0]["MECHANICAL"].erase("ACCELERATION_CURVE");
+		j["AXES"][1]["MECHANICAL"]["ACCELERATION_CURVE"] = {{{"STEPS_PER_SECOND", 0}, {"ACCELERATION", 30000}}, {{"STEPS_PER_SECOND", 10000}, {"ACCELERATION", 10000}}};
+		Settings settings = Settings::from_json(j);
+		EXPECT_TRUE(settings.axes[0].mechanical.accelerationCurve.empty());
+		ASSERT_EQ(settings.axes[1].mechanical.accelerationCurve.size(), 2u);
+		EXPECT_EQ(settings.axes[1].mechanical.accelerationCurve[1].speed, 10000u);
+		EXPECT_EQ(settings.axes[1].mechanical.accelerationCurve[1].acceleration, 10000u);
+
+		j["AXES"][1]["MECHANICAL"]["ACCELERATION_CURVE"][1]["STEPS_PER_SECOND"] = 0;
+		EXPECT_THROW(Settings::from_json(j), std::runtime_error);
+	}
+
+	TEST(SettingsTest, EStopIsOptional)
+	{
+		nlohmann::json j = TwoAxisJson();
+		j["ESTOP"] = {{"ENABLED", true}, {"PIN", 26}, {"ACTIVE_HIGH", false}};
+		Settings settings = Settings::from_json(j);
+		EXPECT_TRUE(settings.eStop.enabled);
+		EXPECT_EQ(settings.eStop.pin, 26);
+		EXPECT_FALSE(settings.eStop.activeHigh);
+		EXPECT_EQ(settings.to_json()["ESTOP"], j["ESTOP"]);
+
+		j.erase("ESTOP");
+		EXPECT_FALSE(Settings::from_json(j).eStop.enabled);
+	}
+
+	TEST(SettingsTest, FeedbackAndSpindleAreOptional)
+	{
+		nlohmann::json j = TwoAxisJson();
+		j["AXES"][0]["FEEDBACK"]["ENABLED"] = true;
+		j["SPINDLE"]["ENABLED"] = true;
+		ASSERT_TRUE(Settings::from_json(j).axes[0].feedback.enabled);
+		ASSERT_TRUE(Settings::from_json(j).spindle.enabled);
+
+		j["AXES"][0].erase("FEEDBACK");
+		j.erase("SPINDLE");
+		Settings settings = Settings::from_json(j);
+		EXPECT_FALSE(settings.axes[0].feedback.enabled);
+		EXPECT_FALSE(settings.spindle.enabled);
+		// written back in full, the next load finds them
+		EXPECT_FALSE(Settings::from_json(settings.to_json()).axes[0].feedback.enabled);
+	}
+
+	TEST(SettingsTest, LimitsAreOptionalAndInSteps)
+	{
+		nlohmann::json j = TwoAxisJson();
+		j["AXES"][0]["LIMITS"] = {{"ENABLED", true}, {"LEFT_MM", 100.0}, {"RIGHT_MM", 50.0}};
+		Settings settings = Settings::from_json(j);
+		const Settings::Axis &axis = settings.axes[0];
+		EXPECT_TRUE(axis.limits.enabled);
+		const double stepsPerMm = axis.mechanical.stepsPerMm.ToDouble();
+		EXPECT_NEAR(axis.limits.leftSteps, 100.0 * stepsPerMm, 1.0);
+		EXPECT_NEAR(axis.limits.rightSteps, 50.0 * stepsPerMm, 1.0);
+		EXPECT_EQ(settings.to_json()["AXES"][0]["LIMITS"], j["AXES"][0]["LIMITS"]);
+
+		j["AXES"][0]["LIMITS"]["LEFT_MM"] = -1.0;
+		EXPECT_THROW(Settings::from_json(j), std::runtime_error);
+
+		j["AXES"][0].erase("LIMITS");
+		EXPECT_FALSE(Settings::from_json(j).axes[0].limits.enabled);
+	}
+
+	TEST(SettingsTest, ReciprocateIsOptional)
+	{
+		nlohmann::json j = TwoAxisJson();
+		j["AXES"][1]["RECIPROCATE"] = {{"DWELL_MS", 250}, {"CROSS_FEED_ENABLED", true}, {"CROSS_FEED_PIN", 26}, {"CROSS_FEED_PULSE_MS", 30}};
+		Settings settings = Settings::from_json(j);
+		EXPECT_EQ(settings.axes[1].reciprocate.dwellMs, 250u);
+		EXPECT_TRUE(settings.axes[1].reciprocate.crossFeedEnabled);
+		EXPECT_EQ(settings.axes[1].reciprocate.crossFeedPulseMs, 30u);
+		EXPECT_EQ(settings.to_json()["AXES"][1]["RECIPROCATE"], j["AXES"][1]["RECIPROCATE"]);
+
+		j["AXES"][1].erase("RECIPROCATE");
+		EXPECT_EQ(Settings::from_json(j).axes[1].reciprocate.dwellMs, 0u);
+		EXPECT_FALSE(Settings::from_json(j).axes[1].reciprocate.crossFeedEnabled);
+	}
+
+	TEST(SettingsTest, EncoderIntervalIsOptional)
+	{
+		nlohmann::json j = TwoAxisJson();
+		j["AXES"][0]["CONTROLS"]["ENCODER_INTERVAL_MS"] = 2;
+		EXPECT_EQ(Settings::from_json(j).axes[0].controls.encoderIntervalMs, 2u);
+		j["AXES"][0]["CONTROLS"].erase("ENCODER_INTERVAL_MS");
+		EXPECT_EQ(Settings::from_json(j).axes[0].controls.encoderIntervalMs, 5u);
+	}
+
+	TEST(SettingsTest, DriverAndRampKeysAreOptional)
+	{
+		// a config from before the step streaming and ramp options, every one of them at its default
+		nlohmann::json j = TwoAxisJson();
+		for (const char *key : {"DRIVER_USE_DMA", "DRIVER_STEP_PULSE_NS", "DRIVER_CORE", "DRIVER_PIO"})
+		{
+			j["AXES"][0]["DRIVER"].erase(key);
+		}
+		j["AXES"][0]["MECHANICAL"].erase("RAMP_TABLE_SEGMENTS");
+		j["AXES"][0]["MECHANICAL"].erase("JERK");
+
+		const Settings settings = Settings::from_json(j);
+		EXPECT_TRUE(settings.axes[0].driver.driverUseDma);
+		EXPECT_EQ(settings.axes[0].driver.driverStepPulseNs, 500u);
+		EXPECT_EQ(settings.axes[0].driver.driverCore, 1);
+		EXPECT_EQ(settings.axes[0].driver.driverPio, 0);
+		EXPECT_EQ(settings.axes[0].mechanical.rampTableSegments, 128);
+		EXPECT_EQ(settings.axes[0].mechanical.jerk, 0u);
+	}
+
+	TEST(SettingsTest, EncoderAccelerationMustRise)
+	{
+		nlohmann::json j = TwoAxisJson();
+		const Settings::Controls &controls = Settings::from_json(j).axes[0].controls;
+		EXPECT_EQ(Settings::from_json(j).to_json()["AXES"][0]["CONTROLS"]["ENCODER_ACCELERATION"], j["AXES"][0]["CONTROLS"]["ENCODER_ACCELERATION"]);
+		EXPECT_FALSE(controls.encoderAcceleration.empty());
+
+		j["AXES"][0]["CONTROLS"]["ENCODER_ACCELERATION"] = nlohmann::json::array();
+		EXPECT_TRUE(Settings::from_json(j).axes[0].controls.encoderAcceleration.empty());
+
+		j["AXES"][0]["CONTROLS"]["ENCODER_ACCELERATION"] = {{{"COUNTS_PER_SECOND", 300}, {"MULTIPLIER", 10}}, {{"COUNTS_PER_SECOND", 100}, {"MULTIPLIER", 1}}};
+		EXPECT_THROW(Settings::from_json(j), std::runtime_error);
+		j["AXES"][0]["CONTROLS"]["ENCODER_ACCELERATION"] = {{{"COUNTS_PER_SECOND", 100}, {"MULTIPLIER", 0}}};
+		EXPECT_THROW(Settings::from_json(j), std::runtime_error);
+	}
+
+	TEST(SettingsTest, StartGroupMustShareAPio)
+	{
+		nlohmann::json j = TwoAxisJson();
+		j["AXES"][0]["DRIVER"]["DRIVER_START_GROUP"] = 1;
+		j["AXES"][1]["DRIVER"]["DRIVER_START_GROUP"] = 1;
+		EXPECT_EQ(Settings::from_json(j).axes[1].driver.driverStartGroup, 1);
+
+		j["AXES"][1]["DRIVER"]["DRIVER_PIO"] = 1;
+		EXPECT_EQ(ErrorOf(j).rfind("Axes with the same DRIVER_START_GROUP", 0), 0u);
+	}
+
+	TEST(SettingsTest, StateMachinesMustFit)
+	{
+		nlohmann::json j = TwoAxisJson();
+		// two knob encoders, a feedback encoder and the spindle fill PIO 1
+		j["AXES"][0]["FEEDBACK"]["ENABLED"] = true;
+		j["SPINDLE"]["ENABLED"] = true;
+		EXPECT_NO_THROW(Settings::from_json(j));
+		j["AXES"][1]["FEEDBACK"]["ENABLED"] = true;
+		EXPECT_EQ(ErrorOf(j).rfind("PIO 1 needs 5 state machines", 0), 0u);
+
+		// the step programs would collide with the encoder program at offset 0
+		j = TwoAxisJson();
+		j["AXES"][1]["DRIVER"]["DRIVER_PIO"] = 1;
+		EXPECT_EQ(ErrorOf(j).rfind("DRIVER_PIO 1 is taken", 0), 0u);
+		j["AXES"][1]["DRIVER"]["DRIVER_PIO"] = 2;
+		EXPECT_THROW(Settings::from_json(j), std::runtime_error);
+	}
+
+	TEST(SettingsTest, SpindleMustDriveOneOfTheAxes)
+	{
+		nlohmann::json j = TwoAxisJson();
+		j["SPINDLE"]["ENABLED"] = true;
+		j["SPINDLE"]["AXIS"] = 1;
+		EXPECT_EQ(Settings::from_json(j).spindle.axis, 1);
+		j["SPINDLE"]["AXIS"] = 2;
+		EXPECT_THROW(Settings::from_json(j), std::runtime_error);
+		// not fitted, not checked
+		j["SPINDLE"]["ENABLED"] = false;
+		EXPECT_NO_THROW(Settings::from_json(j));
+	}
+
+} // namespace PowerFeed
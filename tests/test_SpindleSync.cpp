@@ -0,0 +1,278 @@
+#include "../src/SpindleSync.hxx"
+#include "../src/StepRamp.hxx"
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <gtest/gtest.h>
+#include <random>
+
+namespace PowerFeed
+{
+	// 1600 steps per motor rev through a 4.0556:1 reduction onto a 6.35mm leadscrew, ~1022 steps per mm
+	class SpindleSyncTest : public ::testing::Test
+	{
+	protected:
+		static constexpr uint32_t COUNTS_PER_REV = 4096;
+		static constexpr uint32_t UPDATE_HZ = 1000;
+		static constexpr uint32_t MAX_SPEED = 100000;
+
+		SpindleSync mySync{COUNTS_PER_REV, UPDATE_HZ, MAX_SPEED};
+	};
+
+	TEST_F(SpindleSyncTest, TargetDoesNotDriftOverALongCut)
+	{
+		// 0.05mm/rev is 51.1 steps per rev, not a whole number of steps per count
+		const Fixed stepsPerRev = Fixed::FromRatio(511, 10);
+		mySync.SetRatio(stepsPerRev);
+		mySync.Reset(0, 0);
+
+		// ten thousand revolutions read in uneven chunks, always fed the exact target so the error is the DDA's own
+		int64_t counts = 0;
+		int32_t steps = 0;
+		for (uint32_t update = 0; counts < 10000LL * COUNTS_PER_REV; update++)
+		{
+			counts += 37 + update % 11;
+			mySync.Update(static_cast<int32_t>(counts), steps);
+			steps += mySync.GetError();
+		}
+
+		const int64_t exact = counts * stepsPerRev.Raw() / (static_cast<int64_t>(COUNTS_PER_REV) << Fixed::FRACTION_BITS);
+		EXPECT_EQ(steps, exact);
+	}
+
+	TEST_F(SpindleSyncTest, ReversingSpindleComesBackToTheSameStep)
+	{
+		mySync.SetRatio(Fixed::FromRatio(511, 10));
+		mySync.Reset(1000, 500);
+
+		// forward and back by the same number of counts, through the counter wrapping, lands on the start
+		int32_t counts = 1000;
+		for (int i = 0; i < 100; i++)
+		{
+			counts += 333;
+			mySync.Update(counts, 500);
+		}
+		EXPECT_EQ(mySync.GetError(), 33300 * 511 / 10 / static_cast<int32_t>(COUNTS_PER_REV));
+		for (int i = 0; i < 100; i++)
+		{
+			counts -= 333;
+			mySync.Update(counts, 500);
+		}
+		EXPECT_EQ(mySync.GetError(), 0);
+
+		mySync.Reset(INT32_MAX - 10, INT32_MAX - 10);
+		mySync.Update(INT32_MIN + 4086, INT32_MIN + 40);
+		// a revolution through the wrap is 51 steps, 51 were sent
+		EXPECT_EQ(mySync.GetError(), 0);
+	}
+
+	TEST_F(SpindleSyncTest, RateFollowsSpindleAndClosesTheError)
+	{
+		mySync.SetRatio(Fixed::FromInt(100));
+		mySync.Reset(0, 0);
+
+		// 10 revs per second is 1000 steps per second, the axis keeps exactly to the target
+		int32_t counts = 0;
+		int32_t rate = 0;
+		for (uint32_t update = 1; update <= 20; update++)
+		{
+			counts = static_cast<int32_t>(update * COUNTS_PER_REV * 10 / UPDATE_HZ);
+			rate = mySync.Update(counts, counts * 100 / static_cast<int32_t>(COUNTS_PER_REV));
+		}
+		EXPECT_NEAR(rate, 1000, 150);
+		EXPECT_EQ(mySync.GetError(), 0);
+
+		// ten steps behind adds the error at the gain on top of the spindle rate
+		const int32_t behind = mySync.Update(counts, counts * 100 / static_cast<int32_t>(COUNTS_PER_REV) - 10);
+		EXPECT_EQ(mySync.GetError(), 10);
+		EXPECT_NEAR(behind, 1000 + 10 * static_cast<int32_t>(UPDATE_HZ / SpindleSync::GAIN_DIVISOR), 150);
+	}
+
+	TEST_F(SpindleSyncTest, RateIsLimitedToMaxSpeed)
+	{
+		mySync.SetRatio(Fixed::FromInt(1000));
+		mySync.Reset(0, 0);
+		EXPECT_EQ(mySync.Update(COUNTS_PER_REV * 100, 0), static_cast<int32_t>(MAX_SPEED));
+		mySync.Reset(0, 0);
+		EXPECT_EQ(mySync.Update(-static_cast<int32_t>(COUNTS_PER_REV) * 100, 0), -static_cast<int32_t>(MAX_SPEED));
+	}
+
+	/**
+	Closed loop simulation of the stepper task following a synthetic spindle signal: the spindle encoder is read every
+	millisecond, the rate from SpindleSync goes to a StepRamp with the firmware's acceleration limits and the steps
+	it produces are counted back in. The direction change mirrors the stepper, ramp down, setup time, ramp up. */
+	class SpindleSyncSimulation : public ::testing::Test
+	{
+	protected:
+		static constexpr uint32_t TICK_HZ = 1000000;
+		static constexpr uint32_t COUNTS_PER_REV = 4096;
+		static constexpr uint32_t UPDATE_US = 1000;
+		static constexpr uint32_t MAX_SPEED = 100000;
+		static constexpr uint32_t ACCELERATION = 10000;
+		static constexpr uint32_t DECELERATION = 20000;
+		static constexpr uint32_t START_SPEED = 10;
+		static constexpr uint32_t DIRECTION_DELAY_US = 5000;
+
+		struct Result
+		{
+			// worst error from aLockAfter on and the error at the end of the run
+			uint32_t maxLockedError;
+			int32_t finalError;
+			uint32_t reversals;
+		};
+
+		// aSpindle gives the spindle position in revolutions at a time in seconds
+		Result Run(double aSeconds, double aLockAfter, Fixed aStepsPerRev, const std::function<double(double)> &aSpindle, uint32_t aReadNoise = 0)
+		{
+			StepRamp ramp(TICK_HZ, MAX_SPEED, ACCELERATION, DECELERATION, START_SPEED, 128);
+			SpindleSync sync(COUNTS_PER_REV, 1000000 / UPDATE_US, MAX_SPEED);
+			std::mt19937 random(1234);
+
+			int32_t position = 0;
+			bool direction = true;
+			bool reversing = false;
+			uint64_t startAt = 0;
+			uint64_t nextStep = 0;
+			Result result = {0, 0, 0};
+
+			sync.SetRatio(aStepsPerRev);
+			sync.Reset(0, 0);
+
+			const uint64_t end = static_cast<uint64_t>(aSeconds * TICK_HZ);
+			for (uint64_t now = UPDATE_US; now <= end; now += UPDATE_US)
+			{
+				// steps that went out since the last update
+				while (ramp.GetState() != StepRamp::State::STOPPED && nextStep <= now)
+				{
+					const uint32_t period = ramp.NextPeriod();
+					if (period == 0)
+					{
+						break;
+					}
+					position += direction ? 1 : -1;
+					nextStep += period;
+				}
+
+				// an edge read a little early or late, as an encoder on a spindle with some runout would give
+				int32_t counts = static_cast<int32_t>(std::floor(aSpindle(static_cast<double>(now) / TICK_HZ) * COUNTS_PER_REV));
+				if (aReadNoise > 0)
+				{
+					counts += static_cast<int32_t>(random() % (2 * aReadNoise + 1)) - static_cast<int32_t>(aReadNoise);
+				}
+
+				const int32_t rate = sync.Update(counts, position);
+				if (static_cast<double>(now) / TICK_HZ >= aLockAfter)
+				{
+					result.maxLockedError = std::max(result.maxLockedError, static_cast<uint32_t>(std::abs(sync.GetError())));
+				}
+
+				const bool stopped = ramp.GetState() == StepRamp::State::STOPPED && nextStep <= now;
+				const bool wanted = rate >= 0;
+				if (reversing)
+				{
+					if (stopped)
+					{
+						reversing = false;
+						direction = !direction;
+						startAt = now + DIRECTION_DELAY_US;
+						result.reversals++;
+					}
+					continue;
+				}
+
+				if (rate == 0)
+				{
+					ramp.Stop();
+				}
+				else if (wanted != direction)
+				{
+					if (stopped)
+					{
+						direction = wanted;
+						startAt = now + DIRECTION_DELAY_US;
+						result.reversals++;
+					}
+					else
+					{
+						reversing = true;
+						ramp.Stop();
+					}
+				}
+				else
+				{
+					ramp.SetTargetSpeed(static_cast<uint32_t>(std::abs(rate)));
+					if (stopped && now >= startAt)
+					{
+						ramp.Start();
+						nextStep = now;
+					}
+				}
+			}
+
+			result.finalError = sync.GetError();
+			return result;
+		}
+
+		// 0.1mm/rev
+		const Fixed myStepsPerRev = Fixed::FromRatio(1022, 10);
+	};
+
+	TEST_F(SpindleSyncSimulation, LocksToASteadySpindle)
+	{
+		// already turning at 600rpm when the feed is engaged, the axis has to catch up from standstill
+		Result result = Run(3.0, 0.5, myStepsPerRev, [](double t)
+							{ return 10.0 * t; });
+		EXPECT_LE(result.maxLockedError, 2u);
+		EXPECT_EQ(result.reversals, 0u);
+	}
+
+	TEST_F(SpindleSyncSimulation, FollowsSpindleRunUpRippleAndStop)
+	{
+		// run up to 600rpm over half a second, 3% speed ripple at 20Hz, coast to a stop over a second
+		auto spindle = [](double t)
+		{
+			const double ripple = 0.03 * 10.0 / (2 * M_PI * 20) * std::sin(2 * M_PI * 20 * t);
+			if (t < 0.5)
+			{
+				return 10.0 * t * t + ripple * t / 0.5;
+			}
+			if (t < 3.0)
+			{
+				return 2.5 + 10.0 * (t - 0.5) + ripple;
+			}
+			const double coast = std::min(t - 3.0, 1.0);
+			return 27.5 + 10.0 * coast - 5.0 * coast * coast;
+		};
+		Result result = Run(5.0, 0.0, myStepsPerRev, spindle, 2);
+
+		// a few steps at most on the run up and through the ripple, a few thou of phase error
+		EXPECT_LE(result.maxLockedError, 4u);
+		// locked to the step once the spindle has stopped, the read noise may leave it a step either side
+		EXPECT_LE(std::abs(result.finalError), 1);
+	}
+
+	TEST_F(SpindleSyncSimulation, FollowsSpindleReversal)
+	{
+		// forward at 300rpm for a second, reverse within 100ms and back for a second, like tapping
+		auto spindle = [](double t)
+		{
+			if (t < 1.0)
+			{
+				return 5.0 * t;
+			}
+			if (t < 1.1)
+			{
+				const double s = t - 1.0;
+				return 5.0 + 5.0 * s - 50.0 * s * s;
+			}
+			return 5.0 - 5.0 * (t - 1.1);
+		};
+		Result result = Run(3.0, 0.0, myStepsPerRev, spindle);
+
+		// the direction setup time costs a few steps during the reversal, they are made up afterwards
+		EXPECT_LE(result.maxLockedError, 16u);
+		EXPECT_EQ(result.finalError, 0);
+		EXPECT_GE(result.reversals, 1u);
+	}
+
+} // namespace PowerFeed
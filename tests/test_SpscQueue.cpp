@@ -0,0 +1,91 @@
+#include "../src/SpscQueue.hxx"
+#include <gtest/gtest.h>
+#include <thread>
+
+namespace PowerFeed
+{
+	TEST(SpscQueueTest, PopsInOrderAndReportsEmpty)
+	{
+		SpscQueue<uint32_t, 4> queue;
+		uint32_t value = 0;
+		EXPECT_TRUE(queue.IsEmpty());
+		EXPECT_FALSE(queue.Pop(value));
+
+		EXPECT_TRUE(queue.Push(1));
+		EXPECT_TRUE(queue.Push(2));
+		EXPECT_FALSE(queue.IsEmpty());
+
+		EXPECT_TRUE(queue.Pop(value));
+		EXPECT_EQ(value, 1u);
+		EXPECT_TRUE(queue.Pop(value));
+		EXPECT_EQ(value, 2u);
+		EXPECT_TRUE(queue.IsEmpty());
+	}
+
+	TEST(SpscQueueTest, RejectsPushWhenFull)
+	{
+		// one slot is kept free to tell full from empty
+		SpscQueue<uint32_t, 4> queue;
+		EXPECT_TRUE(queue.Push(1));
+		EXPECT_TRUE(queue.Push(2));
+		EXPECT_TRUE(queue.Push(3));
+		EXPECT_FALSE(queue.Push(4));
+
+		uint32_t value = 0;
+		EXPECT_TRUE(queue.Pop(value));
+		EXPECT_TRUE(queue.Push(4));
+	}
+
+	TEST(SpscQueueTest, SizeCountsAcrossTheWrap)
+	{
+		SpscQueue<uint32_t, 4> queue;
+		uint32_t value = 0;
+		EXPECT_EQ(queue.Size(), 0u);
+		for (uint32_t i = 0; i < 10; i++)
+		{
+			EXPECT_TRUE(queue.Push(i));
+			EXPECT_TRUE(queue.Push(i));
+			EXPECT_EQ(queue.Size(), 2u);
+			EXPECT_TRUE(queue.Pop(value));
+			EXPECT_EQ(queue.Size(), 1u);
+			EXPECT_TRUE(queue.Pop(value));
+			EXPECT_EQ(queue.Size(), 0u);
+		}
+		while (queue.Push(0))
+		{
+		}
+		EXPECT_EQ(queue.Size(), 3u);
+	}
+
+	TEST(SpscQueueTest, ProducerAndConsumerThreadsSeeEveryItemInOrder)
+	{
+		constexpr uint32_t count = 20000;
+		SpscQueue<uint32_t, 16> queue;
+
+		std::thread producer([&queue]()
+							 {
+			for (uint32_t i = 0; i < count; i++)
+			{
+				while (!queue.Push(i))
+				{
+					std::this_thread::yield();
+				}
+			} });
+
+		uint32_t expected = 0;
+		while (expected < count)
+		{
+			uint32_t value;
+			if (!queue.Pop(value))
+			{
+				std::this_thread::yield();
+				continue;
+			}
+			ASSERT_EQ(value, expected);
+			expected++;
+		}
+		producer.join();
+		EXPECT_TRUE(queue.IsEmpty());
+	}
+
+} // namespace PowerFeed
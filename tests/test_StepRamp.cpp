@@ -0,0 +1,475 @@
+#include "../src/StepRamp.hxx"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+namespace PowerFeed
+{
+	// run every ramp test with the per step calculation and with precomputed tables
+	class StepRampTest : public ::testing::TestWithParam<uint16_t>
+	{
+	protected:
+		static constexpr uint32_t TICK_HZ = 1000000;
+		static constexpr uint32_t MAX_SPEED = 100000;
+		static constexpr uint32_t ACCELERATION = 10000;
+		static constexpr uint32_t DECELERATION = 20000;
+		static constexpr uint32_t START_SPEED = 10;
+
+		void SetUp() override
+		{
+			myRamp = std::make_unique<StepRamp>(TICK_HZ, MAX_SPEED, ACCELERATION, DECELERATION, START_SPEED, GetParam());
+		}
+
+		// Run the ramp until it reaches aState or gives up, returns the steps taken and accumulates elapsed ticks
+		uint32_t RunUntil(StepRamp::State aState, uint64_t &anElapsed, uint32_t aLimit = 1000000)
+		{
+			uint32_t steps = 0;
+			while (myRamp->GetState() != aState && steps < aLimit)
+			{
+				uint32_t period = myRamp->NextPeriod();
+				if (period == 0)
+				{
+					break;
+				}
+				anElapsed += period;
+				steps++;
+			}
+			return steps;
+		}
+
+		std::unique_ptr<StepRamp> myRamp;
+	};
+
+	TEST_P(StepRampTest, StoppedRampProducesNoSteps)
+	{
+		EXPECT_EQ(myRamp->GetState(), StepRamp::State::STOPPED);
+		EXPECT_EQ(myRamp->NextPeriod(), 0u);
+		EXPECT_EQ(myRamp->GetCurrentSpeed(), 0u);
+	}
+
+	TEST_P(StepRampTest, AcceleratesToTargetAtConfiguredRate)
+	{
+		myRamp->SetTargetSpeed(10000);
+		myRamp->Start();
+		EXPECT_EQ(myRamp->GetState(), StepRamp::State::ACCELERATING);
+
+		uint64_t elapsed = 0;
+		uint32_t steps = RunUntil(StepRamp::State::CRUISING, elapsed);
+
+		// v^2 / 2a = 5000 steps, v / a = 1 s
+		EXPECT_NEAR(steps, 5000, 50);
+		EXPECT_NEAR(static_cast<double>(elapsed) / TICK_HZ, 1.0, 0.02);
+		EXPECT_EQ(myRamp->NextPeriod(), TICK_HZ / 10000);
+		EXPECT_EQ(myRamp->GetCurrentSpeed(), 10000u);
+	}
+
+	TEST_P(StepRampTest, StopDeceleratesToStandstill)
+	{
+		myRamp->SetTargetSpeed(10000);
+		myRamp->Start();
+		uint64_t elapsed = 0;
+		RunUntil(StepRamp::State::CRUISING, elapsed);
+
+		myRamp->Stop();
+		EXPECT_EQ(myRamp->GetState(), StepRamp::State::STOPPING);
+		elapsed = 0;
+		uint32_t steps = RunUntil(StepRamp::State::STOPPED, elapsed);
+
+		// v^2 / 2d = 2500 steps, v / d = 0.5 s
+		EXPECT_NEAR(steps, 2500, 25);
+		EXPECT_NEAR(static_cast<double>(elapsed) / TICK_HZ, 0.5, 0.02);
+		EXPECT_EQ(myRamp->NextPeriod(), 0u);
+	}
+
+	TEST_P(StepRampTest, LowerTargetDeceleratesAndCruises)
+	{
+		myRamp->SetTargetSpeed(10000);
+		myRamp->Start();
+		uint64_t elapsed = 0;
+		RunUntil(StepRamp::State::CRUISING, elapsed);
+
+		myRamp->SetTargetSpeed(5000);
+		EXPECT_EQ(myRamp->GetState(), StepRamp::State::DECELERATING);
+		uint32_t steps = RunUntil(StepRamp::State::CRUISING, elapsed);
+
+		// (10000^2 - 5000^2) / 2d
+		EXPECT_NEAR(steps, 1875, 25);
+		EXPECT_EQ(myRamp->NextPeriod(), TICK_HZ / 5000);
+	}
+
+	TEST_P(StepRampTest, StartWhileStoppingResumes)
+	{
+		myRamp->SetTargetSpeed(10000);
+		myRamp->Start();
+		uint64_t elapsed = 0;
+		RunUntil(StepRamp::State::CRUISING, elapsed);
+
+		myRamp->Stop();
+		RunUntil(StepRamp::State::STOPPED, elapsed, 100);
+		myRamp->Start();
+		EXPECT_EQ(myRamp->GetState(), StepRamp::State::ACCELERATING);
+		RunUntil(StepRamp::State::CRUISING, elapsed);
+		EXPECT_EQ(myRamp->GetCurrentSpeed(), 10000u);
+	}
+
+	// the motion PicoStepper plans for a reversal: ramp down, the driver's direction setup time, ramp up
+	TEST_P(StepRampTest, ReversalTakesRampDownSetupTimeAndRampUp)
+	{
+		constexpr uint32_t speed = 10000;
+		constexpr uint32_t setupUs = 5000;
+		myRamp->SetTargetSpeed(speed);
+		myRamp->Start();
+		uint64_t elapsed = 0;
+		RunUntil(StepRamp::State::CRUISING, elapsed);
+
+		uint64_t reversal = 0;
+		myRamp->Stop();
+		RunUntil(StepRamp::State::STOPPED, reversal);
+		reversal += setupUs * (TICK_HZ / 1000000);
+		myRamp->Start();
+		RunUntil(StepRamp::State::CRUISING, reversal);
+
+		// v / d + setup + v / a
+		const double expected = static_cast<double>(speed) / DECELERATION + setupUs / 1e6 + static_cast<double>(speed) / ACCELERATION;
+		EXPECT_NEAR(static_cast<double>(reversal) / TICK_HZ, expected, expected * 0.01);
+	}
+
+	TEST_P(StepRampTest, HaltStopsWithoutRampingDown)
+	{
+		myRamp->SetTargetSpeed(10000);
+		myRamp->Start();
+		uint64_t elapsed = 0;
+		RunUntil(StepRamp::State::CRUISING, elapsed);
+
+		myRamp->Halt();
+		EXPECT_EQ(myRamp->GetState(), StepRamp::State::STOPPED);
+		EXPECT_EQ(myRamp->NextPeriod(), 0u);
+		EXPECT_EQ(myRamp->GetCurrentSpeed(), 0u);
+
+		// a start after it ramps up from the start speed again
+		myRamp->Start();
+		EXPECT_EQ(myRamp->GetState(), StepRamp::State::ACCELERATING);
+		EXPECT_GT(myRamp->NextPeriod(), TICK_HZ / 1000);
+	}
+
+	TEST_P(StepRampTest, TargetIsClampedToMaxSpeed)
+	{
+		myRamp->SetTargetSpeed(MAX_SPEED * 2);
+		EXPECT_EQ(myRamp->GetTargetSpeed(), MAX_SPEED);
+	}
+
+	TEST_P(StepRampTest, TablesUseConfiguredFootprint)
+	{
+		if (GetParam() == 0)
+		{
+			EXPECT_EQ(myRamp->GetTableFootprint(), 0u);
+		}
+		else
+		{
+			EXPECT_GT(myRamp->GetTableFootprint(), 0u);
+			EXPECT_LE(myRamp->GetTableFootprint(), 2 * (GetParam() + 1) * 24u);
+		}
+	}
+
+	TEST_P(StepRampTest, StartSpeedIsReachedWithoutAccelerating)
+	{
+		// system clock ticks, 1MHz periods are too coarse for the calculated ramp to hit 1%
+		constexpr uint32_t tickHz = 125000000;
+		StepRamp ramp(tickHz, MAX_SPEED, ACCELERATION, DECELERATION, 1000, GetParam());
+		ramp.SetTargetSpeed(10000);
+		ramp.Start();
+
+		EXPECT_NEAR(ramp.NextPeriod(), tickHz / 1000, tickHz / 100000);
+
+		uint64_t elapsed = 0;
+		uint32_t steps = 0;
+		while (ramp.GetState() != StepRamp::State::CRUISING && steps < 100000)
+		{
+			elapsed += ramp.NextPeriod();
+			steps++;
+		}
+
+		// (10000^2 - 1000^2) / 2a steps, (10000 - 1000) / a s
+		EXPECT_NEAR(steps, 4950, 50);
+		EXPECT_NEAR(static_cast<double>(elapsed) / tickHz, 0.9, 0.01);
+	}
+
+	// steps emitted over aSeconds of cruising at aSpeed + aFraction / 65536 steps per second
+	uint64_t CruiseSteps(StepRamp &aRamp, uint32_t aTickHz, uint32_t aSpeed, uint16_t aFraction, uint32_t aSeconds)
+	{
+		aRamp.SetTargetSpeed(aSpeed, aFraction);
+		aRamp.Start();
+		for (uint32_t steps = 0; aRamp.GetState() != StepRamp::State::CRUISING && steps < 1000000; steps++)
+		{
+			aRamp.NextPeriod();
+		}
+
+		const uint64_t end = static_cast<uint64_t>(aTickHz) * aSeconds;
+		uint64_t elapsed = 0;
+		uint64_t steps = 0;
+		while (elapsed < end)
+		{
+			elapsed += aRamp.NextPeriod();
+			steps++;
+		}
+		return steps;
+	}
+
+	TEST_P(StepRampTest, CruiseRateIsExactOverAMinute)
+	{
+		// at a 1us tick a whole period per step is up to 0.8% off at these rates, a fraction of a step per second
+		// would not show at all
+		const std::tuple<uint32_t, uint16_t> rates[] = {{10666, 0}, {12345, 0}, {3, 0x8000}, {250, 0x1999}, {99999, 0}};
+		for (const auto &[speed, fraction] : rates)
+		{
+			StepRamp ramp(TICK_HZ, MAX_SPEED, ACCELERATION, DECELERATION, START_SPEED, GetParam());
+			const double target = (speed + fraction / 65536.0) * 60;
+			const uint64_t steps = CruiseSteps(ramp, TICK_HZ, speed, fraction, 60);
+			// whatever the rate, the count can only be off by the step that straddles the end of the minute
+			EXPECT_NEAR(static_cast<double>(steps), target, std::max(1.0, target * 0.0001)) << speed << " + " << fraction << "/65536";
+			EXPECT_EQ(ramp.GetCurrentSpeed(), speed);
+		}
+	}
+
+	INSTANTIATE_TEST_SUITE_P(Calculated, StepRampTest, ::testing::Values(0));
+	INSTANTIATE_TEST_SUITE_P(Tables, StepRampTest, ::testing::Values(64, 128));
+
+	class StepRampSystemClockTest : public ::testing::TestWithParam<uint16_t>
+	{
+	};
+
+	TEST_P(StepRampSystemClockTest, ReachesHighRatesAtSystemClockTicks)
+	{
+		// pulsestepper runs at the system clock, periods are in 8ns ticks
+		StepRamp ramp(125000000, 800000, 200000, 200000, 10, GetParam());
+		ramp.SetTargetSpeed(800000);
+		ramp.Start();
+
+		uint64_t elapsed = 0;
+		uint32_t steps = 0;
+		while (ramp.GetState() != StepRamp::State::CRUISING && steps < 10000000)
+		{
+			elapsed += ramp.NextPeriod();
+			steps++;
+		}
+
+		// v^2 / 2a = 1600000 steps, v / a = 4 s
+		EXPECT_NEAR(steps, 1600000, 16000);
+		EXPECT_NEAR(static_cast<double>(elapsed) / 125000000, 4.0, 0.05);
+		EXPECT_EQ(ramp.GetCurrentSpeed(), 800000u);
+	}
+
+	INSTANTIATE_TEST_SUITE_P(Calculated, StepRampSystemClockTest, ::testing::Values(0));
+	INSTANTIATE_TEST_SUITE_P(Tables, StepRampSystemClockTest, ::testing::Values(128));
+
+	// synthetic encoder sweep, the UI sends a new target every 10ms while the ramp is still moving
+	class StepRampSweepTest : public ::testing::TestWithParam<std::tuple<uint16_t, uint32_t>>
+	{
+	protected:
+		static constexpr uint32_t TICK_HZ = 125000000;
+		static constexpr uint32_t ACCELERATION = 10000;
+		static constexpr uint32_t DECELERATION = 20000;
+		static constexpr uint32_t UPDATE_TICKS = TICK_HZ / 100;
+
+		struct Sample
+		{
+			double time;
+			double speed;
+		};
+
+		// Run the ramp for aSeconds, calling aTarget with the update number every 10ms, and trace every step
+		template <typename Target>
+		std::vector<Sample> Sweep(double aSeconds, Target aTarget)
+		{
+			StepRamp ramp(TICK_HZ, 100000, ACCELERATION, DECELERATION, 10, std::get<0>(GetParam()), std::get<1>(GetParam()));
+			ramp.SetTargetSpeed(aTarget(0));
+			ramp.Start();
+
+			std::vector<Sample> trace;
+			uint64_t elapsed = 0;
+			uint64_t nextUpdate = UPDATE_TICKS;
+			uint32_t update = 1;
+			while (elapsed < aSeconds * TICK_HZ)
+			{
+				uint32_t period = ramp.NextPeriod();
+				if (period == 0)
+				{
+					break;
+				}
+				elapsed += period;
+				trace.push_back({static_cast<double>(elapsed) / TICK_HZ, static_cast<double>(TICK_HZ) / period});
+				while (elapsed >= nextUpdate)
+				{
+					ramp.SetTargetSpeed(aTarget(update++));
+					nextUpdate += UPDATE_TICKS;
+				}
+			}
+			return trace;
+		}
+
+		// speed between neighbouring steps and acceleration over 20ms windows of the step trace
+		void ExpectSmooth(const std::vector<Sample> &aTrace)
+		{
+			ASSERT_GT(aTrace.size(), 100u);
+			// slack for the linear interpolation between table segments, a few percent of the rate locally
+			const double limit = DECELERATION * 1.08 + 200;
+			size_t ahead = 0;
+			for (size_t i = 0; i + 1 < aTrace.size(); i++)
+			{
+				const double dt = aTrace[i + 1].time - aTrace[i].time;
+				// the S-curve moves its period on once a slice has gone by, which can be up to two slices' worth of change
+				const double span = std::get<1>(GetParam()) > 0 ? std::max(dt, 2 * SCurve::SLICE_US / 1000000.0) : dt;
+				ASSERT_LE(std::abs(aTrace[i + 1].speed - aTrace[i].speed), limit * span + aTrace[i].speed * 0.002 + 1) << "step " << i << " at " << aTrace[i].time;
+
+				ahead = std::max(ahead, i + 1);
+				while (ahead + 1 < aTrace.size() && aTrace[ahead].time - aTrace[i].time < 0.02)
+				{
+					ahead++;
+				}
+				const double window = aTrace[ahead].time - aTrace[i].time;
+				if (window >= 0.02)
+				{
+					ASSERT_LE(std::abs(aTrace[ahead].speed - aTrace[i].speed) / window, limit) << "at " << aTrace[i].time;
+				}
+			}
+		}
+	};
+
+	TEST_P(StepRampSweepTest, EncoderSweepKeepsSpeedContinuous)
+	{
+		// up faster than the ramp can follow, then back down
+		auto trace = Sweep(4.0, [](uint32_t anUpdate)
+						   { return anUpdate < 100 ? 1000 + anUpdate * 200 : (anUpdate < 200 ? 21000 - (anUpdate - 100) * 200 : 1000); });
+		ExpectSmooth(trace);
+		EXPECT_NEAR(trace.back().speed, 1000, 10);
+	}
+
+	TEST_P(StepRampSweepTest, EncoderJitterKeepsSpeedContinuous)
+	{
+		// target flips around the current speed on every update, the ramp changes direction constantly
+		auto trace = Sweep(3.0, [](uint32_t anUpdate)
+						   { return 5000 + (anUpdate % 2 == 0 ? 300 : -300) + (anUpdate % 7) * 50; });
+		ExpectSmooth(trace);
+	}
+
+	TEST_P(StepRampSweepTest, SlowSweepTracksTarget)
+	{
+		// within the acceleration limit, the ramp should follow without lagging behind
+		auto trace = Sweep(2.0, [](uint32_t anUpdate)
+						   { return 2000 + anUpdate * 50; });
+		ExpectSmooth(trace);
+		EXPECT_NEAR(trace.back().speed, 2000 + 200 * 50, 300);
+	}
+
+	TEST_P(StepRampSweepTest, StepsLeftLandOnTheLastStep)
+	{
+		// a short move that never reaches the target, one that just does and a long one
+		for (uint32_t distance : {300u, 12000u, 100000u})
+		{
+			StepRamp ramp(TICK_HZ, 100000, ACCELERATION, DECELERATION, 10, std::get<0>(GetParam()), std::get<1>(GetParam()));
+			ramp.SetTargetSpeed(20000);
+			ramp.SetStepsLeft(distance);
+			ramp.Start();
+
+			std::vector<Sample> trace;
+			uint64_t elapsed = 0;
+			uint32_t slow = 0;
+			while (trace.size() <= distance)
+			{
+				uint32_t period = ramp.NextPeriod();
+				if (period == 0)
+				{
+					break;
+				}
+				elapsed += period;
+				trace.push_back({static_cast<double>(elapsed) / TICK_HZ, static_cast<double>(TICK_HZ) / period});
+				if (period >= TICK_HZ / 200)
+				{
+					slow++;
+				}
+			}
+
+			ASSERT_EQ(trace.size(), distance) << distance;
+			EXPECT_EQ(ramp.GetState(), StepRamp::State::STOPPED);
+			EXPECT_EQ(ramp.GetStepsLeft(), 0u);
+			EXPECT_EQ(ramp.GetStepCount(), distance);
+			// braked in time, the last step is at a speed the motor stops dead from
+			EXPECT_LE(trace.back().speed, 300) << distance;
+			// and not early, only a few steps are left over to creep at the speed it stops dead from, a few more as the
+			// curve eases in
+			EXPECT_LE(slow, std::get<1>(GetParam()) > 0 ? 20u : 5u) << distance;
+			ExpectSmooth(trace);
+
+			if (distance == 100000)
+			{
+				// at full speed until the stop, which takes v^2 / 2d = 10000 steps and v d / 2j = 2000 more with jerk
+				size_t fast = 0;
+				for (size_t i = 0; i < trace.size(); i++)
+				{
+					if (trace[i].speed >= 19800)
+					{
+						fast = i;
+					}
+				}
+				const double stopping = std::get<1>(GetParam()) > 0 ? 12000 : 10000;
+				EXPECT_GE(distance - fast, stopping * 0.95);
+				EXPECT_LE(distance - fast, stopping * 17 / 16 + 100);
+			}
+		}
+	}
+
+	TEST_P(StepRampTest, StepsLeftOfZeroProduceNoSteps)
+	{
+		myRamp->SetTargetSpeed(10000);
+		myRamp->SetStepsLeft(0);
+		myRamp->Start();
+		EXPECT_EQ(myRamp->NextPeriod(), 0u);
+		EXPECT_EQ(myRamp->GetState(), StepRamp::State::STOPPED);
+
+		// cleared, it runs on until stopped
+		myRamp->ClearStepsLeft();
+		myRamp->Start();
+		uint64_t elapsed = 0;
+		EXPECT_EQ(RunUntil(StepRamp::State::STOPPED, elapsed, 20000), 20000u);
+	}
+
+	TEST(StepRampSCurveTest, CruiseRateIsExactOverAMinute)
+	{
+		StepRamp ramp(1000000, 100000, 10000, 20000, 10, 0, 100000);
+		const uint64_t steps = CruiseSteps(ramp, 1000000, 10666, 0x4000, 60);
+		EXPECT_NEAR(static_cast<double>(steps), 10666.25 * 60, 1.0);
+	}
+
+	TEST(StepRampCurveTest, StepsLeftLandWithAnAccelerationCurve)
+	{
+		// the braking distance grows at the steepest acceleration of the curve, early if anything but never late
+		const AccelerationCurve curve = {{0, 30000}, {5000, 30000}, {20000, 5000}};
+		for (uint32_t distance : {300u, 5000u, 100000u})
+		{
+			StepRamp ramp(1000000, 100000, 10000, 20000, 10, 0, 0, curve);
+			ramp.SetTargetSpeed(20000);
+			ramp.SetStepsLeft(distance);
+			ramp.Start();
+
+			uint32_t steps = 0;
+			uint32_t period = 0;
+			uint32_t last = 0;
+			while (steps <= distance && (period = ramp.NextPeriod()) != 0)
+			{
+				last = period;
+				steps++;
+			}
+			EXPECT_EQ(steps, distance);
+			EXPECT_EQ(ramp.GetState(), StepRamp::State::STOPPED);
+			EXPECT_LE(1000000.0 / last, 300) << distance;
+		}
+	}
+
+	INSTANTIATE_TEST_SUITE_P(Calculated, StepRampSweepTest, ::testing::Values(std::make_tuple(0, 0)));
+	INSTANTIATE_TEST_SUITE_P(Tables, StepRampSweepTest, ::testing::Values(std::make_tuple(128, 0)));
+	INSTANTIATE_TEST_SUITE_P(SCurve, StepRampSweepTest, ::testing::Values(std::make_tuple(0, 100000)));
+
+} // namespace PowerFeed
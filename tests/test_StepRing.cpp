@@ -0,0 +1,277 @@
+#include "../src/StepRing.hxx"
+#include <deque>
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+namespace PowerFeed
+{
+	namespace
+	{
+		// the sizes of PicoStepStream, the joined TX FIFO and a half of the ring
+		constexpr size_t FIFO_WORDS = 8;
+		constexpr size_t HALF_WORDS = 256;
+		constexpr uint32_t HORIZON_US = 2000;
+
+		/**
+		@brief Two DMA channels into a TX FIFO played out by a step program at a fixed rate, with the completion
+		interrupt taking aLatencyUs to run and the hardware moving on while it runs. Every word is numbered, so
+		a word played twice, out of order or left out shows up in what the program played. */
+		class SimulatedRing : public StepRing<SimulatedRing>
+		{
+			friend class StepRing<SimulatedRing>;
+
+		public:
+			SimulatedRing(uint32_t aPeriodUs, uint32_t aWordsPerStep, uint32_t aSteps, uint32_t aLatencyUs)
+				: myPeriodUs(aPeriodUs), myWordsPerStep(aWordsPerStep), mySteps(aSteps), myLatencyUs(aLatencyUs), myRandom(aPeriodUs)
+			{
+			}
+
+			void Run()
+			{
+				PrimeRing();
+				const uint64_t limit = (static_cast<uint64_t>(mySteps) + 10) * myPeriodUs * 2 + 100000;
+				while (myWakes == 0 && myNowUs < limit)
+				{
+					Advance();
+					RunInterrupts();
+				}
+				// play out what is left in the FIFO
+				while (myPlayed.size() < myNextWord && myNowUs < limit)
+				{
+					Advance();
+				}
+			}
+
+			std::vector<uint32_t> myPlayed;
+			uint32_t myUnderflows = 0;
+			uint32_t myWakes = 0;
+
+		private:
+			struct Channel
+			{
+				size_t count = 0;
+				size_t next = 0;
+				bool busy = false;
+				bool started = false;
+				bool pending = false;
+				uint64_t pendingSinceUs = 0;
+				unsigned chainTo = 0;
+			};
+
+			size_t FillHalf(unsigned aHalf)
+			{
+				std::vector<uint32_t> &buffer = myBuffers[aHalf];
+				buffer.clear();
+				uint32_t us = 0;
+				while (buffer.size() + myWordsPerStep <= HALF_WORDS && us < HORIZON_US && myFilledSteps < mySteps)
+				{
+					for (uint32_t word = 0; word < myWordsPerStep; word++)
+					{
+						buffer.push_back(myNextWord++);
+					}
+					us += myPeriodUs;
+					myFilledSteps++;
+				}
+				return buffer.size();
+			}
+
+			bool HasMoreSteps() const { return myFilledSteps < mySteps; }
+
+			void ArmHalf(unsigned aHalf, size_t aWords)
+			{
+				myChannels[aHalf] = {aWords, 0, false, false, false, 0, aHalf};
+			}
+
+			void ChainToHalf(unsigned aHalf)
+			{
+				MaybeAdvance();
+				myChannels[aHalf ^ 1].chainTo = aHalf;
+				MaybeAdvance();
+			}
+
+			bool IsHalfBusy(unsigned aHalf)
+			{
+				MaybeAdvance();
+				return myChannels[aHalf].busy;
+			}
+
+			bool HasHalfStarted(unsigned aHalf) const { return myChannels[aHalf].started; }
+
+			void StartHalf(unsigned aHalf) { Trigger(aHalf); }
+
+			void WakeFromISR() { myWakes++; }
+
+			void Trigger(unsigned aHalf)
+			{
+				Channel &channel = myChannels[aHalf];
+				channel.busy = true;
+				channel.started = true;
+				channel.next = 0;
+			}
+
+			// the hardware carries on while the interrupt runs
+			void MaybeAdvance()
+			{
+				if (myCoin(myRandom))
+				{
+					Advance();
+				}
+			}
+
+			// a microsecond of DMA and step program
+			void Advance()
+			{
+				for (unsigned half = 0; half < 2; half++)
+				{
+					Channel &channel = myChannels[half];
+					while (channel.busy && myFifo.size() < FIFO_WORDS && channel.next < channel.count)
+					{
+						myFifo.push_back(myBuffers[half][channel.next++]);
+					}
+					if (channel.busy && channel.next == channel.count)
+					{
+						channel.busy = false;
+						channel.pending = true;
+						channel.pendingSinceUs = myNowUs;
+						if (channel.chainTo != half)
+						{
+							Trigger(channel.chainTo);
+						}
+					}
+				}
+
+				if (myNowUs >= myWordDoneUs)
+				{
+					if (!myFifo.empty())
+					{
+						myPlayed.push_back(myFifo.front());
+						myFifo.pop_front();
+						myWordDoneUs = myNowUs + myPeriodUs / myWordsPerStep;
+						myStarved = false;
+					}
+					else if (!myPlayed.empty() && myPlayed.size() < static_cast<size_t>(mySteps) * myWordsPerStep && !myStarved)
+					{
+						// counted once per gap
+						myUnderflows++;
+						myStarved = true;
+					}
+				}
+				myNowUs++;
+			}
+
+			void RunInterrupts()
+			{
+				// lowest channel first like the shared handler, each one if still pending once it gets to it
+				for (unsigned half = 0; half < 2; half++)
+				{
+					Channel &channel = myChannels[half];
+					if (channel.pending && myNowUs - channel.pendingSinceUs >= myLatencyUs)
+					{
+						channel.pending = false;
+						OnHalfComplete(half);
+					}
+				}
+			}
+
+			const uint32_t myPeriodUs;
+			const uint32_t myWordsPerStep;
+			const uint32_t mySteps;
+			const uint32_t myLatencyUs;
+			std::mt19937 myRandom;
+			std::bernoulli_distribution myCoin{0.5};
+
+			Channel myChannels[2];
+			std::vector<uint32_t> myBuffers[2];
+			std::deque<uint32_t> myFifo;
+			uint64_t myNowUs = 0;
+			uint64_t myWordDoneUs = 0;
+			bool myStarved = false;
+			uint32_t myFilledSteps = 0;
+			uint32_t myNextWord = 0;
+		};
+
+		void ExpectEveryWordOnce(const SimulatedRing &aRing, uint32_t aWords)
+		{
+			ASSERT_EQ(aRing.myPlayed.size(), aWords);
+			for (uint32_t i = 0; i < aWords; i++)
+			{
+				ASSERT_EQ(aRing.myPlayed[i], i) << "word " << i;
+			}
+			EXPECT_EQ(aRing.myWakes, 1u);
+			EXPECT_EQ(aRing.GetRingState(), SimulatedRing::RingState::IDLE);
+		}
+	}
+
+	TEST(StepRingTest, LowRatesNeverReplayAHalf)
+	{
+		// simplestepper, two words a step, a half of a few words fits in the FIFO below about 2k steps/s and both
+		// halves finish before the interrupt gets to refill either
+		for (uint32_t period : {20000u, 5000u, 2000u, 1000u, 700u, 500u})
+		{
+			for (uint32_t latency : {5u, 300u, 1900u})
+			{
+				SimulatedRing ring(period, 2, 60, latency);
+				ring.Run();
+				SCOPED_TRACE(testing::Message() << "period " << period << " latency " << latency);
+				ExpectEveryWordOnce(ring, 60 * 2);
+				EXPECT_EQ(ring.myUnderflows, 0u);
+			}
+		}
+	}
+
+	TEST(StepRingTest, OneWordPerStepLowRates)
+	{
+		// pulsestepper, one word a step, twice the steps fit in the FIFO, a half does below about 4k steps/s
+		for (uint32_t period : {20000u, 2000u, 500u, 250u, 125u})
+		{
+			for (uint32_t latency : {5u, 300u, 1900u})
+			{
+				SimulatedRing ring(period, 1, 100, latency);
+				ring.Run();
+				SCOPED_TRACE(testing::Message() << "period " << period << " latency " << latency);
+				ExpectEveryWordOnce(ring, 100);
+				EXPECT_EQ(ring.myUnderflows, 0u);
+			}
+		}
+
+		// and up to the word limit of a half at the fastest rates
+		SimulatedRing ring(2, 1, 5000, 100);
+		ring.Run();
+		ExpectEveryWordOnce(ring, 5000);
+		EXPECT_EQ(ring.myUnderflows, 0u);
+	}
+
+	TEST(StepRingTest, HighRatesChainWithoutGaps)
+	{
+		// a half is the whole horizon, the interrupt has that long to refill the other one
+		for (uint32_t period : {200u, 50u, 20u})
+		{
+			for (uint32_t latency : {5u, 300u, 1500u})
+			{
+				SimulatedRing ring(period, 2, 2000, latency);
+				ring.Run();
+				SCOPED_TRACE(testing::Message() << "period " << period << " latency " << latency);
+				ExpectEveryWordOnce(ring, 2000 * 2);
+				EXPECT_EQ(ring.myUnderflows, 0u);
+			}
+		}
+	}
+
+	TEST(StepRingTest, LateInterruptsOnlyStallTheSteps)
+	{
+		// an interrupt held up for longer than a half gaps the steps, it must not replay or skip any of them
+		SimulatedRing ring(50, 2, 2000, 5000);
+		ring.Run();
+		ExpectEveryWordOnce(ring, 2000 * 2);
+		EXPECT_GT(ring.myUnderflows, 0u);
+	}
+
+	TEST(StepRingTest, SingleStepMove)
+	{
+		SimulatedRing ring(10000, 2, 1, 50);
+		ring.Run();
+		ExpectEveryWordOnce(ring, 2);
+	}
+
+} // namespace PowerFeed
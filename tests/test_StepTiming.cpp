@@ -0,0 +1,98 @@
+#include "../src/StepRamp.hxx"
+#include "../src/StepTiming.hxx"
+#include <gtest/gtest.h>
+
+namespace PowerFeed
+{
+	class StepTimingTest : public ::testing::Test
+	{
+	protected:
+		static constexpr uint32_t CLOCK_HZ = 125000000;
+
+		StepTiming myTiming{CLOCK_HZ};
+	};
+
+	TEST_F(StepTimingTest, BinsDoubleFromTheFirst)
+	{
+		EXPECT_EQ(StepTiming::Bin(0), 0);
+		EXPECT_EQ(StepTiming::Bin(15), 0);
+		EXPECT_EQ(StepTiming::Bin(16), 1);
+		EXPECT_EQ(StepTiming::Bin(31), 1);
+		EXPECT_EQ(StepTiming::Bin(32), 2);
+		EXPECT_EQ(StepTiming::Bin(UINT32_MAX), StepTiming::BINS - 1);
+		EXPECT_EQ(StepTiming::BinLimitNs(0), 16u);
+		EXPECT_EQ(StepTiming::BinLimitNs(2), 64u);
+		EXPECT_EQ(StepTiming::BinLimitNs(StepTiming::BINS - 1), UINT32_MAX);
+	}
+
+	TEST_F(StepTimingTest, ExactPeriodsHaveNoErrorOrJitter)
+	{
+		myTiming.Reset(10000);
+		for (int i = 0; i < 100; i++)
+		{
+			myTiming.Add(CLOCK_HZ / 10000);
+		}
+
+		EXPECT_EQ(myTiming.GetSamples(), 100u);
+		EXPECT_EQ(myTiming.GetError().counts[0], 100u);
+		EXPECT_EQ(myTiming.GetJitter().counts[0], 99u);
+		EXPECT_EQ(myTiming.GetError().maxNs, 0u);
+		EXPECT_EQ(myTiming.GetRateErrorPpm(), 0);
+	}
+
+	TEST_F(StepTimingTest, DitheredRateIsExactWithTickSizedJitter)
+	{
+		// the simplestepper 1us tick seen at the system clock
+		constexpr uint32_t cyclesPerTick = CLOCK_HZ / 1000000;
+		StepRamp ramp(1000000, 100000, 10000, 20000, 10, 0);
+		ramp.SetTargetSpeed(10666);
+		ramp.Start();
+		while (ramp.GetState() != StepRamp::State::CRUISING)
+		{
+			ramp.NextPeriod();
+		}
+
+		myTiming.Reset(10666);
+		for (int i = 0; i < 10666; i++)
+		{
+			myTiming.Add(ramp.NextPeriod() * cyclesPerTick);
+		}
+
+		EXPECT_EQ(myTiming.GetRateErrorPpm(), 0);
+		// 93.756us between 93us and 94us periods
+		EXPECT_LE(myTiming.GetError().maxNs, 1000u);
+		EXPECT_EQ(myTiming.GetJitter().maxNs, 1000u);
+		EXPECT_EQ(myTiming.GetJitter().counts[StepTiming::Bin(1000)] + myTiming.GetJitter().counts[0], 10665u);
+	}
+
+	TEST_F(StepTimingTest, LateStepShowsUpInBothHistograms)
+	{
+		myTiming.Reset(1000);
+		myTiming.Add(125000);
+		// a step 100us late, and the one after it early by the same
+		myTiming.Add(125000 + 12500);
+		myTiming.Add(125000 - 12500);
+		myTiming.Add(125000);
+
+		EXPECT_EQ(myTiming.GetError().maxNs, 100000u);
+		EXPECT_EQ(myTiming.GetError().counts[StepTiming::BINS - 1], 2u);
+		EXPECT_EQ(myTiming.GetError().counts[0], 2u);
+		// both far beyond the last bin limit
+		EXPECT_EQ(myTiming.GetJitter().maxNs, 200000u);
+		EXPECT_EQ(myTiming.GetJitter().counts[StepTiming::BINS - 1], 3u);
+		EXPECT_EQ(myTiming.GetRateErrorPpm(), 0);
+	}
+
+	TEST_F(StepTimingTest, SlowPeriodsReadAsARateError)
+	{
+		myTiming.Reset(1000);
+		for (int i = 0; i < 1000; i++)
+		{
+			myTiming.Add(125125);
+		}
+		// 0.1% long, 999 steps a second
+		EXPECT_NEAR(myTiming.GetRateErrorPpm(), -999, 1);
+		EXPECT_EQ(myTiming.GetError().maxNs, 1000u);
+	}
+
+} // namespace PowerFeed